@@ -0,0 +1,277 @@
+/**
+ * Heap allocations of the game loops.
+ * Linked with -Wl,--wrap for malloc, calloc, realloc and aligned_alloc, so
+ * every allocation of the program (not the ones inside the C library) is
+ * counted. Once a loop has started, more games must not allocate anything:
+ *   game     - games on the game engine, the arena reset between them
+ *   server   - games over a connection to the server (own thread, Unix socket)
+ *   simulate - the allocations of SIMULATE_run do not depend on the games
+ * Fails if any of them allocates in steady state.
+ *
+ * Usage: alloc_bench [games]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../src/timeunits.h"
+#include "../src/arena/arena.h"
+#include "../src/timer/timer.h"
+#include "../src/game/game.h"
+#include "../src/server/server.h"
+#include "../src/simulate/simulate.h"
+
+#define GAMES_DEF 10000
+#define NUMBERS 4
+#define MAX 6
+#define ROUNDS 10
+
+static atomic_ulong allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *memory, size_t size);
+void *__real_aligned_alloc(size_t alignment, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	atomic_fetch_add(&allocations, 1);
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+	atomic_fetch_add(&allocations, 1);
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *memory, size_t size)
+{
+	atomic_fetch_add(&allocations, 1);
+	return __real_realloc(memory, size);
+}
+
+void *__wrap_aligned_alloc(size_t alignment, size_t size)
+{
+	atomic_fetch_add(&allocations, 1);
+	return __real_aligned_alloc(alignment, size);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * SEC_TO_NS(1u) + now.tv_nsec;
+}
+
+static void report(const char *loop, uint64_t games, unsigned long allocated, uint64_t elapsed)
+{
+	printf("%-9s %10llu %12lu %14.4f %10.0f\n", loop, (unsigned long long)games, allocated,
+		   (double)allocated / games, games / (elapsed / 1e9));
+}
+
+static void random_code(unsigned int *seed, int code[])
+{
+	for (int i = 0; i < NUMBERS; i++)
+		code[i] = rand_r(seed) % MAX + 1;
+}
+
+/* Game engine */
+
+static bool game_loop(uint64_t games)
+{
+	struct game_settings settings = {.numbers = NUMBERS, .max = MAX, .rounds = ROUNDS};
+	struct timer_wheel wheel;
+	struct arena arena;
+	struct game game;
+	TIMER_wheel_init(&wheel, MS_TO_NS(10u), 0);
+	if (ARENA_init(&arena, GAME_ARENA_SIZE(NUMBERS)) != 0)
+		return false;
+
+	unsigned int seed = 1;
+	unsigned long before = atomic_load(&allocations);
+	uint64_t start = now_ns();
+	bool passed = true;
+	for (uint64_t i = 0; i < games && passed; i++)
+	{
+		// A new game every time, the way a server session starts one
+		ARENA_reset(&arena);
+		passed = GAME_init(&game, &settings, NULL, NULL, &wheel, &arena) == 0;
+
+		int secret[NUMBERS];
+		int guess[NUMBERS];
+		random_code(&seed, secret);
+		GAME_start(&game, secret);
+		while (passed && !GAME_is_over(&game))
+		{
+			random_code(&seed, guess);
+			passed = GAME_submit_guess(&game, guess) == 0;
+		}
+		GAME_free(&game);
+	}
+	unsigned long allocated = atomic_load(&allocations) - before;
+	report("game", games, allocated, now_ns() - start);
+
+	ARENA_free(&arena);
+	return passed && allocated == 0;
+}
+
+/* Server */
+
+static void *server_loop(void *arg)
+{
+	SERVER_run(arg);
+	return NULL;
+}
+
+/**
+ * Sends the request and reads the one line reply
+*/
+static bool request(int fd, const char *line, char *reply, size_t size)
+{
+	size_t length = strlen(line);
+	if (send(fd, line, length, MSG_NOSIGNAL) != (ssize_t)length)
+		return false;
+
+	size_t received = 0;
+	while (received == 0 || reply[received - 1] != '\n')
+	{
+		ssize_t n = recv(fd, reply + received, size - 1 - received, 0);
+		if (n <= 0 || received + n >= size - 1)
+			return false;
+		received += n;
+	}
+	reply[received] = '\0';
+	return true;
+}
+
+/**
+ * Plays one game over the connection
+*/
+static bool play_remote(int fd, unsigned int *seed)
+{
+	char line[128];
+	char reply[128];
+	snprintf(line, sizeof(line), "NEW %d %d %d\n", NUMBERS, MAX, ROUNDS);
+	if (!request(fd, line, reply, sizeof(reply)) || strncmp(reply, "OK ", 3) != 0)
+		return false;
+
+	for (int round = 0; round < ROUNDS; round++)
+	{
+		int guess[NUMBERS];
+		random_code(seed, guess);
+		snprintf(line, sizeof(line), "GUESS %d %d %d %d\n", guess[0], guess[1], guess[2], guess[3]);
+		if (!request(fd, line, reply, sizeof(reply)) || strstr(reply, "ERROR"))
+			return false;
+		if (!strstr(reply, "CONTINUE"))
+			return true;
+	}
+	return false;  // Not over after the last round
+}
+
+static bool server_loop_games(uint64_t games)
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/mastermind_alloc_%d.sock", (int)getpid());
+	struct server_config config =
+	{
+		.path = path,
+		.max_sessions = 4,
+		.settings = {.numbers = NUMBERS, .max = MAX, .rounds = ROUNDS},
+	};
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, server_loop, &config) != 0)
+	{
+		perror("Unable to start the server");
+		return false;
+	}
+
+	struct sockaddr_un address = {.sun_family = AF_UNIX};
+	snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	// The server may still be starting
+	for (int attempt = 0; fd >= 0 && connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0; attempt++)
+	{
+		if (attempt == 100)
+		{
+			close(fd);
+			fd = -1;
+		}
+		usleep(10000);
+	}
+
+	unsigned int seed = 2;
+	bool passed = fd >= 0 && play_remote(fd, &seed);  // The first game sets everything up
+	unsigned long before = atomic_load(&allocations);
+	uint64_t start = now_ns();
+	uint64_t played = 0;
+	for (; played < games && passed; played++)
+		passed = play_remote(fd, &seed);
+	unsigned long allocated = atomic_load(&allocations) - before;
+	if (passed)
+		report("server", played, allocated, now_ns() - start);
+	else
+		fprintf(stderr, "Error - The server game failed\n");
+
+	if (fd >= 0)
+		close(fd);
+	SERVER_stop();
+	pthread_join(thread, NULL);
+	return passed && allocated == 0;
+}
+
+/* Simulation */
+
+static bool simulate_loop(uint64_t games)
+{
+	struct simulate_config config =
+	{
+		.games = games / 100 ? games / 100 : 1,
+		.threads = 2,
+		.seed = 3,
+		.settings = {.numbers = NUMBERS, .max = MAX, .rounds = ROUNDS},
+	};
+	struct simulate_stats stats;
+
+	// The same number of allocations for 100 times more games
+	unsigned long before = atomic_load(&allocations);
+	bool passed = SIMULATE_run(&config, &stats) == 0;
+	unsigned long few = atomic_load(&allocations) - before;
+
+	config.games *= 100;
+	before = atomic_load(&allocations);
+	passed = SIMULATE_run(&config, &stats) == 0 && passed;
+	unsigned long many = atomic_load(&allocations) - before;
+
+	report("simulate", stats.games, many, stats.elapsed_ns);
+	if (many != few)
+		fprintf(stderr, "Error - %lu allocations for %llu games, %lu for %llu\n", few,
+				(unsigned long long)config.games / 100, many, (unsigned long long)config.games);
+	return passed && many == few;
+}
+
+int main(int argc, char *argv[])
+{
+	long games = GAMES_DEF;
+	if (argc > 1 && (games = atol(argv[1])) <= 0)
+	{
+		fprintf(stderr, "Error - Invalid number of games %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	printf("%-9s %10s %12s %14s %10s\n", "loop", "games", "allocations", "per_game", "games/s");
+	bool passed = game_loop(games);
+	passed = server_loop_games(games) && passed;
+	passed = simulate_loop(games) && passed;
+
+	if (!passed)
+		fprintf(stderr, "Error - The game loops allocate memory\n");
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
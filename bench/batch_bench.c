@@ -0,0 +1,193 @@
+/**
+ * One guess against a whole code space with CODE_score_many.
+ * Every kernel the CPU supports has to give the same scores and partition
+ * counts as CODE_score pair by pair, the program fails otherwise.
+ * The speed is compared with scoring the int arrays pair by pair
+ * (SCORE_calculate), the way the game scores a guess.
+ *
+ * Usage: batch_bench [guesses per code space]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "../src/timeunits.h"
+#include "../src/score/score.h"
+#include "../src/code/code.h"
+
+#define GUESSES_DEF 16
+
+struct space
+{
+	uint8_t numbers;
+	uint8_t colours;
+};
+
+static const struct space spaces[] =
+{
+	{4, 6},
+	{5, 8},
+	{6, 9},
+	{8, 6},
+};
+
+static const enum code_kernel kernel_types[] =
+{
+	CODE_KERNEL_SCALAR,
+	CODE_KERNEL_SSE42,
+	CODE_KERNEL_AVX2,
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * SEC_TO_NS(1u) + now.tv_nsec;
+}
+
+/**
+ * Writes the code with the given index, numbers from 1 to colours
+*/
+static void decode(uint32_t index, const struct space *space, int code[])
+{
+	for (uint8_t i = 0; i < space->numbers; i++)
+	{
+		code[i] = index % space->colours + 1;
+		index /= space->colours;
+	}
+}
+
+/**
+ * Builds the set of all the codes of the space and the same codes as int arrays
+*/
+static bool build_space(const struct space *space, struct code_set *set, int **arrays)
+{
+	uint32_t codes = 1;
+	for (uint8_t i = 0; i < space->numbers; i++)
+		codes *= space->colours;
+
+	*arrays = malloc((size_t)codes * space->numbers * sizeof(int));
+	if (!*arrays || CODE_set_init(set, space->numbers, codes) != 0)
+	{
+		free(*arrays);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < codes; i++)
+	{
+		int *code = &(*arrays)[(size_t)i * space->numbers];
+		decode(i, space, code);
+		CODE_set_add(set, CODE_encode(code, space->numbers));
+	}
+	return true;
+}
+
+static bool bench_space(const struct space *space, uint32_t guesses)
+{
+	struct code_set set;
+	int *arrays;
+	if (!build_space(space, &set, &arrays))
+	{
+		perror("Unable to allocate memory for the code space");
+		return false;
+	}
+
+	size_t classes = CODE_CLASSES(space->numbers);
+	uint16_t *scores = malloc(set.length * sizeof(uint16_t));
+	uint16_t *expected = malloc(set.length * sizeof(uint16_t));
+	uint32_t *partitions = malloc(classes * sizeof(uint32_t));
+	uint32_t *expected_partitions = malloc(classes * sizeof(uint32_t));
+	if (!scores || !expected || !partitions || !expected_partitions)
+	{
+		perror("Unable to allocate memory for the scores");
+		free(scores);
+		free(expected);
+		free(partitions);
+		free(expected_partitions);
+		free(arrays);
+		CODE_set_free(&set);
+		return false;
+	}
+
+	// Baseline - int arrays, one pair at a time
+	uint64_t checksum = 0;
+	uint64_t start = now_ns();
+	for (uint32_t g = 0; g < guesses; g++)
+	{
+		const int *guess = &arrays[(size_t)(g * 7919 % set.length) * space->numbers];
+		for (uint32_t i = 0; i < set.length; i++)
+			checksum += SCORE_calculate(&arrays[(size_t)i * space->numbers], guess, space->numbers, space->colours);
+	}
+	double baseline = (double)(now_ns() - start) / ((uint64_t)guesses * set.length);
+	printf("%3hhu %3hhu %8u %-9s %9.3f %9.3f %8.2fx\n", space->numbers, space->colours, set.length,
+		   "pairwise", baseline, 1 / baseline, 1.0);
+
+	bool passed = true;
+	for (size_t k = 0; k < sizeof(kernel_types) / sizeof(kernel_types[0]); k++)
+	{
+		if (!CODE_select_kernel(kernel_types[k]))
+			continue;  // Not supported by this CPU
+
+		uint64_t elapsed = 0;
+		for (uint32_t g = 0; g < guesses; g++)
+		{
+			uint64_t guess = set.codes[g * 7919 % set.length];
+			memset(partitions, 0, classes * sizeof(uint32_t));
+
+			start = now_ns();
+			CODE_score_many(guess, &set, scores, partitions);
+			elapsed += now_ns() - start;
+
+			// Check against the pair by pair scores
+			memset(expected_partitions, 0, classes * sizeof(uint32_t));
+			for (uint32_t i = 0; i < set.length; i++)
+			{
+				expected[i] = CODE_score(set.codes[i], guess, space->numbers);
+				expected_partitions[CODE_CLASS(expected[i], space->numbers)]++;
+			}
+			if (memcmp(scores, expected, set.length * sizeof(uint16_t)) != 0 ||
+				memcmp(partitions, expected_partitions, classes * sizeof(uint32_t)) != 0)
+			{
+				fprintf(stderr, "Error - %s: wrong scores for n=%hhu c=%hhu\n", CODE_kernel_name(),
+						space->numbers, space->colours);
+				passed = false;
+				break;
+			}
+		}
+
+		double ns = (double)elapsed / ((uint64_t)guesses * set.length);
+		printf("%3hhu %3hhu %8u %-9s %9.3f %9.3f %8.2fx\n", space->numbers, space->colours, set.length,
+			   CODE_kernel_name(), ns, 1 / ns, baseline / ns);
+	}
+	CODE_select_kernel(CODE_KERNEL_AUTO);
+
+	if (!checksum)
+		printf("Warning - no matches in the baseline\n");  // Keeps the baseline loop
+
+	free(scores);
+	free(expected);
+	free(partitions);
+	free(expected_partitions);
+	free(arrays);
+	CODE_set_free(&set);
+	return passed;
+}
+
+int main(int argc, char *argv[])
+{
+	int guesses = GUESSES_DEF;
+	if (argc > 1 && (guesses = atoi(argv[1])) <= 0)
+	{
+		fprintf(stderr, "Error - Invalid number of guesses %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	bool passed = true;
+	printf("%3s %3s %8s %-9s %9s %9s %9s\n", "n", "c", "codes", "kernel", "ns/code", "Gcodes/s", "speedup");
+	for (size_t i = 0; i < sizeof(spaces) / sizeof(spaces[0]); i++)
+		passed = bench_space(&spaces[i], guesses) && passed;
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
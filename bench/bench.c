@@ -0,0 +1,992 @@
+/**
+ * Benchmark suite with seeded, repeatable workloads:
+ *   score  - the original algorithm (SCORE_reference) and the kernels across
+ *            sequence lengths (n) and maximum numbers (c)
+ *   secret - secret generation
+ *   lcd    - LCD write paths on the simulated GPIO backend and HD44780
+ *            model, with the bus transactions and the virtual time per screen
+ *   game   - whole games on the game engine in virtual time, entered with
+ *            button events or submitted as whole guesses
+ *   candidates - the candidates of whole games pruned after every guess, in
+ *            the bitset (candidates.h) and compacted by CODE_set_filter
+ *
+ * Every case is timed in samples of a batch of operations. The results
+ * have the mean ns per operation, operations per second and the percentiles
+ * of the ns per operation of the samples, as CSV (default) or JSON, so
+ * the results of two builds can be compared.
+ * Fails if a kernel gives another score than SCORE_calculate on the pairs
+ * of a workload, the simulated display ignored a byte or the two candidate
+ * sets kept different codes.
+ *
+ * Usage: bench [--format=csv|json] [--output=file] [--seed=n] [--samples=n]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "../src/timeunits.h"
+#include "../src/score/score.h"
+#include "../src/code/code.h"
+#include "../src/gpio/gpio.h"
+#include "../src/gpio/gpio_sim.h"
+#include "../src/lcd/lcd.h"
+#include "../src/lcd/lcd_sim.h"
+#include "../src/delay/delay.h"
+#include "../src/timer/timer.h"
+#include "../src/game/game.h"
+#include "../src/rng/rng.h"
+#include "../src/solver/solver.h"
+#include "../src/candidates/candidates.h"
+
+#define SEED_DEF 1
+#define SAMPLES_DEF 100
+// Random pairs (and codes) of a scoring workload, used round robin
+#define POOL_SIZE 4096
+#define NUMBERS_MAX 16
+// Operations per sample
+#define SCORE_BATCH 4096
+#define SECRET_BATCH 4096
+#define LCD_BATCH 16
+#define GAME_BATCH 16
+#define CANDIDATES_BATCH 16
+// Games of the candidates cases checked before the timing
+#define CHECKED_GAMES 64
+// Pin used for R/W in the busy flag runs, see lcd_bench
+#define BENCH_RW_PIN 17
+#define ACCESS_TIME_NS 50
+// Games
+#define GAME_ROUNDS 10
+#define PRESS_NS MS_TO_NS(80ull)
+#define TIMER_TICK_NS MS_TO_NS(10ull)
+
+struct space
+{
+	uint8_t numbers;
+	uint8_t colours;
+};
+
+static const struct space score_spaces[] =
+{
+	{3, 3},
+	{4, 6},
+	{5, 8},
+	{8, 8},
+	{16, 15},
+};
+
+static const struct space game_spaces[] =
+{
+	{3, 3},
+	{4, 6},
+	{5, 8},
+};
+
+/**
+ * Result of one case
+*/
+struct result
+{
+	char name[32];
+	struct space space;  // {0, 0} - not applicable
+	uint64_t ops;
+	double ns_per_op;  // Mean
+	double ops_per_sec;
+	double p50;  // Percentiles of the ns per operation of the samples
+	double p90;
+	double p99;
+	double max;
+	double bus_per_op;  // GPIO register accesses, lcd cases only
+	double virtual_ns_per_op;  // Simulated time, lcd and game cases only
+};
+
+/**
+ * Workload of a case, run_batch performs batch operations and returns
+ * a checksum of their results
+*/
+struct workload
+{
+	const char *name;
+	struct space space;
+	uint32_t batch;
+	uint64_t (*run_batch)(struct workload *workload, uint32_t batch);
+	unsigned int seed;
+	uint32_t next;  // Next pair of the pool
+	int *secrets;  // POOL_SIZE * numbers
+	int *guesses;
+	uint64_t *secret_codes;  // POOL_SIZE
+	uint64_t *guess_codes;
+	struct code_set set;  // POOL_SIZE secret codes
+	uint16_t *scores;  // POOL_SIZE
+	struct rng rng;
+	struct code_set codes;  // Every code of the space, candidates cases only
+	struct candidates candidates;
+	struct arena arena;  // Memory of the games, game cases only
+	uint64_t virtual_ns;  // Simulated time of the last batch
+	bool failed;
+};
+
+static unsigned int base_seed = SEED_DEF;
+static uint32_t samples = SAMPLES_DEF;
+static uint64_t sink;  // Keeps the results of the workloads
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * SEC_TO_NS(1u) + now.tv_nsec;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Seed of a workload, the same for every run with the same --seed
+*/
+static unsigned int workload_seed(const struct workload *workload)
+{
+	unsigned int seed = base_seed;
+	for (const char *c = workload->name; *c; c++)
+		seed = seed * 31 + *c;
+	return seed ^ (workload->space.numbers << 16 | workload->space.colours << 8);
+}
+
+static void random_code(const struct space *space, unsigned int *seed, int code[])
+{
+	for (uint8_t i = 0; i < space->numbers; i++)
+		code[i] = rand_r(seed) % space->colours + 1;
+}
+
+/**
+ * Runs the samples of the workload
+*/
+static bool measure(struct workload *workload, struct result *result)
+{
+	double *per_op = malloc(samples * sizeof(double));
+	if (!per_op)
+	{
+		perror("Unable to allocate memory for the samples");
+		return false;
+	}
+
+	memset(result, 0, sizeof(*result));
+	snprintf(result->name, sizeof(result->name), "%s", workload->name);
+	result->space = workload->space;
+
+	workload->run_batch(workload, workload->batch);  // Warm up
+
+	uint64_t total = 0;
+	uint64_t virtual_total = 0;
+	for (uint32_t i = 0; i < samples && !workload->failed; i++)
+	{
+		uint64_t start = now_ns();
+		sink += workload->run_batch(workload, workload->batch);
+		uint64_t elapsed = now_ns() - start;
+
+		total += elapsed;
+		virtual_total += workload->virtual_ns;
+		per_op[i] = (double)elapsed / workload->batch;
+	}
+
+	result->ops = (uint64_t)samples * workload->batch;
+	result->ns_per_op = (double)total / result->ops;
+	result->ops_per_sec = total ? result->ops / (total / 1e9) : 0;
+	result->virtual_ns_per_op = (double)virtual_total / result->ops;
+
+	qsort(per_op, samples, sizeof(double), compare_double);
+	result->p50 = per_op[samples / 2];
+	result->p90 = per_op[(uint64_t)samples * 90 / 100];
+	result->p99 = per_op[(uint64_t)samples * 99 / 100];
+	result->max = per_op[samples - 1];
+
+	free(per_op);
+	return !workload->failed;
+}
+
+/* Scoring */
+
+static bool init_pairs(struct workload *workload)
+{
+	const struct space *space = &workload->space;
+	workload->secrets = malloc(POOL_SIZE * space->numbers * sizeof(int));
+	workload->guesses = malloc(POOL_SIZE * space->numbers * sizeof(int));
+	workload->secret_codes = malloc(POOL_SIZE * sizeof(uint64_t));
+	workload->guess_codes = malloc(POOL_SIZE * sizeof(uint64_t));
+	workload->scores = malloc(POOL_SIZE * sizeof(uint16_t));
+	if (!workload->secrets || !workload->guesses || !workload->secret_codes || !workload->guess_codes ||
+		!workload->scores || CODE_set_init(&workload->set, space->numbers, POOL_SIZE) != 0)
+	{
+		perror("Unable to allocate memory for the pairs");
+		return false;
+	}
+
+	workload->seed = workload_seed(workload);
+	for (uint32_t i = 0; i < POOL_SIZE; i++)
+	{
+		int *secret = &workload->secrets[i * space->numbers];
+		int *guess = &workload->guesses[i * space->numbers];
+		random_code(space, &workload->seed, secret);
+		random_code(space, &workload->seed, guess);
+		workload->secret_codes[i] = CODE_encode(secret, space->numbers);
+		workload->guess_codes[i] = CODE_encode(guess, space->numbers);
+		CODE_set_add(&workload->set, workload->secret_codes[i]);
+	}
+
+	// Every kernel has to agree on the pairs, checked outside of the timing
+	CODE_score_many(workload->guess_codes[0], &workload->set, workload->scores, NULL);
+	for (uint32_t i = 0; i < POOL_SIZE; i++)
+	{
+		uint16_t score = SCORE_calculate(&workload->secrets[i * space->numbers],
+										 &workload->guesses[i * space->numbers], space->numbers, space->colours);
+		uint16_t many = CODE_score(workload->secret_codes[i], workload->guess_codes[0], space->numbers);
+		uint16_t unrolled = SCORE_kernel(space->numbers)(&workload->secrets[i * space->numbers],
+														 &workload->guesses[i * space->numbers],
+														 space->numbers, space->colours);
+		if (CODE_score(workload->secret_codes[i], workload->guess_codes[i], space->numbers) != score ||
+			workload->scores[i] != many || unrolled != score)
+			workload->failed = true;
+	}
+	return true;
+}
+
+static void free_pairs(struct workload *workload)
+{
+	free(workload->secrets);
+	free(workload->guesses);
+	free(workload->secret_codes);
+	free(workload->guess_codes);
+	free(workload->scores);
+	CODE_set_free(&workload->set);
+}
+
+static uint64_t run_reference(struct workload *workload, uint32_t batch)
+{
+	uint8_t numbers = workload->space.numbers;
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < batch; i++)
+	{
+		uint32_t pair = workload->next++ % POOL_SIZE;
+		int exact = 0;
+		int approx = 0;
+		SCORE_reference(&exact, &approx, &workload->secrets[pair * numbers],
+						&workload->guesses[pair * numbers], numbers);
+		sum += exact << 8 | approx;
+	}
+	return sum;
+}
+
+static uint64_t run_kernel(struct workload *workload, uint32_t batch)
+{
+	uint8_t numbers = workload->space.numbers;
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < batch; i++)
+	{
+		uint32_t pair = workload->next++ % POOL_SIZE;
+		sum += SCORE_calculate(&workload->secrets[pair * numbers], &workload->guesses[pair * numbers],
+							   numbers, workload->space.colours);
+	}
+	return sum;
+}
+
+/**
+ * The kernel of the sequence length, the way the game scores a guess
+*/
+static uint64_t run_unrolled(struct workload *workload, uint32_t batch)
+{
+	uint8_t numbers = workload->space.numbers;
+	score_kernel kernel = SCORE_kernel(numbers);
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < batch; i++)
+	{
+		uint32_t pair = workload->next++ % POOL_SIZE;
+		sum += kernel(&workload->secrets[pair * numbers], &workload->guesses[pair * numbers], numbers,
+					  workload->space.colours);
+	}
+	return sum;
+}
+
+static uint64_t run_packed(struct workload *workload, uint32_t batch)
+{
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < batch; i++)
+	{
+		uint32_t pair = workload->next++ % POOL_SIZE;
+		sum += CODE_score(workload->secret_codes[pair], workload->guess_codes[pair], workload->space.numbers);
+	}
+	return sum;
+}
+
+/**
+ * One operation is one code of the set, a batch is a whole number of guesses
+*/
+static uint64_t run_many(struct workload *workload, uint32_t batch)
+{
+	uint64_t sum = 0;
+	for (uint32_t done = 0; done < batch; done += POOL_SIZE)
+	{
+		uint32_t pair = workload->next++ % POOL_SIZE;
+		CODE_score_many(workload->guess_codes[pair], &workload->set, workload->scores, NULL);
+		sum += workload->scores[pair];
+	}
+	return sum;
+}
+
+/* Secret generation */
+
+/**
+ * rand() % max + 1 for every number, the way the game generated its secrets
+ * before the rng module
+*/
+static uint64_t run_secret(struct workload *workload, uint32_t batch)
+{
+	int secret[NUMBERS_MAX];
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < batch; i++)
+	{
+		for (uint8_t n = 0; n < workload->space.numbers; n++)
+			secret[n] = (rand() % workload->space.colours) + 1;
+		sum += secret[i % workload->space.numbers];
+	}
+	return sum;
+}
+
+/**
+ * One secret at a time, the way the game and the server do it
+*/
+static uint64_t run_rng_secret(struct workload *workload, uint32_t batch)
+{
+	int secret[NUMBERS_MAX];
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < batch; i++)
+	{
+		RNG_code(&workload->rng, secret, workload->space.numbers, workload->space.colours);
+		sum += secret[i % workload->space.numbers];
+	}
+	return sum;
+}
+
+/**
+ * Packed secrets in one call, the way the simulation does it
+*/
+static uint64_t run_rng_batch(struct workload *workload, uint32_t batch)
+{
+	uint64_t secrets[SECRET_BATCH];
+	RNG_codes(&workload->rng, secrets, batch, workload->space.numbers, workload->space.colours);
+	return secrets[batch / 2];
+}
+
+/* LCD */
+
+static char lcd_rows[LCD_ROWS][LCD_COLUMNS + 1];
+
+/**
+ * Draws a feedback screen, every fourth one after clearing the display
+*/
+static void draw_screen(uint32_t i)
+{
+	snprintf(lcd_rows[0], LCD_COLUMNS + 1, "Exact: %-9u", i % 10);
+	snprintf(lcd_rows[1], LCD_COLUMNS + 1, "Approx: %-8u", (i / 10) % 10);
+	if (i % 4 == 0)
+		LCD_clear();
+	LCD_buffer_clear();
+	LCD_buffer_write(0, 0, lcd_rows[0]);
+	LCD_buffer_write(0, 1, lcd_rows[1]);
+	LCD_flush();
+}
+
+static void lcd_setup(uint8_t rw_pin)
+{
+	GPIO_sim_reset();
+	GPIO_init();
+	LCD_sim_attach(rw_pin);
+	LCD_set_rw_pin(rw_pin);
+	LCD_init(false);
+}
+
+/**
+ * The screen changes every time
+*/
+static uint64_t run_lcd_screens(struct workload *workload, uint32_t batch)
+{
+	uint64_t start = GPIO_sim_now();
+	for (uint32_t i = 0; i < batch; i++)
+		draw_screen(workload->next++);
+	workload->virtual_ns = GPIO_sim_now() - start;
+	return workload->next;
+}
+
+/**
+ * The same screen is flushed again, nothing has to be sent
+*/
+static uint64_t run_lcd_unchanged(struct workload *workload, uint32_t batch)
+{
+	uint64_t start = GPIO_sim_now();
+	for (uint32_t i = 0; i < batch; i++)
+	{
+		LCD_buffer_write(0, 0, lcd_rows[0]);
+		LCD_buffer_write(0, 1, lcd_rows[1]);
+		LCD_flush();
+	}
+	workload->virtual_ns = GPIO_sim_now() - start;
+	return batch;
+}
+
+/**
+ * Runs an lcd workload, adds the bus transactions and checks the display
+*/
+static bool measure_lcd(struct workload *workload, uint8_t rw_pin, struct result *result)
+{
+	lcd_setup(rw_pin);
+	draw_screen(0);
+
+	struct gpio_sim_counters before;
+	GPIO_sim_get_counters(&before);
+	bool passed = measure(workload, result);
+	struct gpio_sim_counters after;
+	GPIO_sim_get_counters(&after);
+
+	// The warm up batch is counted too
+	uint64_t ops = result->ops + workload->batch;
+	result->bus_per_op = (double)(after.reads - before.reads + after.writes - before.writes) / ops;
+
+	struct lcd_sim_counters lcd;
+	LCD_sim_get_counters(&lcd);
+	if (lcd.violations)
+	{
+		fprintf(stderr, "Error - %s: %llu bytes sent while the display was busy\n", workload->name,
+				(unsigned long long)lcd.violations);
+		passed = false;
+	}
+	for (uint8_t row = 0; row < LCD_ROWS; row++)
+	{
+		char shown[LCD_COLUMNS + 1];
+		LCD_sim_get_row(row, shown);
+		if (strcmp(shown, lcd_rows[row]) != 0)
+		{
+			fprintf(stderr, "Error - %s: row %hhu shows \"%s\" instead of \"%s\"\n", workload->name, row,
+					shown, lcd_rows[row]);
+			passed = false;
+		}
+	}
+
+	LCD_sim_detach();
+	LCD_set_rw_pin(LCD_RW_NONE);
+	return passed;
+}
+
+/* Games */
+
+struct simulated_game
+{
+	uint64_t guesses;
+	bool won;
+};
+
+static void on_guess(void *context, const int *guess, uint8_t length)
+{
+	(void)guess;
+	(void)length;
+	((struct simulated_game *)context)->guesses++;
+}
+
+static void on_success(void *context, uint8_t rounds)
+{
+	(void)rounds;
+	((struct simulated_game *)context)->won = true;
+}
+
+static const struct game_output game_output =
+{
+	.guess = on_guess,
+	.success = on_success,
+};
+
+static void press(struct game *game, struct timer_wheel *wheel, uint64_t *now)
+{
+	GAME_button(game, 1, *now);
+	*now += PRESS_NS;
+	GAME_button(game, 0, *now);
+	*now += PRESS_NS;
+	TIMER_advance(wheel, *now);
+}
+
+/**
+ * Plays one game with random guesses, returns the number of guesses.
+ * buttons - every digit is entered with presses and accepted by the timer,
+ * otherwise the guesses are submitted whole (the way the server does it).
+*/
+static uint64_t play_game(struct workload *workload, bool buttons, uint64_t *now)
+{
+	const struct space *space = &workload->space;
+	struct game_settings settings =
+	{
+		.numbers = space->numbers,
+		.rounds = GAME_ROUNDS,
+		.max = space->colours,
+		.input_timeout = MS_TO_NS((uint64_t)GAME_INPUT_TIMEOUT_MS),
+	};
+	struct simulated_game played = {0};
+	struct timer_wheel wheel;
+	struct game game;
+	TIMER_wheel_init(&wheel, TIMER_TICK_NS, *now);
+	ARENA_reset(&workload->arena);
+	if (GAME_init(&game, &settings, &game_output, &played, &wheel, &workload->arena) != 0)
+	{
+		workload->failed = true;
+		return 0;
+	}
+
+	int secret[NUMBERS_MAX];
+	int guess[NUMBERS_MAX];
+	random_code(space, &workload->seed, secret);
+	GAME_start(&game, secret);
+
+	while (!GAME_is_over(&game) && !workload->failed)
+	{
+		if (game.state == GAME_CONTINUE)
+		{
+			press(&game, &wheel, now);
+			continue;
+		}
+
+		random_code(space, &workload->seed, guess);
+		if (!buttons)
+		{
+			workload->failed = GAME_submit_guess(&game, guess) != 0;
+			continue;
+		}
+		for (uint8_t n = 0; n < space->numbers; n++)
+		{
+			for (int p = 0; p < guess[n]; p++)
+				press(&game, &wheel, now);
+			*now += settings.input_timeout;
+			TIMER_advance(&wheel, *now);
+		}
+	}
+
+	GAME_free(&game);
+	return played.guesses;
+}
+
+static uint64_t run_games(struct workload *workload, uint32_t batch, bool buttons)
+{
+	uint64_t now = 0;
+	uint64_t guesses = 0;
+	for (uint32_t i = 0; i < batch; i++)
+		guesses += play_game(workload, buttons, &now);
+	workload->virtual_ns = now;
+	return guesses;
+}
+
+static uint64_t run_button_games(struct workload *workload, uint32_t batch)
+{
+	return run_games(workload, batch, true);
+}
+
+static uint64_t run_submitted_games(struct workload *workload, uint32_t batch)
+{
+	return run_games(workload, batch, false);
+}
+
+/* Candidate sets */
+
+/**
+ * Plays a game against the secret with the bitset, always guessing the
+ * candidate of the lowest rank. Returns the sum of the remaining counts.
+*/
+static uint64_t prune_bitset(struct workload *workload, uint64_t secret)
+{
+	struct candidates *candidates = &workload->candidates;
+	uint8_t numbers = workload->space.numbers;
+	uint64_t sum = 0;
+
+	CANDIDATES_reset(candidates);
+	for (;;)
+	{
+		uint64_t guess = CANDIDATES_code(candidates, CANDIDATES_next(candidates, 0));
+		sum += CANDIDATES_prune(candidates, guess, CODE_score(secret, guess, numbers));
+		if (guess == secret)
+			return sum;
+	}
+}
+
+/**
+ * Same game as prune_bitset with the codes compacted by CODE_set_filter,
+ * which keeps them in rank order
+*/
+static uint64_t prune_filter(struct workload *workload, uint64_t secret)
+{
+	const struct code_set *remaining = &workload->codes;
+	uint8_t numbers = workload->space.numbers;
+	uint64_t sum = 0;
+
+	for (;;)
+	{
+		uint64_t guess = remaining->codes[0];
+		sum += CODE_set_filter(remaining, &workload->set, guess, CODE_score(secret, guess, numbers),
+							   workload->scores);
+		remaining = &workload->set;
+		if (guess == secret)
+			return sum;
+	}
+}
+
+static bool init_candidates(struct workload *workload)
+{
+	const struct space *space = &workload->space;
+	if (SOLVER_space_init(&workload->codes, space->numbers, space->colours) != 0 ||
+		CANDIDATES_init(&workload->candidates, &workload->codes, space->colours, NULL) != 0 ||
+		CODE_set_init(&workload->set, space->numbers, workload->codes.length) != 0 ||
+		!(workload->scores = malloc(workload->codes.length * sizeof(uint16_t))))
+	{
+		perror("Unable to allocate memory for the candidates");
+		return false;
+	}
+
+	// Both sets have to keep the same codes, checked outside of the timing
+	workload->seed = workload_seed(workload);
+	for (uint32_t i = 0; i < CHECKED_GAMES; i++)
+	{
+		uint64_t secret = workload->codes.codes[rand_r(&workload->seed) % workload->codes.length];
+		if (prune_bitset(workload, secret) != prune_filter(workload, secret))
+			workload->failed = true;
+	}
+	return true;
+}
+
+static void free_candidates(struct workload *workload)
+{
+	CANDIDATES_free(&workload->candidates);
+	CODE_set_free(&workload->codes);
+	CODE_set_free(&workload->set);
+	free(workload->scores);
+}
+
+static uint64_t run_candidates(struct workload *workload, uint32_t batch, bool bitset)
+{
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < batch; i++)
+	{
+		uint64_t secret = workload->codes.codes[rand_r(&workload->seed) % workload->codes.length];
+		sum += bitset ? prune_bitset(workload, secret) : prune_filter(workload, secret);
+	}
+	return sum;
+}
+
+static uint64_t run_bitset(struct workload *workload, uint32_t batch)
+{
+	return run_candidates(workload, batch, true);
+}
+
+static uint64_t run_filter(struct workload *workload, uint32_t batch)
+{
+	return run_candidates(workload, batch, false);
+}
+
+/* Output */
+
+static void print_csv_header(FILE *out)
+{
+	fprintf(out, "name,n,c,ops,ns_per_op,ops_per_sec,p50_ns,p90_ns,p99_ns,max_ns,bus_per_op,virtual_ns_per_op\n");
+}
+
+static void print_csv(FILE *out, const struct result *result)
+{
+	fprintf(out, "%s,%hhu,%hhu,%llu,%.3f,%.1f,%.3f,%.3f,%.3f,%.3f,%.2f,%.1f\n", result->name,
+			result->space.numbers, result->space.colours, (unsigned long long)result->ops, result->ns_per_op,
+			result->ops_per_sec, result->p50, result->p90, result->p99, result->max, result->bus_per_op,
+			result->virtual_ns_per_op);
+}
+
+static void print_json(FILE *out, const struct result *result, bool first)
+{
+	fprintf(out, "%s\n    {\"name\": \"%s\", \"n\": %hhu, \"c\": %hhu, \"ops\": %llu, \"ns_per_op\": %.3f, "
+			"\"ops_per_sec\": %.1f, \"p50_ns\": %.3f, \"p90_ns\": %.3f, \"p99_ns\": %.3f, \"max_ns\": %.3f, "
+			"\"bus_per_op\": %.2f, \"virtual_ns_per_op\": %.1f}", first ? "" : ",", result->name,
+			result->space.numbers, result->space.colours, (unsigned long long)result->ops, result->ns_per_op,
+			result->ops_per_sec, result->p50, result->p90, result->p99, result->max, result->bus_per_op,
+			result->virtual_ns_per_op);
+}
+
+struct output
+{
+	FILE *file;
+	bool json;
+	uint32_t results;
+};
+
+static void report(struct output *output, const struct result *result)
+{
+	if (output->json)
+		print_json(output->file, result, output->results == 0);
+	else
+		print_csv(output->file, result);
+	output->results++;
+	fflush(output->file);
+}
+
+/* Cases */
+
+static bool bench_scoring(struct output *output)
+{
+	static const struct
+	{
+		const char *name;
+		uint64_t (*run_batch)(struct workload *workload, uint32_t batch);
+	} kernels[] =
+	{
+		{"score/reference", run_reference},
+		{"score/kernel", run_kernel},
+		{"score/unrolled", run_unrolled},
+		{"score/packed", run_packed},
+		{"score/many", run_many},
+	};
+
+	bool passed = true;
+	for (size_t s = 0; s < sizeof(score_spaces) / sizeof(score_spaces[0]); s++)
+	{
+		for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+		{
+			struct workload workload =
+			{
+				.name = kernels[k].name,
+				.space = score_spaces[s],
+				.batch = SCORE_BATCH,
+				.run_batch = kernels[k].run_batch,
+			};
+			struct result result;
+			bool ok = init_pairs(&workload) && measure(&workload, &result);
+			if (ok)
+				report(output, &result);
+			else
+				fprintf(stderr, "Error - %s: wrong scores for n=%hhu c=%hhu\n", workload.name,
+						workload.space.numbers, workload.space.colours);
+			passed = passed && ok;
+			free_pairs(&workload);
+		}
+	}
+	return passed;
+}
+
+static bool bench_secrets(struct output *output)
+{
+	static const struct
+	{
+		const char *name;
+		uint64_t (*run_batch)(struct workload *workload, uint32_t batch);
+	} generators[] =
+	{
+		{"secret/rand", run_secret},
+		{"secret/rng", run_rng_secret},
+		{"secret/rng-batch", run_rng_batch},
+	};
+
+	bool passed = true;
+	for (size_t s = 0; s < sizeof(game_spaces) / sizeof(game_spaces[0]); s++)
+	{
+		for (size_t g = 0; g < sizeof(generators) / sizeof(generators[0]); g++)
+		{
+			struct workload workload =
+			{
+				.name = generators[g].name,
+				.space = game_spaces[s],
+				.batch = SECRET_BATCH,
+				.run_batch = generators[g].run_batch,
+			};
+			srand(workload_seed(&workload));
+			RNG_seed(&workload.rng, workload_seed(&workload));
+			struct result result;
+			passed = measure(&workload, &result) && passed;
+			report(output, &result);
+		}
+	}
+	return passed;
+}
+
+static bool bench_lcd(struct output *output)
+{
+	static const struct
+	{
+		const char *name;
+		uint8_t rw_pin;
+		uint64_t (*run_batch)(struct workload *workload, uint32_t batch);
+	} paths[] =
+	{
+		{"lcd/fixed-delay", LCD_RW_NONE, run_lcd_screens},
+		{"lcd/busy-flag", BENCH_RW_PIN, run_lcd_screens},
+		{"lcd/unchanged", LCD_RW_NONE, run_lcd_unchanged},
+	};
+
+	GPIO_set_backend(GPIO_BACKEND_SIM);
+	GPIO_sim_use_manual_clock(true);
+	GPIO_sim_set_access_time(ACCESS_TIME_NS);
+	DELAY_set_hook(GPIO_sim_advance);  // Delays move the virtual clock
+
+	bool passed = true;
+	for (size_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++)
+	{
+		struct workload workload =
+		{
+			.name = paths[p].name,
+			.batch = LCD_BATCH,
+			.run_batch = paths[p].run_batch,
+		};
+		struct result result;
+		passed = measure_lcd(&workload, paths[p].rw_pin, &result) && passed;
+		report(output, &result);
+	}
+
+	DELAY_set_hook(NULL);
+	return passed;
+}
+
+static bool bench_games(struct output *output)
+{
+	static const struct
+	{
+		const char *name;
+		uint64_t (*run_batch)(struct workload *workload, uint32_t batch);
+	} modes[] =
+	{
+		{"game/buttons", run_button_games},
+		{"game/submitted", run_submitted_games},
+	};
+
+	bool passed = true;
+	for (size_t s = 0; s < sizeof(game_spaces) / sizeof(game_spaces[0]); s++)
+	{
+		for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+		{
+			struct workload workload =
+			{
+				.name = modes[m].name,
+				.space = game_spaces[s],
+				.batch = GAME_BATCH,
+				.run_batch = modes[m].run_batch,
+			};
+			workload.seed = workload_seed(&workload);
+			if (ARENA_init(&workload.arena, GAME_ARENA_SIZE(workload.space.numbers)) != 0)
+				return false;
+			struct result result;
+			passed = measure(&workload, &result) && passed;
+			report(output, &result);
+			ARENA_free(&workload.arena);
+		}
+	}
+	return passed;
+}
+
+static bool bench_candidates(struct output *output)
+{
+	static const struct
+	{
+		const char *name;
+		uint64_t (*run_batch)(struct workload *workload, uint32_t batch);
+	} sets[] =
+	{
+		{"candidates/bitset", run_bitset},
+		{"candidates/filter", run_filter},
+	};
+
+	bool passed = true;
+	for (size_t s = 0; s < sizeof(game_spaces) / sizeof(game_spaces[0]); s++)
+	{
+		for (size_t k = 0; k < sizeof(sets) / sizeof(sets[0]); k++)
+		{
+			struct workload workload =
+			{
+				.name = sets[k].name,
+				.space = game_spaces[s],
+				.batch = CANDIDATES_BATCH,
+				.run_batch = sets[k].run_batch,
+			};
+			struct result result;
+			bool ok = init_candidates(&workload) && measure(&workload, &result);
+			if (ok)
+				report(output, &result);
+			else
+				fprintf(stderr, "Error - %s: different candidates for n=%hhu c=%hhu\n", workload.name,
+						workload.space.numbers, workload.space.colours);
+			passed = passed && ok;
+			free_candidates(&workload);
+		}
+	}
+	return passed;
+}
+
+/**
+ * Parses "--name=value" with a positive number, returns false if arg is not
+ * the option
+*/
+static bool parse_option(const char *arg, const char *name, uint32_t *value, bool *valid)
+{
+	size_t length = strlen(name);
+	if (strncmp(arg, name, length) != 0 || arg[length] != '=')
+		return false;
+
+	char *end;
+	unsigned long number = strtoul(arg + length + 1, &end, 10);
+	*valid = *end == '\0' && end != arg + length + 1 && number > 0 && number <= UINT32_MAX;
+	if (*valid)
+		*value = number;
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	struct output output = {.file = stdout};
+	const char *path = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool valid = true;
+		uint32_t seed;
+		if (strcmp(argv[i], "--format=json") == 0)
+			output.json = true;
+		else if (strcmp(argv[i], "--format=csv") == 0)
+			output.json = false;
+		else if (strncmp(argv[i], "--output=", 9) == 0)
+			path = argv[i] + 9;
+		else if (parse_option(argv[i], "--seed", &seed, &valid))
+			base_seed = seed;
+		else if (!parse_option(argv[i], "--samples", &samples, &valid))
+			valid = false;
+
+		if (!valid)
+		{
+			fprintf(stderr, "Error - Invalid argument %s\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (path && !(output.file = fopen(path, "w")))
+	{
+		perror("Unable to create the output file");
+		return EXIT_FAILURE;
+	}
+
+	if (output.json)
+		fprintf(output.file, "{\n  \"seed\": %u,\n  \"samples\": %u,\n  \"results\": [", base_seed, samples);
+	else
+		print_csv_header(output.file);
+
+	bool passed = bench_scoring(&output);
+	passed = bench_secrets(&output) && passed;
+	passed = bench_lcd(&output) && passed;
+	passed = bench_games(&output) && passed;
+	passed = bench_candidates(&output) && passed;
+
+	if (output.json)
+		fprintf(output.file, "\n  ]\n}\n");
+	if (!sink)
+		fprintf(stderr, "Warning - Empty results\n");  // Keeps the workloads
+
+	if (path)
+		fclose(output.file);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
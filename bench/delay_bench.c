@@ -0,0 +1,122 @@
+/**
+ * Timing-jitter benchmark of the delays used by the LCD driver.
+ * For every requested delay it measures the actual delay of a plain
+ * nanosleep() and of DELAY_ns() and prints the p50/p99/max of both.
+ *
+ * Usage: delay_bench [samples per delay]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "../src/timeunits.h"
+#include "../src/delay/delay.h"
+
+#define SAMPLES_DEF 200
+// Long delays are measured fewer times to keep the run short
+#define LONG_DELAY_NS MS_TO_NS(1)
+#define LONG_DELAY_SAMPLES_DIV 10
+
+// Delays used by the LCD driver
+static const uint64_t requested[] =
+{
+	US_TO_NS(50),
+	US_TO_NS(100),
+	MS_TO_NS(1),
+	MS_TO_NS(2),
+	MS_TO_NS(5),
+	MS_TO_NS(15),
+};
+
+static void nanosleep_ns(uint64_t ns)
+{
+	struct timespec delay =
+	{
+		.tv_sec = ns / SEC_TO_NS(1u),
+		.tv_nsec = ns % SEC_TO_NS(1u),
+	};
+	nanosleep(&delay, NULL);
+}
+
+struct method
+{
+	const char *name;
+	void (*delay)(uint64_t ns);
+};
+
+static const struct method methods[] =
+{
+	{"nanosleep", nanosleep_ns},
+	{"DELAY_ns", DELAY_ns},
+};
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Returns the value at the given percentile of a sorted array
+*/
+static uint64_t percentile(const uint64_t *sorted, int count, int pct)
+{
+	int index = (count * pct) / 100;
+	if (index >= count)
+		index = count - 1;
+	return sorted[index];
+}
+
+int main(int argc, char *argv[])
+{
+	int samples = SAMPLES_DEF;
+	if (argc > 1 && (samples = atoi(argv[1])) <= 0)
+	{
+		fprintf(stderr, "Error - Invalid number of samples %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	uint64_t *actual = malloc(samples * sizeof(uint64_t));
+	if (!actual)
+	{
+		perror("Unable to allocate memory for the samples");
+		return EXIT_FAILURE;
+	}
+
+	DELAY_calibrate();
+	printf("Spin time: %.1f us\n", DELAY_get_spin_time() / 1e3);
+	printf("%-10s %12s %8s %10s %10s %10s %12s\n",
+		   "method", "requested_us", "samples", "p50_us", "p99_us", "max_us", "p50_over_%");
+
+	for (size_t r = 0; r < sizeof(requested) / sizeof(requested[0]); r++)
+	{
+		int count = requested[r] >= LONG_DELAY_NS ? samples / LONG_DELAY_SAMPLES_DIV : samples;
+		if (count < 1)
+			count = 1;
+
+		for (size_t m = 0; m < sizeof(methods) / sizeof(methods[0]); m++)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				uint64_t start = DELAY_now();
+				methods[m].delay(requested[r]);
+				actual[i] = DELAY_now() - start;
+			}
+			qsort(actual, count, sizeof(actual[0]), compare_u64);
+
+			uint64_t p50 = percentile(actual, count, 50);
+			printf("%-10s %12.1f %8d %10.1f %10.1f %10.1f %12.1f\n",
+				   methods[m].name,
+				   requested[r] / 1e3,
+				   count,
+				   p50 / 1e3,
+				   percentile(actual, count, 99) / 1e3,
+				   actual[count - 1] / 1e3,
+				   100.0 * ((double)p50 - requested[r]) / requested[r]);
+		}
+	}
+
+	free(actual);
+	return EXIT_SUCCESS;
+}
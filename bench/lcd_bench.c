@@ -0,0 +1,131 @@
+/**
+ * Compares the fixed LCD delays with busy flag polling on the simulated
+ * GPIO backend and HD44780 model, on the manual (virtual) clock.
+ * Fails if the display ignored a byte (sent while busy) or shows
+ * something else than what was drawn.
+ *
+ * Usage: lcd_bench [screens]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../src/timeunits.h"
+#include "../src/gpio/gpio.h"
+#include "../src/gpio/gpio_sim.h"
+#include "../src/lcd/lcd.h"
+#include "../src/lcd/lcd_sim.h"
+#include "../src/delay/delay.h"
+
+#define SCREENS_DEF 1000
+// Pin used for R/W in the busy flag run
+#define BENCH_RW_PIN 17
+// Virtual cost of one GPIO register access
+#define ACCESS_TIME_NS 50
+
+struct run
+{
+	const char *name;
+	uint8_t rw_pin;
+};
+
+static const struct run runs[] =
+{
+	{"fixed-delay", LCD_RW_NONE},
+	{"busy-flag", BENCH_RW_PIN},
+};
+
+/**
+ * Draws the screens of a game: feedback and the digits of a guess
+*/
+static void draw_screens(int screens, char rows[LCD_ROWS][LCD_COLUMNS + 1])
+{
+	for (int i = 0; i < screens; i++)
+	{
+		snprintf(rows[0], LCD_COLUMNS + 1, "Exact: %-9d", i % 10);
+		snprintf(rows[1], LCD_COLUMNS + 1, "Approx: %-8d", (i / 10) % 10);
+		if (i % 4 == 0)
+			LCD_clear();
+		LCD_buffer_clear();
+		LCD_buffer_write(0, 0, rows[0]);
+		LCD_buffer_write(0, 1, rows[1]);
+		LCD_flush();
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int screens = SCREENS_DEF;
+	if (argc > 1 && (screens = atoi(argv[1])) <= 0)
+	{
+		fprintf(stderr, "Error - Invalid number of screens %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	GPIO_set_backend(GPIO_BACKEND_SIM);
+	GPIO_sim_use_manual_clock(true);
+	GPIO_sim_set_access_time(ACCESS_TIME_NS);
+	DELAY_set_hook(GPIO_sim_advance);  // Delays move the virtual clock
+
+	bool passed = true;
+	printf("%-12s %8s %12s %12s %10s %10s %11s %10s\n", "mode", "screens", "virtual_ms",
+		   "us_per_byte", "writes", "reads", "busy_reads", "violations");
+
+	for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++)
+	{
+		GPIO_sim_reset();
+		GPIO_init();
+		LCD_sim_attach(runs[r].rw_pin);
+		LCD_set_rw_pin(runs[r].rw_pin);
+		LCD_init(false);
+
+		struct gpio_sim_counters before;
+		struct lcd_sim_counters lcd_before;
+		GPIO_sim_get_counters(&before);
+		LCD_sim_get_counters(&lcd_before);
+		uint64_t start = GPIO_sim_now();
+
+		char rows[LCD_ROWS][LCD_COLUMNS + 1];
+		draw_screens(screens, rows);
+
+		uint64_t elapsed = GPIO_sim_now() - start;
+		struct gpio_sim_counters after;
+		struct lcd_sim_counters lcd;
+		GPIO_sim_get_counters(&after);
+		LCD_sim_get_counters(&lcd);
+		uint64_t bytes = (lcd.instructions - lcd_before.instructions) + (lcd.data - lcd_before.data);
+
+		printf("%-12s %8d %12.3f %12.2f %10llu %10llu %11llu %10llu\n",
+			   runs[r].name, screens, elapsed / 1e6, bytes ? elapsed / 1e3 / bytes : 0.0,
+			   (unsigned long long)(after.writes - before.writes),
+			   (unsigned long long)(after.reads - before.reads),
+			   (unsigned long long)lcd.busy_reads,
+			   (unsigned long long)lcd.violations);
+
+		// Regression checks
+		if (lcd.violations)
+		{
+			fprintf(stderr, "Error - %s: %llu bytes sent while the display was busy\n",
+					runs[r].name, (unsigned long long)lcd.violations);
+			passed = false;
+		}
+		for (uint8_t row = 0; row < LCD_ROWS; row++)
+		{
+			char shown[LCD_COLUMNS + 1];
+			LCD_sim_get_row(row, shown);
+			if (strcmp(shown, rows[row]) != 0)
+			{
+				fprintf(stderr, "Error - %s: row %hhu shows \"%s\" instead of \"%s\"\n",
+						runs[r].name, row, shown, rows[row]);
+				passed = false;
+			}
+		}
+
+		LCD_sim_detach();
+	}
+
+	LCD_set_rw_pin(LCD_RW_NONE);
+	DELAY_set_hook(NULL);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
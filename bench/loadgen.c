@@ -0,0 +1,365 @@
+/**
+ * Load generator of the Mastermind server.
+ * Opens many connections, plays random guesses on all of them and reports
+ * the number of guesses per second and the reply latency. Without an
+ * address it starts its own server (in a thread) on a temporary Unix socket,
+ * otherwise it connects to a running one: a TCP port or host:port, or a
+ * Unix socket path (see SERVER_parse_address).
+ * Fails if the server gives an unexpected reply.
+ *
+ * Usage: loadgen [clients] [guesses per client] [threads] [address]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "../src/timeunits.h"
+#include "../src/game/game.h"
+#include "../src/server/server.h"
+
+#define CLIENTS_DEF 1000
+#define GUESSES_DEF 100
+#define THREADS_DEF 4
+// Settings of the played games
+#define NUMBERS 4
+#define MAX 6
+#define ROUNDS 10
+
+struct client
+{
+	int fd;
+	bool playing;  // Game started, the next request is a guess
+	size_t length;
+	char in[128];
+};
+
+struct worker
+{
+	pthread_t thread;
+	struct client *clients;
+	uint32_t count;  // Number of clients
+	uint32_t guesses;  // Per client
+	uint64_t *latencies;  // ns, count * guesses
+	unsigned int seed;
+	bool failed;
+};
+
+// Address of the server the clients connect to
+static struct sockaddr_storage server_address;
+static socklen_t server_address_length;
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * SEC_TO_NS(1u) + now.tv_nsec;
+}
+
+static int connect_client(void)
+{
+	int fd = socket(server_address.ss_family, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	if (connect(fd, (struct sockaddr *)&server_address, server_address_length) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static bool send_line(struct client *client, const char *line, size_t length)
+{
+	return send(client->fd, line, length, MSG_NOSIGNAL) == (ssize_t)length;
+}
+
+/**
+ * Reads one reply line (without the newline)
+*/
+static bool read_line(struct client *client, char *line, size_t size)
+{
+	char *end;
+	while (!(end = memchr(client->in, '\n', client->length)))
+	{
+		if (client->length == sizeof(client->in))
+			return false;
+		ssize_t received = recv(client->fd, client->in + client->length, sizeof(client->in) - client->length, 0);
+		if (received <= 0)
+			return false;
+		client->length += received;
+	}
+
+	size_t length = end - client->in;
+	if (length >= size)
+		return false;
+	memcpy(line, client->in, length);
+	line[length] = '\0';
+	client->length -= length + 1;
+	memmove(client->in, end + 1, client->length);
+	return true;
+}
+
+/**
+ * Checks the reply of a guess, the game ends with WIN or OVER
+*/
+static bool check_guess_reply(struct client *client, const char *line)
+{
+	unsigned int exact, approx;
+	char result[16];
+	if (sscanf(line, "%u %u %15s", &exact, &approx, result) != 3 || exact + approx > NUMBERS)
+		return false;
+
+	if (strcmp(result, "WIN") == 0)
+	{
+		client->playing = false;
+		return exact == NUMBERS;
+	}
+	if (strcmp(result, "OVER") == 0)
+		client->playing = false;
+	else if (strcmp(result, "CONTINUE") != 0)
+		return false;
+
+	return exact < NUMBERS;
+}
+
+/**
+ * Sends a request on every client, then reads the replies.
+ * Every client has one request in flight, like a player waiting for the feedback.
+*/
+static void *worker_loop(void *arg)
+{
+	struct worker *worker = arg;
+	uint32_t *done = calloc(worker->count, sizeof(*done));
+	uint64_t *sent = calloc(worker->count, sizeof(*sent));
+	bool *guessing = calloc(worker->count, sizeof(*guessing));
+	uint64_t measured = 0;
+	worker->failed = !done || !sent || !guessing;
+
+	for (bool active = true; active && !worker->failed;)
+	{
+		active = false;
+		for (uint32_t i = 0; i < worker->count; i++)
+		{
+			struct client *client = &worker->clients[i];
+			if (done[i] == worker->guesses)
+				continue;
+			active = true;
+
+			char request[64];
+			int length;
+			guessing[i] = client->playing;
+			if (client->playing)
+			{
+				length = snprintf(request, sizeof(request), "GUESS");
+				for (int n = 0; n < NUMBERS; n++)
+					length += snprintf(request + length, sizeof(request) - length, " %d", rand_r(&worker->seed) % MAX + 1);
+				length += snprintf(request + length, sizeof(request) - length, "\n");
+			}
+			else
+				length = snprintf(request, sizeof(request), "NEW %d %d %d\n", NUMBERS, MAX, ROUNDS);
+
+			sent[i] = now_ns();
+			if (!send_line(client, request, length))
+				worker->failed = true;
+		}
+
+		for (uint32_t i = 0; i < worker->count && !worker->failed; i++)
+		{
+			struct client *client = &worker->clients[i];
+			if (done[i] == worker->guesses)
+				continue;
+
+			char line[128];
+			if (!read_line(client, line, sizeof(line)))
+			{
+				worker->failed = true;
+				break;
+			}
+			uint64_t latency = now_ns() - sent[i];
+
+			if (!guessing[i])
+			{
+				client->playing = strncmp(line, "OK ", 3) == 0;
+				worker->failed = !client->playing;
+				continue;
+			}
+			if (!check_guess_reply(client, line))
+			{
+				fprintf(stderr, "Error - Unexpected reply \"%s\"\n", line);
+				worker->failed = true;
+				break;
+			}
+			worker->latencies[measured++] = latency;
+			done[i]++;
+		}
+	}
+
+	free(done);
+	free(sent);
+	free(guessing);
+	return NULL;
+}
+
+static void *server_loop(void *arg)
+{
+	SERVER_run(arg);
+	return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Parses a positive number argument, returns false if it is not one
+*/
+static bool parse_count(int argc, char *argv[], int index, uint32_t *value)
+{
+	if (argc <= index)
+		return true;
+
+	char *end;
+	unsigned long number = strtoul(argv[index], &end, 10);
+	if (*end != '\0' || number == 0 || number > UINT32_MAX)
+	{
+		fprintf(stderr, "Error - Invalid argument %s\n", argv[index]);
+		return false;
+	}
+	*value = number;
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t clients = CLIENTS_DEF;
+	uint32_t guesses = GUESSES_DEF;
+	uint32_t threads = THREADS_DEF;
+	if (!parse_count(argc, argv, 1, &clients) || !parse_count(argc, argv, 2, &guesses) ||
+		!parse_count(argc, argv, 3, &threads))
+		return EXIT_FAILURE;
+	if (threads > clients)
+		threads = clients;
+
+	// Every client needs a descriptor, and one more in the server
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+	{
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	char path[64];
+	pthread_t server_thread;
+	struct server_config config =
+	{
+		.path = path,
+		.max_sessions = clients,
+		.settings = {.numbers = NUMBERS, .max = MAX, .rounds = ROUNDS},
+	};
+	bool own_server = argc <= 4;
+	if (own_server)
+		snprintf(path, sizeof(path), "/tmp/mastermind_loadgen_%d.sock", (int)getpid());
+	else if (SERVER_parse_address(argv[4], &config) != 0)
+		return EXIT_FAILURE;
+	if (!(server_address_length = SERVER_socket_address(&config, &server_address)))
+		return EXIT_FAILURE;
+
+	if (own_server && pthread_create(&server_thread, NULL, server_loop, &config) != 0)
+	{
+		perror("Unable to start the server");
+		return EXIT_FAILURE;
+	}
+
+	struct client *all = calloc(clients, sizeof(*all));
+	struct worker *workers = calloc(threads, sizeof(*workers));
+	uint64_t *latencies = malloc((size_t)clients * guesses * sizeof(*latencies));
+	if (!all || !workers || !latencies)
+	{
+		perror("Unable to allocate memory");
+		return EXIT_FAILURE;
+	}
+
+	for (uint32_t i = 0; i < clients; i++)
+		all[i].fd = -1;
+
+	bool passed = true;
+	for (uint32_t i = 0; i < clients && passed; i++)
+	{
+		// The own server may still be starting
+		for (int attempt = 0; (all[i].fd = connect_client()) < 0 && attempt < 100; attempt++)
+			usleep(10000);
+		if (all[i].fd < 0)
+		{
+			perror("Unable to connect to the server");
+			passed = false;
+		}
+	}
+
+	uint64_t start = now_ns();
+	uint32_t first = 0;
+	uint32_t started = 0;
+	for (uint32_t t = 0; t < threads && passed; t++)
+	{
+		uint32_t count = clients / threads + (t < clients % threads);
+		workers[t] = (struct worker)
+		{
+			.clients = &all[first],
+			.count = count,
+			.guesses = guesses,
+			.latencies = &latencies[(size_t)first * guesses],
+			.seed = t + 1,
+		};
+		first += count;
+		if (pthread_create(&workers[t].thread, NULL, worker_loop, &workers[t]) != 0)
+		{
+			perror("Unable to start a client thread");
+			passed = false;
+			break;
+		}
+		started++;
+	}
+	for (uint32_t t = 0; t < started; t++)
+	{
+		pthread_join(workers[t].thread, NULL);
+		passed = passed && !workers[t].failed;
+	}
+	uint64_t elapsed = now_ns() - start;
+
+	if (passed)
+	{
+		size_t total = (size_t)clients * guesses;
+		qsort(latencies, total, sizeof(*latencies), compare_u64);
+		printf("%8s %8s %8s %10s %12s %9s %9s %9s\n", "clients", "threads", "guesses", "seconds",
+			   "guesses/s", "p50_us", "p99_us", "max_us");
+		printf("%8u %8u %8zu %10.3f %12.0f %9.1f %9.1f %9.1f\n", clients, threads, total, elapsed / 1e9,
+			   total / (elapsed / 1e9), latencies[total / 2] / 1e3, latencies[total * 99 / 100] / 1e3,
+			   latencies[total - 1] / 1e3);
+	}
+	else
+		fprintf(stderr, "Error - Load test failed\n");
+
+	for (uint32_t i = 0; i < clients; i++)
+	{
+		if (all[i].fd >= 0)
+			close(all[i].fd);
+	}
+	if (own_server)
+	{
+		SERVER_stop();
+		pthread_join(server_thread, NULL);
+	}
+
+	free(all);
+	free(workers);
+	free(latencies);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,180 @@
+/**
+ * Precomputed feedback matrix vs computing the scores.
+ * Builds the matrix of each code space into a temporary file, maps it and
+ * checks every (guess, secret) pair against CODE_score, the program fails
+ * if one differs. Then scores the same random pairs with a matrix lookup
+ * (MATRIX_score, the way the game uses it), SCORE_calculate and CODE_score.
+ * The largest matrix (5 numbers from 1 to 8, 1 GiB) is left out, build it
+ * with mastermind --build-matrix=[file] -n=5 -c=8.
+ *
+ * Usage: matrix_bench [pairs per timing run]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include "../src/timeunits.h"
+#include "../src/score/score.h"
+#include "../src/code/code.h"
+#include "../src/matrix/matrix.h"
+
+#define PAIRS_DEF 1000000
+
+struct space
+{
+	uint8_t numbers;
+	uint8_t colours;
+};
+
+static const struct space spaces[] =
+{
+	{3, 3},
+	{4, 6},
+	{5, 6},
+	{4, 8},
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * SEC_TO_NS(1u) + now.tv_nsec;
+}
+
+/**
+ * Checks every entry of the matrix, returns the number of wrong ones
+*/
+static uint64_t check_matrix(const struct matrix *matrix)
+{
+	uint64_t wrong = 0;
+	for (uint32_t guess = 0; guess < matrix->codes; guess++)
+	{
+		uint64_t guess_code = CODE_unrank(guess, matrix->numbers, matrix->colours);
+		wrong += CODE_rank(guess_code, matrix->numbers, matrix->colours) != guess;
+		for (uint32_t secret = 0; secret < matrix->codes; secret++)
+		{
+			uint64_t secret_code = CODE_unrank(secret, matrix->numbers, matrix->colours);
+			uint16_t score = CODE_score(secret_code, guess_code, matrix->numbers);
+			wrong += MATRIX_class(matrix, guess, secret) != CODE_CLASS(score, matrix->numbers);
+		}
+	}
+	return wrong;
+}
+
+/**
+ * Times the matrix lookups against the kernels on the same random pairs
+*/
+static bool time_matrix(const struct matrix *matrix, uint32_t pairs)
+{
+	uint8_t numbers = matrix->numbers;
+	int *secrets = malloc((size_t)pairs * numbers * sizeof(int));
+	int *guesses = malloc((size_t)pairs * numbers * sizeof(int));
+	uint64_t *secret_codes = malloc((size_t)pairs * sizeof(uint64_t));
+	uint64_t *guess_codes = malloc((size_t)pairs * sizeof(uint64_t));
+	if (!secrets || !guesses || !secret_codes || !guess_codes)
+	{
+		perror("Unable to allocate memory for the pairs");
+		free(secrets);
+		free(guesses);
+		free(secret_codes);
+		free(guess_codes);
+		return false;
+	}
+
+	unsigned int seed = 1;
+	for (uint32_t i = 0; i < pairs; i++)
+	{
+		secret_codes[i] = CODE_unrank(rand_r(&seed) % matrix->codes, numbers, matrix->colours);
+		guess_codes[i] = CODE_unrank(rand_r(&seed) % matrix->codes, numbers, matrix->colours);
+		CODE_decode(secret_codes[i], &secrets[(size_t)i * numbers], numbers);
+		CODE_decode(guess_codes[i], &guesses[(size_t)i * numbers], numbers);
+	}
+
+	uint64_t sum_matrix = 0;
+	uint64_t start = now_ns();
+	for (uint32_t i = 0; i < pairs; i++)
+	{
+		uint16_t score = MATRIX_score(matrix, &secrets[(size_t)i * numbers], &guesses[(size_t)i * numbers]);
+		sum_matrix += SCORE_EXACT(score) + SCORE_APPROX(score);
+	}
+	uint64_t matrix_time = now_ns() - start;
+
+	uint64_t sum_kernel = 0;
+	start = now_ns();
+	for (uint32_t i = 0; i < pairs; i++)
+	{
+		uint16_t score = SCORE_calculate(&secrets[(size_t)i * numbers], &guesses[(size_t)i * numbers],
+										 numbers, matrix->colours);
+		sum_kernel += SCORE_EXACT(score) + SCORE_APPROX(score);
+	}
+	uint64_t kernel_time = now_ns() - start;
+
+	uint64_t sum_packed = 0;
+	start = now_ns();
+	for (uint32_t i = 0; i < pairs; i++)
+	{
+		uint16_t score = CODE_score(secret_codes[i], guess_codes[i], numbers);
+		sum_packed += SCORE_EXACT(score) + SCORE_APPROX(score);
+	}
+	uint64_t packed_time = now_ns() - start;
+
+	printf("%11.2f %11.2f %11.2f\n", (double)matrix_time / pairs, (double)kernel_time / pairs,
+		   (double)packed_time / pairs);
+
+	free(secrets);
+	free(guesses);
+	free(secret_codes);
+	free(guess_codes);
+	return sum_matrix == sum_kernel && sum_packed == sum_kernel;
+}
+
+static bool bench_space(const struct space *space, uint32_t pairs)
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/mastermind_matrix_%d.bin", (int)getpid());
+
+	uint64_t start = now_ns();
+	if (MATRIX_build(path, space->numbers, space->colours) != 0)
+		return false;
+	uint64_t build_time = now_ns() - start;
+
+	struct matrix matrix;
+	start = now_ns();
+	bool passed = MATRIX_open(&matrix, path) == 0;
+	uint64_t open_time = now_ns() - start;
+	unlink(path);  // Stays mapped
+	if (!passed)
+		return false;
+
+	uint64_t wrong = check_matrix(&matrix);
+	printf("%3hhu %3hhu %8u %12zu %10.1f %10.1f %8llu ", space->numbers, space->colours, matrix.codes,
+		   matrix.map_size, build_time / 1e6, open_time / 1e3, (unsigned long long)wrong);
+	fflush(stdout);
+	passed = time_matrix(&matrix, pairs) && wrong == 0;
+
+	MATRIX_close(&matrix);
+	if (!passed)
+		fprintf(stderr, "Error - Wrong matrix for n=%hhu c=%hhu\n", space->numbers, space->colours);
+	return passed;
+}
+
+int main(int argc, char *argv[])
+{
+	int pairs = PAIRS_DEF;
+	if (argc > 1 && (pairs = atoi(argv[1])) <= 0)
+	{
+		fprintf(stderr, "Error - Invalid number of pairs %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	bool passed = true;
+	// matrix - MATRIX_score, kernel - SCORE_calculate, packed - CODE_score
+	printf("%3s %3s %8s %12s %10s %10s %8s %11s %11s %11s\n", "n", "c", "codes", "bytes", "build_ms",
+		   "open_us", "wrong", "matrix_ns", "kernel_ns", "packed_ns");
+	for (size_t i = 0; i < sizeof(spaces) / sizeof(spaces[0]); i++)
+		passed = bench_space(&spaces[i], pairs) && passed;
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
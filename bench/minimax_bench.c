@@ -0,0 +1,202 @@
+/**
+ * Minimax next guess search (MINIMAX_search) against an exhaustive
+ * single-threaded search without pruning.
+ * Plays games with Knuth's strategy and searches every guess with one
+ * thread and with the given number of threads. All three searches have to
+ * pick the same guess with the same worst case, the program fails
+ * otherwise. Then a search is cut short by a 1 ms deadline.
+ *
+ * Usage: minimax_bench [threads] [games per code space]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../src/timeunits.h"
+#include "../src/code/code.h"
+#include "../src/delay/delay.h"
+#include "../src/solver/solver.h"
+#include "../src/candidates/candidates.h"
+#include "../src/minimax/minimax.h"
+
+#define THREADS_DEF 4
+#define GAMES_DEF 1
+#define DEADLINE_NS MS_TO_NS(1ull)
+
+struct space
+{
+	uint8_t numbers;
+	uint8_t colours;
+};
+
+static const struct space spaces[] =
+{
+	{4, 6},
+	{5, 6},
+	{5, 8},
+};
+
+/**
+ * Smallest worst case, then candidates first, then the lowest rank
+*/
+static void reference_search(const struct candidates *candidates, struct code_set *set,
+							 struct minimax_result *result)
+{
+	uint8_t size = candidates->space->size;
+	uint32_t partitions[CODE_CLASSES(CODE_NUMBERS_MAX)];
+
+	set->length = 0;
+	for (uint32_t rank = CANDIDATES_next(candidates, 0); rank != CANDIDATES_END;
+		 rank = CANDIDATES_next(candidates, rank + 1))
+		CODE_set_add(set, CANDIDATES_code(candidates, rank));
+
+	memset(result, 0, sizeof(*result));
+	result->worst = UINT32_MAX;
+	bool best_candidate = false;
+	for (uint32_t rank = 0; rank < candidates->space->length; rank++)
+	{
+		memset(partitions, 0, sizeof(partitions));
+		CODE_score_many(CANDIDATES_code(candidates, rank), set, NULL, partitions);
+		uint32_t worst = 0;
+		for (size_t c = 0; c < CODE_CLASSES(size); c++)
+			worst = partitions[c] > worst ? partitions[c] : worst;
+
+		bool candidate = CANDIDATES_contains(candidates, rank);
+		if (worst < result->worst || (worst == result->worst && candidate && !best_candidate))
+		{
+			result->worst = worst;
+			result->rank = rank;
+			best_candidate = candidate;
+		}
+	}
+	result->guess = CANDIDATES_code(candidates, result->rank);
+}
+
+static bool same(const struct minimax_result *a, const struct minimax_result *b)
+{
+	return a->rank == b->rank && a->worst == b->worst;
+}
+
+/**
+ * Plays a game against the secret, every guess is searched three times
+*/
+static bool play(struct candidates *candidates, struct code_set *set, uint64_t secret, uint32_t threads)
+{
+	uint8_t size = candidates->space->size;
+	bool passed = true;
+	CANDIDATES_reset(candidates);
+
+	for (uint32_t guesses = 1; passed; guesses++)
+	{
+		struct minimax_result reference;
+		struct minimax_result single;
+		struct minimax_result parallel;
+		struct minimax_config config = {.threads = 1};
+
+		uint64_t start = DELAY_now();
+		reference_search(candidates, set, &reference);
+		uint64_t reference_ns = DELAY_now() - start;
+
+		start = DELAY_now();
+		passed = MINIMAX_search(candidates, &config, &single) == 0;
+		uint64_t single_ns = DELAY_now() - start;
+
+		config.threads = threads;
+		start = DELAY_now();
+		passed = MINIMAX_search(candidates, &config, &parallel) == 0 && passed;
+		uint64_t parallel_ns = DELAY_now() - start;
+
+		passed = passed && same(&single, &reference) && same(&parallel, &reference);
+		uint64_t searched = single.searched + single.pruned;
+		printf("%3hhu %3hhu %7u %10u %6u %6u %12.3f %12.3f %12.3f %8.1f%%\n", size, candidates->colours, guesses,
+			   CANDIDATES_count(candidates), reference.rank, reference.worst, reference_ns / 1e6, single_ns / 1e6,
+			   parallel_ns / 1e6, searched ? 100.0 * single.pruned / searched : 0.0);
+		if (!passed)
+		{
+			fprintf(stderr, "Error - Searched %u (worst %u) and %u (worst %u) instead of %u (worst %u)\n",
+					single.rank, single.worst, parallel.rank, parallel.worst, reference.rank, reference.worst);
+			break;
+		}
+
+		if (reference.guess == secret)
+			break;
+		CANDIDATES_prune(candidates, reference.guess, CODE_score(secret, reference.guess, size));
+	}
+	return passed;
+}
+
+/**
+ * Searches the first guess with a deadline, which has to stop the search
+*/
+static bool search_deadline(struct candidates *candidates, uint32_t threads)
+{
+	struct minimax_result result;
+	struct minimax_config config = {.threads = threads};
+
+	CANDIDATES_reset(candidates);
+	uint64_t start = DELAY_now();
+	config.deadline = start + DEADLINE_NS;
+	if (MINIMAX_search(candidates, &config, &result) != 0)
+		return false;
+	uint64_t elapsed = DELAY_now() - start;
+
+	printf("%3hhu %3hhu deadline %.3f ms: %s after %.3f ms, %llu guesses, rank %u worst %u\n",
+		   candidates->space->size, candidates->colours, DEADLINE_NS / 1e6,
+		   result.complete ? "complete" : "stopped", elapsed / 1e6,
+		   (unsigned long long)(result.searched + result.pruned), result.rank, result.worst);
+	return result.worst <= CANDIDATES_count(candidates);
+}
+
+/**
+ * Parses a positive number argument, returns false if it is not one
+*/
+static bool parse_count(int argc, char *argv[], int index, uint32_t *value)
+{
+	if (argc <= index)
+		return true;
+
+	char *end;
+	unsigned long number = strtoul(argv[index], &end, 10);
+	if (*end != '\0' || number == 0 || number > UINT32_MAX)
+	{
+		fprintf(stderr, "Error - Invalid argument %s\n", argv[index]);
+		return false;
+	}
+	*value = number;
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t threads = THREADS_DEF;
+	uint32_t games = GAMES_DEF;
+	if (!parse_count(argc, argv, 1, &threads) || !parse_count(argc, argv, 2, &games))
+		return EXIT_FAILURE;
+
+	bool passed = true;
+	unsigned int seed = 1;
+	printf("%3s %3s %7s %10s %6s %6s %12s %12s %12s %9s\n", "n", "c", "guess", "candidates", "rank", "worst",
+		   "reference_ms", "1_thread_ms", "threads_ms", "pruned");
+	for (size_t s = 0; s < sizeof(spaces) / sizeof(spaces[0]) && passed; s++)
+	{
+		struct code_set space;
+		struct code_set set;
+		struct candidates candidates;
+		if (SOLVER_space_init(&space, spaces[s].numbers, spaces[s].colours) != 0)
+			return EXIT_FAILURE;
+		if (CODE_set_init(&set, space.size, space.length) != 0 ||
+			CANDIDATES_init(&candidates, &space, spaces[s].colours, NULL) != 0)
+			return EXIT_FAILURE;
+
+		for (uint32_t g = 0; g < games && passed; g++)
+			passed = play(&candidates, &set, space.codes[rand_r(&seed) % space.length], threads);
+		passed = passed && search_deadline(&candidates, threads);
+
+		CANDIDATES_free(&candidates);
+		CODE_set_free(&set);
+		CODE_set_free(&space);
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,376 @@
+/**
+ * Differential check and speed of the scoring kernel.
+ *
+ * Every (secret, guess) pair of the small code spaces and random pairs of
+ * the large ones are scored by SCORE_calculate, the original algorithm
+ * (SCORE_reference) and a textbook marking algorithm. The kernel has to
+ * agree with the textbook algorithm on every pair and with the original on
+ * every pair the original scores correctly. The original undercounts the
+ * approximate matches when a number of the secret was taken by an
+ * approximate match before its own exact match was found, these pairs are
+ * reported in the reference_wrong column.
+ * The packed code kernels (CODE_score) are checked the same way in the
+ * code spaces which fit in a packed code, and the kernels unrolled for
+ * a sequence length (SCORE_kernel) in every code space. Then every
+ * unrolled kernel is timed against SCORE_calculate.
+ *
+ * Usage: score_bench [pairs per timing run]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "../src/timeunits.h"
+#include "../src/score/score.h"
+#include "../src/code/code.h"
+
+#define PAIRS_DEF 1000000
+// Code spaces up to this size are checked exhaustively (all pairs)
+#define EXHAUSTIVE_CODES_MAX 1296
+#define NUMBERS_MAX 16
+// Random pairs checked for the larger code spaces
+#define RANDOM_PAIRS 100000
+// Maximum number of the unrolled kernel timings
+#define UNROLLED_COLOURS 8
+
+struct space
+{
+	uint8_t numbers;
+	uint8_t colours;
+};
+
+// Code spaces of the speed comparison
+static const struct space timed[] =
+{
+	{3, 3},
+	{4, 6},
+	{5, 8},
+	{8, 8},
+	{16, 15},
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * SEC_TO_NS(1u) + now.tv_nsec;
+}
+
+/**
+ * Marks the exact matches first, then pairs every other number of the
+ * guess with an unmarked equal number of the secret
+*/
+static uint16_t textbook_score(const int secret[], const int guess[], size_t size)
+{
+	bool secret_used[NUMBERS_MAX] = {false};
+	bool guess_used[NUMBERS_MAX] = {false};
+	uint8_t exact = 0;
+	uint8_t approx = 0;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		if (secret[i] == guess[i])
+		{
+			secret_used[i] = guess_used[i] = true;
+			exact++;
+		}
+	}
+	for (size_t i = 0; i < size; i++)
+	{
+		for (size_t j = 0; j < size && !guess_used[i]; j++)
+		{
+			if (!secret_used[j] && guess[i] == secret[j])
+			{
+				secret_used[j] = guess_used[i] = true;
+				approx++;
+			}
+		}
+	}
+
+	return SCORE_PACK(exact, approx);
+}
+
+/**
+ * Writes the code with the given index, numbers from 1 to colours
+*/
+static void decode(uint32_t index, const struct space *space, int code[])
+{
+	for (uint8_t i = 0; i < space->numbers; i++)
+	{
+		code[i] = index % space->colours + 1;
+		index /= space->colours;
+	}
+}
+
+static void random_code(const struct space *space, unsigned int *seed, int code[])
+{
+	for (uint8_t i = 0; i < space->numbers; i++)
+		code[i] = rand_r(seed) % space->colours + 1;
+}
+
+struct check
+{
+	uint64_t pairs;
+	uint64_t wrong;  // Kernel differs from the textbook algorithm
+	uint64_t packed_wrong;  // Packed kernel differs from the textbook algorithm
+	uint64_t unrolled_wrong;  // Kernel of the sequence length differs from the textbook algorithm
+	uint64_t reference_wrong;  // Original differs from the textbook algorithm
+	uint64_t mismatches;  // Kernel differs from a correct original
+};
+
+static void check_pair(const int secret[], const int guess[], const struct space *space, struct check *check)
+{
+	uint16_t score = SCORE_calculate(secret, guess, space->numbers, space->colours);
+	uint16_t expected = textbook_score(secret, guess, space->numbers);
+	int exact = 0;
+	int approx = 0;
+	SCORE_reference(&exact, &approx, secret, guess, space->numbers);
+	uint16_t reference = SCORE_PACK(exact, approx);
+
+	if (space->numbers <= CODE_NUMBERS_MAX && space->colours <= CODE_COLOURS_MAX)
+	{
+		uint64_t secret_code = CODE_encode(secret, space->numbers);
+		uint64_t guess_code = CODE_encode(guess, space->numbers);
+		check->packed_wrong += CODE_score(secret_code, guess_code, space->numbers) != expected;
+	}
+
+	score_kernel kernel = SCORE_kernel(space->numbers);
+	check->unrolled_wrong += kernel(secret, guess, space->numbers, space->colours) != expected;
+
+	check->pairs++;
+	check->wrong += score != expected;
+	check->reference_wrong += reference != expected;
+	check->mismatches += reference == expected && score != reference;
+}
+
+/**
+ * Checks all the pairs of a small code space or random pairs of a large one
+*/
+static bool check_space(const struct space *space)
+{
+	struct check check = {0};
+	int secret[NUMBERS_MAX];
+	int guess[NUMBERS_MAX];
+
+	uint64_t codes = 1;
+	for (uint8_t i = 0; i < space->numbers && codes <= EXHAUSTIVE_CODES_MAX; i++)
+		codes *= space->colours;
+
+	bool exhaustive = codes <= EXHAUSTIVE_CODES_MAX;
+	if (exhaustive)
+	{
+		for (uint32_t s = 0; s < codes; s++)
+		{
+			decode(s, space, secret);
+			for (uint32_t g = 0; g < codes; g++)
+			{
+				decode(g, space, guess);
+				check_pair(secret, guess, space, &check);
+			}
+		}
+	}
+	else
+	{
+		unsigned int seed = space->numbers << 8 | space->colours;
+		for (uint32_t i = 0; i < RANDOM_PAIRS; i++)
+		{
+			random_code(space, &seed, secret);
+			random_code(space, &seed, guess);
+			check_pair(secret, guess, space, &check);
+		}
+	}
+
+	printf("%3hhu %3hhu %-11s %10llu %10llu %13llu %15llu %16llu %11llu\n", space->numbers, space->colours,
+		   exhaustive ? "exhaustive" : "random", (unsigned long long)check.pairs,
+		   (unsigned long long)check.wrong, (unsigned long long)check.packed_wrong,
+		   (unsigned long long)check.unrolled_wrong, (unsigned long long)check.reference_wrong,
+		   (unsigned long long)check.mismatches);
+
+	return check.wrong == 0 && check.packed_wrong == 0 && check.unrolled_wrong == 0 && check.mismatches == 0;
+}
+
+/**
+ * Scores the same random pairs with the original algorithm and the kernel
+*/
+static bool time_space(const struct space *space, uint32_t pairs)
+{
+	int *secrets = malloc((size_t)pairs * space->numbers * sizeof(int));
+	int *guesses = malloc((size_t)pairs * space->numbers * sizeof(int));
+	uint64_t *secret_codes = malloc((size_t)pairs * sizeof(uint64_t));
+	uint64_t *guess_codes = malloc((size_t)pairs * sizeof(uint64_t));
+	struct code_counts *secret_counts = malloc((size_t)pairs * sizeof(struct code_counts));
+	struct code_counts *guess_counts = malloc((size_t)pairs * sizeof(struct code_counts));
+	bool allocated = secrets && guesses && secret_codes && guess_codes && secret_counts && guess_counts;
+	if (!allocated)
+		perror("Unable to allocate memory for the pairs");
+
+	unsigned int seed = 1;
+	for (uint32_t i = 0; i < pairs && allocated; i++)
+	{
+		random_code(space, &seed, &secrets[(size_t)i * space->numbers]);
+		random_code(space, &seed, &guesses[(size_t)i * space->numbers]);
+		secret_codes[i] = CODE_encode(&secrets[(size_t)i * space->numbers], space->numbers);
+		guess_codes[i] = CODE_encode(&guesses[(size_t)i * space->numbers], space->numbers);
+		secret_counts[i] = CODE_counts(secret_codes[i], space->numbers);
+		guess_counts[i] = CODE_counts(guess_codes[i], space->numbers);
+	}
+	if (!allocated)
+		pairs = 0;
+
+	uint64_t sum_reference = 0;
+	uint64_t start = now_ns();
+	for (uint32_t i = 0; i < pairs; i++)
+	{
+		int exact = 0;
+		int approx = 0;
+		SCORE_reference(&exact, &approx, &secrets[(size_t)i * space->numbers],
+						&guesses[(size_t)i * space->numbers], space->numbers);
+		sum_reference += exact + approx;
+	}
+	uint64_t reference_time = now_ns() - start;
+
+	uint64_t sum_kernel = 0;
+	start = now_ns();
+	for (uint32_t i = 0; i < pairs; i++)
+	{
+		uint16_t score = SCORE_calculate(&secrets[(size_t)i * space->numbers],
+										 &guesses[(size_t)i * space->numbers], space->numbers, space->colours);
+		sum_kernel += SCORE_EXACT(score) + SCORE_APPROX(score);
+	}
+	uint64_t kernel_time = now_ns() - start;
+
+	uint64_t sum_packed = 0;
+	start = now_ns();
+	for (uint32_t i = 0; i < pairs; i++)
+	{
+		uint16_t score = CODE_score(secret_codes[i], guess_codes[i], space->numbers);
+		sum_packed += SCORE_EXACT(score) + SCORE_APPROX(score);
+	}
+	uint64_t packed_time = now_ns() - start;
+
+	uint64_t sum_counts = 0;
+	start = now_ns();
+	for (uint32_t i = 0; i < pairs; i++)
+	{
+		uint16_t score = CODE_score_counts(secret_codes[i], &secret_counts[i],
+										   guess_codes[i], &guess_counts[i], space->numbers);
+		sum_counts += SCORE_EXACT(score) + SCORE_APPROX(score);
+	}
+	uint64_t counts_time = now_ns() - start;
+
+	if (pairs)
+	{
+		printf("%3hhu %3hhu %10u %14.2f %14.2f %11.2f %11.2f %9.2fx\n", space->numbers, space->colours, pairs,
+			   (double)reference_time / pairs, (double)kernel_time / pairs, (double)packed_time / pairs,
+			   (double)counts_time / pairs, counts_time ? (double)reference_time / counts_time : 0.0);
+	}
+	// Keeps the loops from being optimised away, the kernels only find more matches
+	if (sum_kernel < sum_reference || sum_packed != sum_kernel || sum_counts != sum_kernel)
+		printf("Warning - the kernels found different numbers of matches\n");
+
+	free(secrets);
+	free(guesses);
+	free(secret_codes);
+	free(guess_codes);
+	free(secret_counts);
+	free(guess_counts);
+	return allocated;
+}
+
+/**
+ * Scores the pairs with the kernel, adds the scores to sum and returns the time
+*/
+static uint64_t time_kernel(score_kernel kernel, const struct space *space, uint32_t pairs, const int secrets[],
+							const int guesses[], uint64_t *sum)
+{
+	uint64_t start = now_ns();
+	for (uint32_t i = 0; i < pairs; i++)
+	{
+		*sum += kernel(&secrets[(size_t)i * space->numbers], &guesses[(size_t)i * space->numbers],
+					   space->numbers, space->colours);
+	}
+	return now_ns() - start;
+}
+
+/**
+ * Scores the same random pairs with SCORE_calculate and the kernel of the
+ * sequence length
+*/
+static bool time_unrolled(const struct space *space, uint32_t pairs)
+{
+	int *secrets = malloc((size_t)pairs * space->numbers * sizeof(int));
+	int *guesses = malloc((size_t)pairs * space->numbers * sizeof(int));
+	if (!secrets || !guesses)
+	{
+		perror("Unable to allocate memory for the pairs");
+		free(secrets);
+		free(guesses);
+		return false;
+	}
+
+	unsigned int seed = 1;
+	for (uint32_t i = 0; i < pairs; i++)
+	{
+		random_code(space, &seed, &secrets[(size_t)i * space->numbers]);
+		random_code(space, &seed, &guesses[(size_t)i * space->numbers]);
+	}
+
+	uint64_t sum_generic = 0;
+	uint64_t sum_unrolled = 0;
+	time_kernel(SCORE_calculate, space, pairs, secrets, guesses, &sum_generic);  // Warm up
+	uint64_t generic_time = time_kernel(SCORE_calculate, space, pairs, secrets, guesses, &sum_generic);
+	uint64_t unrolled_time = time_kernel(SCORE_kernel(space->numbers), space, pairs, secrets, guesses,
+										 &sum_unrolled);
+
+	printf("%3hhu %3hhu %10u %11.2f %12.2f %9.2fx%s\n", space->numbers, space->colours, pairs,
+		   (double)generic_time / pairs, (double)unrolled_time / pairs,
+		   unrolled_time ? (double)generic_time / unrolled_time : 0.0,
+		   space->numbers > SCORE_UNROLLED_MAX ? " (generic)" : "");
+
+	free(secrets);
+	free(guesses);
+	return sum_generic == 2 * sum_unrolled;  // The generic kernel scored the pairs twice
+}
+
+int main(int argc, char *argv[])
+{
+	int pairs = PAIRS_DEF;
+	if (argc > 1 && (pairs = atoi(argv[1])) <= 0)
+	{
+		fprintf(stderr, "Error - Invalid number of pairs %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	bool passed = true;
+	printf("%3s %3s %-11s %10s %10s %13s %15s %16s %11s\n", "n", "c", "check", "pairs", "wrong",
+		   "packed_wrong", "unrolled_wrong", "reference_wrong", "mismatches");
+	for (uint8_t numbers = 1; numbers <= NUMBERS_MAX; numbers++)
+	{
+		for (uint8_t colours = 1; colours <= NUMBERS_MAX; colours++)
+		{
+			struct space space = {numbers, colours};
+			// All of the small spaces, a sample of the others
+			if (numbers <= 6 || colours % 5 == 1)
+				passed = check_space(&space) && passed;
+		}
+	}
+
+	// packed - CODE_score, counts - CODE_score_counts, speedup - counts vs the reference
+	printf("\n%3s %3s %10s %14s %14s %11s %11s %10s\n", "n", "c", "pairs", "reference_ns", "kernel_ns",
+		   "packed_ns", "counts_ns", "speedup");
+	for (size_t i = 0; i < sizeof(timed) / sizeof(timed[0]); i++)
+		passed = time_space(&timed[i], pairs) && passed;
+
+	// Every unrolled length and the first one scored by SCORE_calculate
+	printf("\n%3s %3s %10s %11s %12s %10s\n", "n", "c", "pairs", "generic_ns", "unrolled_ns", "speedup");
+	for (uint8_t numbers = 1; numbers <= SCORE_UNROLLED_MAX + 1; numbers++)
+	{
+		struct space space = {numbers, UNROLLED_COLOURS};
+		passed = time_unrolled(&space, pairs) && passed;
+	}
+
+	if (!passed)
+		fprintf(stderr, "Error - The kernel does not match the reference\n");
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
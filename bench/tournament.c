@@ -0,0 +1,302 @@
+/**
+ * Tournament of the codebreaker strategies (see strategy.h).
+ * Every strategy plays the same seeded secrets of every code space of the
+ * grid. The games are split into jobs of a strategy, a code space and a
+ * few games, which worker threads take from a shared counter. Every job has
+ * its own candidates, arena and strategy state and every game its own
+ * seed, so the results do not depend on the number of threads.
+ *
+ * Reports the mean and largest number of guesses, the games not solved
+ * within the rounds and the time of a decision (one guess() call). Fails
+ * if a game is not solved after GUESSES_MAX guesses or the secret is
+ * pruned from the candidates.
+ *
+ * Usage: tournament [games per code space] [threads] [rounds] [seed]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../src/code/code.h"
+#include "../src/delay/delay.h"
+#include "../src/rng/rng.h"
+#include "../src/arena/arena.h"
+#include "../src/solver/solver.h"
+#include "../src/candidates/candidates.h"
+#include "../src/strategy/strategy.h"
+
+#define GAMES_DEF 200
+#define ROUNDS_DEF 6
+#define SEED_DEF 1
+// Games of one job
+#define JOB_GAMES 16
+// A game still not solved after this many guesses is an error
+#define GUESSES_MAX 32
+
+struct space
+{
+	uint8_t numbers;
+	uint8_t colours;
+};
+
+static const struct space spaces[] =
+{
+	{3, 3},
+	{4, 6},
+	{5, 6},
+};
+#define SPACES (sizeof(spaces) / sizeof(spaces[0]))
+
+struct totals
+{
+	uint64_t games;
+	uint64_t guesses;
+	uint32_t max;
+	uint64_t failures;  // Solved after the last round
+	uint64_t errors;  // Not solved at all
+	uint64_t decision_ns;
+};
+
+struct job
+{
+	const struct strategy *strategy;
+	size_t space;
+	uint32_t first;  // Game
+	uint32_t games;
+	struct totals totals;
+};
+
+struct tournament
+{
+	struct code_set spaces[SPACES];
+	uint64_t *secrets[SPACES];  // Of every game
+	uint32_t rounds;
+	uint64_t seed;
+	struct job *jobs;
+	uint32_t job_count;
+	atomic_uint next;  // Job
+};
+
+/**
+ * Plays the secret with the strategy, returns the number of guesses,
+ * 0 if the game is not solved
+*/
+static uint32_t play(const struct strategy *strategy, struct strategy_state *state, struct candidates *candidates,
+					 uint64_t secret, uint64_t *decision_ns)
+{
+	const struct code_set *space = candidates->space;
+	uint32_t secret_rank = CODE_rank(secret, space->size, candidates->colours);
+	CANDIDATES_reset(candidates);
+
+	for (uint32_t guesses = 1; guesses <= GUESSES_MAX; guesses++)
+	{
+		state->round = guesses;
+		uint64_t start = DELAY_now();
+		uint64_t guess = strategy->guess(state);
+		*decision_ns += DELAY_now() - start;
+
+		uint16_t score = CODE_score(secret, guess, space->size);
+		if (SCORE_EXACT(score) == space->size)
+			return guesses;
+		CANDIDATES_prune(candidates, guess, score);
+		if (!CANDIDATES_contains(candidates, secret_rank))
+			return 0;
+	}
+	return 0;
+}
+
+static bool run_job(struct tournament *tournament, struct job *job)
+{
+	const struct code_set *space = &tournament->spaces[job->space];
+	struct candidates candidates;
+	struct arena arena;
+	struct strategy_state state;
+	if (CANDIDATES_init(&candidates, space, spaces[job->space].colours, NULL) != 0)
+		return false;
+	if (ARENA_init(&arena, STRATEGY_ARENA_SIZE(space->length)) != 0)
+	{
+		CANDIDATES_free(&candidates);
+		return false;
+	}
+
+	struct totals *totals = &job->totals;
+	for (uint32_t g = job->first; g < job->first + job->games; g++)
+	{
+		// The same random numbers for a game however the games are split
+		ARENA_reset(&arena);
+		if (STRATEGY_init(&state, &candidates, tournament->seed + g, &arena) != 0)
+			break;
+
+		uint32_t guesses = play(job->strategy, &state, &candidates, tournament->secrets[job->space][g],
+								&totals->decision_ns);
+		totals->games++;
+		if (!guesses)
+		{
+			totals->errors++;
+			guesses = GUESSES_MAX;
+		}
+		totals->guesses += guesses;
+		totals->failures += guesses > tournament->rounds;
+		if (guesses > totals->max)
+			totals->max = guesses;
+	}
+
+	ARENA_free(&arena);
+	CANDIDATES_free(&candidates);
+	return totals->games == job->games;
+}
+
+static void *worker_loop(void *arg)
+{
+	struct tournament *tournament = arg;
+	for (uint32_t j; (j = atomic_fetch_add(&tournament->next, 1)) < tournament->job_count;)
+	{
+		if (!run_job(tournament, &tournament->jobs[j]))
+			fprintf(stderr, "Error - Unable to run the games of %s\n", tournament->jobs[j].strategy->name);
+	}
+	return NULL;
+}
+
+/**
+ * Parses a positive number argument, returns false if it is not one
+*/
+static bool parse_count(int argc, char *argv[], int index, uint32_t *value)
+{
+	if (argc <= index)
+		return true;
+
+	char *end;
+	unsigned long number = strtoul(argv[index], &end, 10);
+	if (*end != '\0' || number == 0 || number > UINT32_MAX)
+	{
+		fprintf(stderr, "Error - Invalid argument %s\n", argv[index]);
+		return false;
+	}
+	*value = number;
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t games = GAMES_DEF;
+	long online = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t threads = online > 0 ? online : 1;
+	uint32_t seed = SEED_DEF;
+	struct tournament tournament = {.rounds = ROUNDS_DEF};
+	if (!parse_count(argc, argv, 1, &games) || !parse_count(argc, argv, 2, &threads) ||
+		!parse_count(argc, argv, 3, &tournament.rounds) || !parse_count(argc, argv, 4, &seed))
+		return EXIT_FAILURE;
+	tournament.seed = seed;
+
+	// The same secrets for every strategy
+	for (size_t s = 0; s < SPACES; s++)
+	{
+		struct rng rng;
+		if (SOLVER_space_init(&tournament.spaces[s], spaces[s].numbers, spaces[s].colours) != 0)
+			return EXIT_FAILURE;
+		tournament.secrets[s] = malloc(games * sizeof(uint64_t));
+		if (!tournament.secrets[s])
+		{
+			perror("Unable to allocate memory for the secrets");
+			return EXIT_FAILURE;
+		}
+		RNG_seed(&rng, seed + s);
+		RNG_codes(&rng, tournament.secrets[s], games, spaces[s].numbers, spaces[s].colours);
+	}
+
+	uint32_t chunks = (games + JOB_GAMES - 1) / JOB_GAMES;
+	tournament.job_count = STRATEGY_COUNT * SPACES * chunks;
+	tournament.jobs = calloc(tournament.job_count, sizeof(struct job));
+	if (!tournament.jobs)
+	{
+		perror("Unable to allocate memory for the jobs");
+		return EXIT_FAILURE;
+	}
+	// The slowest jobs (the largest spaces) first, the others fill the gaps at the end
+	uint32_t j = 0;
+	for (size_t s = SPACES; s-- > 0;)
+	{
+		for (size_t k = 0; k < STRATEGY_COUNT; k++)
+		{
+			for (uint32_t first = 0; first < games; first += JOB_GAMES)
+			{
+				struct job *job = &tournament.jobs[j++];
+				job->strategy = STRATEGY_all[k];
+				job->space = s;
+				job->first = first;
+				job->games = games - first < JOB_GAMES ? games - first : JOB_GAMES;
+			}
+		}
+	}
+	atomic_init(&tournament.next, 0);
+
+	pthread_t *workers = malloc(threads * sizeof(pthread_t));
+	if (!workers)
+	{
+		perror("Unable to allocate memory for the threads");
+		return EXIT_FAILURE;
+	}
+	uint64_t start = DELAY_now();
+	uint32_t started = 0;
+	for (; started < threads; started++)
+	{
+		if (pthread_create(&workers[started], NULL, worker_loop, &tournament) != 0)
+			break;  // The started threads take the jobs of the others
+	}
+	if (!started)
+		worker_loop(&tournament);
+	for (uint32_t t = 0; t < started; t++)
+		pthread_join(workers[t], NULL);
+	uint64_t elapsed = DELAY_now() - start;
+
+	bool passed = true;
+	printf("%-8s %3s %3s %6s %6s %4s %9s %12s\n", "strategy", "n", "c", "games", "mean", "max", "failures",
+		   "us/decision");
+	for (size_t s = 0; s < SPACES; s++)
+	{
+		for (size_t k = 0; k < STRATEGY_COUNT; k++)
+		{
+			struct totals totals = {0};
+			for (j = 0; j < tournament.job_count; j++)
+			{
+				const struct job *job = &tournament.jobs[j];
+				if (job->strategy != STRATEGY_all[k] || job->space != s)
+					continue;
+				totals.games += job->totals.games;
+				totals.guesses += job->totals.guesses;
+				totals.failures += job->totals.failures;
+				totals.errors += job->totals.errors;
+				totals.decision_ns += job->totals.decision_ns;
+				if (job->totals.max > totals.max)
+					totals.max = job->totals.max;
+			}
+
+			printf("%-8s %3hhu %3hhu %6llu %6.3f %4u %9llu %12.2f\n", STRATEGY_all[k]->name, spaces[s].numbers,
+				   spaces[s].colours, (unsigned long long)totals.games,
+				   totals.games ? (double)totals.guesses / totals.games : 0.0, totals.max,
+				   (unsigned long long)totals.failures,
+				   totals.guesses ? totals.decision_ns / 1e3 / totals.guesses : 0.0);
+			if (totals.games != games || totals.errors)
+			{
+				fprintf(stderr, "Error - %s did not solve %llu of %u games\n", STRATEGY_all[k]->name,
+						(unsigned long long)(games - totals.games + totals.errors), games);
+				passed = false;
+			}
+		}
+	}
+	printf("%u games per code space, %u rounds, %u threads, %.3f s\n", games, tournament.rounds,
+		   started ? started : 1, elapsed / 1e9);
+
+	free(workers);
+	free(tournament.jobs);
+	for (size_t s = 0; s < SPACES; s++)
+	{
+		free(tournament.secrets[s]);
+		CODE_set_free(&tournament.spaces[s]);
+	}
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,285 @@
+/**
+ * Records games on the simulated GPIO backend (manual clock) with the
+ * button pressed just before the input timeout, and replays the traces.
+ * The sampler dates a press back to its first sample, so a press up to
+ * GPIO_DEBOUNCE_SAMPLES - 1 periods before the timeout arrives after the
+ * game has already accepted the digit. The games race the timeout by 1
+ * to GPIO_DEBOUNCE_SAMPLES + 1 sample periods.
+ * Fails if a replay ends differently or makes other guesses than the
+ * recording, or if no press arrived after its timeout.
+ *
+ * Usage: trace_bench [games per lead]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/timeunits.h"
+#include "../src/gpio/gpio.h"
+#include "../src/gpio/gpio_sim.h"
+#include "../src/arena/arena.h"
+#include "../src/timer/timer.h"
+#include "../src/game/game.h"
+#include "../src/trace/trace.h"
+
+#define GAMES_DEF 10
+#define BTN 17
+#define NUMBERS 3
+#define MAX 4
+#define ROUNDS 4
+#define SAMPLE_NS US_TO_NS((uint64_t)GPIO_SAMPLE_PERIOD_US)
+#define TIMEOUT_NS MS_TO_NS((uint64_t)GAME_INPUT_TIMEOUT_MS)
+// Length of a press, and the pause between two presses of one digit
+#define PRESS_NS MS_TO_NS(80ull)
+#define PAUSE_NS MS_TO_NS(150ull)
+// A game which takes longer has stopped taking the presses
+#define GAME_LIMIT_NS SEC_TO_NS(600ull)
+#define GUESSES_MAX (ROUNDS * NUMBERS)
+
+// A scripted press reaches the game this long after its release
+#define DEBOUNCE_NS ((GPIO_DEBOUNCE_SAMPLES - 1) * SAMPLE_NS)
+
+struct player
+{
+	const struct game *game;  // Pressing the button (the recording), NULL - only watching (the replay)
+	int (*plan)[NUMBERS];  // Guess of every round
+	uint64_t lead;  // The first press of a digit comes this long before the timeout of the previous one
+	uint64_t busy;  // Until then the game has not seen the release of the last press
+	uint8_t raced_round;  // Digit of the last press racing the timeout
+	uint8_t raced_position;
+	int guesses[GUESSES_MAX];
+	size_t length;
+};
+
+static void press(struct player *player, uint64_t at)
+{
+	GPIO_sim_script_press(BTN, at, PRESS_NS);
+	player->busy = at + PRESS_NS + DEBOUNCE_NS;
+}
+
+static void on_input(void *context, uint8_t position)
+{
+	(void)position;
+	struct player *player = context;
+	uint64_t now = GPIO_sim_now();
+	if (player->game && now >= player->busy)
+		press(player, now + PAUSE_NS);  // After a timeout the player waited for
+}
+
+static void on_guess(void *context, const int *guess, uint8_t length)
+{
+	struct player *player = context;
+	for (uint8_t i = 0; i < length && player->length < GUESSES_MAX; i++)
+		player->guesses[player->length++] = guess[i];
+}
+
+static void on_feedback(void *context, uint8_t exact, uint8_t approx)
+{
+	(void)exact;
+	(void)approx;
+	struct player *player = context;
+	if (player->game)
+		press(player, GPIO_sim_now() + PAUSE_NS);  // Continue
+}
+
+static const struct game_output output =
+{
+	.input = on_input,
+	.guess = on_guess,
+	.feedback = on_feedback,
+};
+
+/**
+ * Presses the button for the digit after a release.
+ * A press racing the timeout can still land on the digit it follows,
+ * then the player waits for the timeout instead of racing it again.
+*/
+static void on_release(struct player *player, uint64_t released)
+{
+	const struct game *game = player->game;
+	if (game->state != GAME_INPUT || GPIO_sim_now() < player->busy)
+		return;
+
+	if (game->presses < player->plan[game->round - 1][game->position])
+		press(player, released + PAUSE_NS);
+	else if (game->position + 1 < NUMBERS &&
+			 (player->raced_round != game->round || player->raced_position != game->position))
+	{
+		player->raced_round = game->round;
+		player->raced_position = game->position;
+		press(player, released + TIMEOUT_NS - player->lead);  // Racing the timeout
+	}
+}
+
+/**
+ * Plays a game the way MM_run does, one sample period at a time: the
+ * loop wakes for an event or for the next timer and then advances the
+ * wheel to the current time. Returns the number of events whose time was
+ * raised.
+*/
+static uint64_t record(struct player *player, const char *path, const int secret[], struct trace_result *result)
+{
+	struct game_settings settings =
+	{
+		.numbers = NUMBERS,
+		.max = MAX,
+		.rounds = ROUNDS,
+		.input_timeout = TIMEOUT_NS,
+	};
+	struct arena arena;
+	struct timer_wheel wheel;
+	struct game game;
+	struct trace trace;
+	GPIO_sim_reset();
+	TIMER_wheel_init(&wheel, MS_TO_NS(10ull), 0);
+	if (ARENA_init(&arena, GAME_ARENA_SIZE(NUMBERS)) != 0 ||
+		GAME_init(&game, &settings, &output, player, &wheel, &arena) != 0 ||
+		TRACE_create(&trace, path, &settings, 0, secret, 0) != 0)
+	{
+		ARENA_free(&arena);
+		return 0;
+	}
+
+	player->game = &game;
+	GAME_start(&game, secret);
+
+	uint64_t raised = 0;
+	uint64_t advanced = 0;
+	while (!GAME_is_over(&game) && GPIO_sim_now() < GAME_LIMIT_NS)
+	{
+		GPIO_sim_advance(SAMPLE_NS);
+		GPIO_sampler_tick();
+
+		struct gpio_event event;
+		bool woken = false;
+		while (GPIO_poll_event(&event))
+		{
+			uint64_t timestamp = event.timestamp;
+			TRACE_deliver(&trace, &game, &wheel, &event, &advanced);
+			raised += event.timestamp != timestamp;
+			woken = true;
+			if (!event.level)
+				on_release(player, event.timestamp);
+		}
+
+		uint64_t now = GPIO_sim_now();
+		if (woken || TIMER_next_expiry(&wheel) <= now)
+			TIMER_advance(&wheel, advanced = now);
+	}
+
+	result->round = game.round;
+	result->won = GAME_is_over(&game) && memcmp(game.secret, game.guess, sizeof(int) * NUMBERS) == 0;
+	TRACE_record_end(&trace, GPIO_sim_now(), result);
+	TRACE_close(&trace);
+	GAME_free(&game);
+	ARENA_free(&arena);
+	return raised;
+}
+
+static bool replay(struct player *player, const char *path, struct trace_result *result,
+				   struct trace_result *recorded)
+{
+	struct trace trace;
+	if (TRACE_open(&trace, path) != 0)
+		return false;
+
+	struct game_settings settings =
+	{
+		.numbers = trace.header.numbers,
+		.max = trace.header.max,
+		.rounds = trace.header.rounds,
+		.input_timeout = TIMEOUT_NS,
+	};
+	struct arena arena;
+	struct timer_wheel wheel;
+	struct game game;
+	TIMER_wheel_init(&wheel, MS_TO_NS(10ull), 0);
+	if (ARENA_init(&arena, GAME_ARENA_SIZE(NUMBERS)) != 0 ||
+		GAME_init(&game, &settings, &output, player, &wheel, &arena) != 0)
+	{
+		ARENA_free(&arena);
+		TRACE_close(&trace);
+		return false;
+	}
+
+	GAME_start(&game, trace.secret);
+	uint64_t events;
+	bool passed = TRACE_replay(&trace, &game, &wheel, BTN, NULL, &events, recorded) == 0;
+	result->round = game.round;
+	result->won = GAME_is_over(&game) && memcmp(game.secret, game.guess, sizeof(int) * NUMBERS) == 0;
+	passed = passed && GAME_is_over(&game);
+
+	GAME_free(&game);
+	ARENA_free(&arena);
+	TRACE_close(&trace);
+	return passed;
+}
+
+int main(int argc, char *argv[])
+{
+	long games = GAMES_DEF;
+	if (argc > 1 && (games = atol(argv[1])) <= 0)
+	{
+		fprintf(stderr, "Error - Invalid number of games %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/mastermind_trace_%d.trace", (int)getpid());
+	GPIO_set_backend(GPIO_BACKEND_SIM);
+	GPIO_sim_use_manual_clock(true);
+	GPIO_init();
+
+	bool passed = true;
+	uint64_t raised_total = 0;
+	unsigned int seed = 1;
+	printf("%8s %6s %8s %10s %10s\n", "lead_ms", "games", "raised", "recorded", "replayed");
+	// From a press which arrives before the timeout to ones which arrive after it
+	for (uint64_t lead = SAMPLE_NS; lead <= (GPIO_DEBOUNCE_SAMPLES + 1) * SAMPLE_NS; lead += SAMPLE_NS)
+	{
+		uint64_t raised = 0;
+		long same = 0;
+		struct trace_result result = {0};
+		struct trace_result replayed = {0};
+		for (long g = 0; g < games; g++)
+		{
+			int secret[NUMBERS];
+			int plan[ROUNDS][NUMBERS];
+			for (int i = 0; i < NUMBERS; i++)
+				secret[i] = rand_r(&seed) % MAX + 1;
+			for (int r = 0; r < ROUNDS; r++)
+			{
+				for (int i = 0; i < NUMBERS; i++)
+					plan[r][i] = r == ROUNDS - 1 ? secret[i] : rand_r(&seed) % MAX + 1;
+			}
+
+			struct player recording = {.plan = plan, .lead = lead};
+			struct player replaying = {.plan = plan};
+			struct trace_result recorded;
+			raised += record(&recording, path, secret, &result);
+			bool ok = replay(&replaying, path, &replayed, &recorded) &&
+					  replayed.round == result.round && replayed.won == result.won &&
+					  recorded.round == result.round && recorded.won == result.won &&
+					  replaying.length == recording.length &&
+					  memcmp(replaying.guesses, recording.guesses, recording.length * sizeof(int)) == 0;
+			same += ok;
+			if (!ok)
+				fprintf(stderr, "Error - Lead %.0f ms, game %ld: the replay differs from the recording\n",
+						lead / 1e6, g);
+		}
+
+		printf("%8.0f %6ld %8llu %10ld %10ld\n", lead / 1e6, games, (unsigned long long)raised, games, same);
+		raised_total += raised;
+		passed = passed && same == games;
+	}
+	unlink(path);
+
+	if (!raised_total)
+	{
+		fprintf(stderr, "Error - No press arrived after the timeout it raced\n");
+		passed = false;
+	}
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
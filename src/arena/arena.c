@@ -0,0 +1,50 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SUCCESS 0
+#define FAILURE -1
+
+int ARENA_init(struct arena *arena, size_t size)
+{
+	size = ARENA_SIZE(size);
+	ARENA_init_memory(arena, aligned_alloc(ARENA_ALIGNMENT, size ? size : ARENA_ALIGNMENT), size);
+	if (!arena->memory)
+	{
+		perror("Unable to allocate memory for the arena");
+		return FAILURE;
+	}
+
+	arena->owned = true;
+	return SUCCESS;
+}
+
+void ARENA_init_memory(struct arena *arena, void *memory, size_t size)
+{
+	arena->memory = memory;
+	arena->size = size;
+	arena->used = 0;
+	arena->owned = false;
+}
+
+void ARENA_free(struct arena *arena)
+{
+	if (arena->owned)
+		free(arena->memory);
+	arena->memory = NULL;
+	arena->size = 0;
+	arena->used = 0;
+}
+
+void *ARENA_alloc(struct arena *arena, size_t size)
+{
+	size = ARENA_SIZE(size);
+	if (size > arena->size - arena->used)
+		return NULL;
+
+	void *memory = arena->memory + arena->used;
+	arena->used += size;
+	return memory;
+}
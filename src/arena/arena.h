@@ -0,0 +1,57 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Bump allocator over one block of memory.
+ * Allocations only move the end of the used part forwards, nothing is freed
+ * on its own. Resetting the arena releases everything at once in O(1), so
+ * a session which allocates the same things for every game does not touch
+ * the heap after its first game.
+*/
+
+// Every allocation starts on a cache line
+#define ARENA_ALIGNMENT 64
+// Bytes an allocation of size bytes takes from the arena
+#define ARENA_SIZE(size) (((size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+struct arena
+{
+	unsigned char *memory;
+	size_t size;
+	size_t used;
+	bool owned;  // memory was allocated by ARENA_init
+};
+
+/**
+ * Allocates an arena of size bytes.
+ * Returns 0 on success, -1 on failure.
+*/
+int ARENA_init(struct arena *arena, size_t size);
+
+/**
+ * Uses size bytes of the caller's memory, aligned to ARENA_ALIGNMENT
+*/
+void ARENA_init_memory(struct arena *arena, void *memory, size_t size);
+
+/**
+ * Releases the memory allocated by ARENA_init
+*/
+void ARENA_free(struct arena *arena);
+
+/**
+ * Returns size bytes aligned to ARENA_ALIGNMENT, NULL if the arena is full
+*/
+void *ARENA_alloc(struct arena *arena, size_t size);
+
+/**
+ * Releases every allocation
+*/
+static inline void ARENA_reset(struct arena *arena)
+{
+	arena->used = 0;
+}
+
+#endif
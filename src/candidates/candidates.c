@@ -0,0 +1,208 @@
+#include "candidates.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "../code/code.h"
+#include "../matrix/matrix.h"
+
+#define SUCCESS 0
+#define FAILURE -1
+
+// Words with at least this many candidates are scored with CODE_score_many
+#define DENSE_BITS 16
+
+int CANDIDATES_init(struct candidates *candidates, const struct code_set *space, uint8_t colours,
+					const struct matrix *matrix)
+{
+	memset(candidates, 0, sizeof(*candidates));
+	candidates->space = space;
+	candidates->colours = colours;
+	if (matrix && MATRIX_covers(matrix, space->size, colours))
+		candidates->matrix = matrix;
+
+	candidates->words = (space->length + 63) / 64;
+	size_t bytes = ((size_t)candidates->words * sizeof(uint64_t) + 63) & ~(size_t)63;
+	candidates->bits = aligned_alloc(64, bytes ? bytes : 64);
+	if (!candidates->bits)
+	{
+		perror("Unable to allocate memory for the candidates");
+		return FAILURE;
+	}
+
+	CANDIDATES_reset(candidates);
+	return SUCCESS;
+}
+
+void CANDIDATES_free(struct candidates *candidates)
+{
+	free(candidates->bits);
+	candidates->bits = NULL;
+}
+
+void CANDIDATES_reset(struct candidates *candidates)
+{
+	uint32_t length = candidates->space->length;
+	memset(candidates->bits, 0xFF, (size_t)candidates->words * sizeof(uint64_t));
+	if (length % 64)
+		candidates->bits[candidates->words - 1] = (UINT64_C(1) << (length % 64)) - 1;
+
+	candidates->first = 0;
+	candidates->end = candidates->words;
+	candidates->count = length;
+	candidates->used = 0;
+}
+
+/**
+ * Clears the bits of the word whose code does not give the class for the
+ * guess, looked up in the row of the guess in the matrix
+*/
+static uint64_t prune_word_matrix(uint64_t word, uint32_t base, const uint8_t *row, uint8_t class)
+{
+	uint64_t keep = word;
+	while (word)
+	{
+		int bit = __builtin_ctzll(word);
+		word &= word - 1;
+		keep ^= (uint64_t)(row[base + bit] != class) << bit;
+	}
+	return keep;
+}
+
+/**
+ * Clears the bits of the word whose code does not give the score for the guess
+*/
+static uint64_t prune_word(uint64_t word, uint32_t base, const struct code_set *space, uint64_t guess,
+						   const struct code_counts *guess_counts, uint16_t score)
+{
+	uint64_t keep = word;
+	while (word)
+	{
+		int bit = __builtin_ctzll(word);
+		word &= word - 1;
+		uint32_t rank = base + bit;
+		struct code_counts counts = {{space->counts[0][rank], space->counts[1][rank]}};
+		uint16_t result = CODE_score_counts(space->codes[rank], &counts, guess, guess_counts, space->size);
+		keep ^= (uint64_t)(result != score) << bit;
+	}
+	return keep;
+}
+
+/**
+ * Scores the 64 codes of the word with CODE_score_many and keeps the
+ * candidates which give the score, for the words with many candidates
+*/
+static uint64_t prune_word_dense(uint64_t word, uint32_t base, const struct code_set *space, uint64_t guess,
+								 uint16_t score)
+{
+	// The 64 codes of a word start at a multiple of 512 bytes, still aligned for the vector loads
+	uint32_t length = space->length - base < 64 ? space->length - base : 64;
+	struct code_set window =
+	{
+		.size = space->size,
+		.length = length,
+		.capacity = length,
+		.codes = &space->codes[base],
+		.counts = {&space->counts[0][base], &space->counts[1][base]},
+	};
+	uint16_t scores[64];
+	CODE_score_many(guess, &window, scores, NULL);
+
+	uint64_t matches = 0;
+	for (uint32_t i = 0; i < length; i++)
+		matches |= (uint64_t)(scores[i] == score) << i;
+	return word & matches;
+}
+
+uint32_t CANDIDATES_prune(struct candidates *candidates, uint64_t guess, uint16_t score)
+{
+	const struct code_set *space = candidates->space;
+	const struct matrix *matrix = candidates->matrix;
+	const uint8_t *row = NULL;
+	uint8_t class = CODE_CLASS(score, space->size);
+	struct code_counts guess_counts = CODE_counts(guess, space->size);
+	if (matrix)
+		row = &matrix->classes[(size_t)CODE_rank(guess, space->size, candidates->colours) * matrix->codes];
+	for (uint8_t i = 0; i < space->size; i++)
+		candidates->used |= 1u << CODE_get(guess, i);
+
+	uint32_t count = 0;
+	uint32_t first = candidates->end;
+	uint32_t end = candidates->first;
+	for (uint32_t w = candidates->first; w < candidates->end; w++)
+	{
+		uint64_t word = candidates->bits[w];
+		if (!word)
+			continue;
+
+		if (row)
+			word = prune_word_matrix(word, w * 64, row, class);
+		else if (__builtin_popcountll(word) >= DENSE_BITS)
+			word = prune_word_dense(word, w * 64, space, guess, score);
+		else
+			word = prune_word(word, w * 64, space, guess, &guess_counts, score);
+		candidates->bits[w] = word;
+		if (word)
+		{
+			count += __builtin_popcountll(word);
+			if (first > w)
+				first = w;
+			end = w + 1;
+		}
+	}
+
+	// Later prunes skip the leading and trailing empty words
+	candidates->first = count ? first : 0;
+	candidates->end = count ? end : 0;
+	candidates->count = count;
+	return count;
+}
+
+uint32_t CANDIDATES_next(const struct candidates *candidates, uint32_t rank)
+{
+	uint32_t w = rank / 64;
+	if (w < candidates->first)
+	{
+		w = candidates->first;
+		rank = w * 64;
+	}
+
+	for (; w < candidates->end; w++, rank = w * 64)
+	{
+		uint64_t word = candidates->bits[w] >> (rank % 64);
+		if (word)
+			return rank + __builtin_ctzll(word);
+	}
+	return CANDIDATES_END;
+}
+
+uint32_t CANDIDATES_select(const struct candidates *candidates, uint32_t index)
+{
+	uint32_t w = candidates->first;
+	uint64_t word = candidates->bits[w];
+	for (uint32_t count; index >= (count = __builtin_popcountll(word)); word = candidates->bits[++w])
+		index -= count;
+
+	// Drops the lower candidates of the word
+	for (; index; index--)
+		word &= word - 1;
+	return w * 64 + __builtin_ctzll(word);
+}
+
+bool CANDIDATES_canonical(const struct candidates *candidates, uint64_t guess)
+{
+	// The unused numbers are swapped into the smallest ones, from the most significant position
+	uint16_t unused = ~candidates->used & (uint16_t)(((1u << candidates->colours) - 1) << 1);
+	uint16_t seen = 0;
+	for (uint8_t i = candidates->space->size; i-- > 0;)
+	{
+		uint16_t number = 1u << CODE_get(guess, i);
+		if (!(number & unused) || (number & seen))
+			continue;
+		if (number != (unused & -unused))
+			return false;
+		seen |= number;
+		unused &= ~number;
+	}
+	return true;
+}
@@ -0,0 +1,106 @@
+#ifndef CANDIDATES_H
+#define CANDIDATES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../code/code.h"
+#include "../matrix/matrix.h"
+
+/**
+ * Candidate set of a code space as a dense bitset.
+ * Bit r is set while the code of rank r (see CODE_rank) is still consistent
+ * with the feedback of every guess so far. A 4 numbers from 1 to 6 space is
+ * 21 words, the set is copied or reset with a memcpy/memset of a few
+ * cache lines.
+ *
+ * Pruning only visits the set bits, so every guess costs less than the one
+ * before it. The codes come from the code space set (in rank order, see
+ * SOLVER_space_init), which is only read and can be shared by any number of
+ * candidate sets. With a matrix of the code space (see matrix.h) a survivor
+ * is checked with one byte load instead of scoring it.
+*/
+
+// Returned by CANDIDATES_next when there are no more candidates
+#define CANDIDATES_END UINT32_MAX
+
+struct candidates
+{
+	const struct code_set *space;  // Every code in rank order, shared
+	const struct matrix *matrix;  // NULL - the survivors are scored
+	uint8_t colours;
+	uint32_t words;  // Number of 64 bit words of the bitset
+	uint32_t first;  // The words before first are 0
+	uint32_t end;  // The words from end are 0
+	uint32_t count;  // Number of set bits
+	uint16_t used;  // Bit i - number i is in one of the pruned guesses
+	uint64_t *bits;
+};
+
+/**
+ * Initialises a set of every code of the space, numbers from 1 to colours.
+ * The matrix is used if it covers the code space, it can be NULL.
+ * Returns 0 on success, -1 on failure.
+*/
+int CANDIDATES_init(struct candidates *candidates, const struct code_set *space, uint8_t colours,
+					const struct matrix *matrix);
+
+/**
+ * Releases the memory of the set
+*/
+void CANDIDATES_free(struct candidates *candidates);
+
+/**
+ * Puts every code back in the set, for a new game
+*/
+void CANDIDATES_reset(struct candidates *candidates);
+
+/**
+ * Removes the candidates which do not give the packed score (see score.h)
+ * for the guess and returns the number of the remaining ones
+*/
+uint32_t CANDIDATES_prune(struct candidates *candidates, uint64_t guess, uint16_t score);
+
+/**
+ * Returns the number of remaining candidates
+*/
+static inline uint32_t CANDIDATES_count(const struct candidates *candidates)
+{
+	return candidates->count;
+}
+
+/**
+ * Returns true if the code of the rank is still a candidate
+*/
+static inline bool CANDIDATES_contains(const struct candidates *candidates, uint32_t rank)
+{
+	return candidates->bits[rank / 64] >> (rank % 64) & 1;
+}
+
+/**
+ * Returns the rank of the first candidate from rank on, CANDIDATES_END if none
+*/
+uint32_t CANDIDATES_next(const struct candidates *candidates, uint32_t rank);
+
+/**
+ * Returns the rank of the candidate with the given index (from 0, in rank
+ * order), index has to be below the number of candidates
+*/
+uint32_t CANDIDATES_select(const struct candidates *candidates, uint32_t index);
+
+/**
+ * Returns false if the guess is another one with the numbers which are in
+ * none of the pruned guesses swapped. Such guesses split the candidates the
+ * same way, so a search only needs the canonical one, which has the lowest
+ * rank of them.
+*/
+bool CANDIDATES_canonical(const struct candidates *candidates, uint64_t guess);
+
+/**
+ * Returns the code of the rank
+*/
+static inline uint64_t CANDIDATES_code(const struct candidates *candidates, uint32_t rank)
+{
+	return candidates->space->codes[rank];
+}
+
+#endif
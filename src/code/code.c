@@ -0,0 +1,446 @@
+#include "code.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "../score/score.h"
+#include "../stats/stats.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CODE_X86
+#endif
+
+#define SUCCESS 0
+#define FAILURE -1
+
+// Lowest bit of every nibble
+#define NIBBLE_LOW 0x1111111111111111ull
+// Lowest and highest bit of every byte
+#define BYTE_LOW 0x0101010101010101ull
+#define BYTE_HIGH 0x8080808080808080ull
+
+/**
+ * Mask of the nibbles of the first size numbers
+*/
+static uint64_t numbers_mask(uint8_t size)
+{
+	return size >= CODE_NUMBERS_MAX ? UINT64_MAX : (1ull << (size * 4)) - 1;
+}
+
+uint64_t CODE_encode(const int numbers[], uint8_t size)
+{
+	uint64_t code = 0;
+	for (uint8_t i = 0; i < size; i++)
+		code |= (uint64_t)(numbers[i] & 0xF) << (i * 4);
+	return code;
+}
+
+void CODE_decode(uint64_t code, int numbers[], uint8_t size)
+{
+	for (uint8_t i = 0; i < size; i++)
+		numbers[i] = CODE_get(code, i);
+}
+
+uint32_t CODE_rank(uint64_t code, uint8_t size, uint8_t colours)
+{
+	uint32_t rank = 0;
+	for (uint8_t i = size; i-- > 0;)
+		rank = rank * colours + CODE_get(code, i) - 1;
+	return rank;
+}
+
+uint64_t CODE_unrank(uint32_t rank, uint8_t size, uint8_t colours)
+{
+	uint64_t code = 0;
+	for (uint8_t i = 0; i < size; i++)
+	{
+		code |= (uint64_t)(rank % colours + 1) << (i * 4);
+		rank /= colours;
+	}
+	return code;
+}
+
+struct code_counts CODE_counts(uint64_t code, uint8_t size)
+{
+	struct code_counts counts = {{0, 0}};
+	for (uint8_t i = 0; i < size; i++)
+	{
+		uint8_t number = CODE_get(code, i);
+		counts.lanes[number >> 3] += 1ull << ((number & 7) * 8);
+	}
+	return counts;
+}
+
+uint8_t CODE_exact(uint64_t secret, uint64_t guess, uint8_t size)
+{
+	// Fold every nibble of the difference into its lowest bit - set where the numbers differ
+	uint64_t difference = secret ^ guess;
+	difference |= difference >> 1;
+	difference |= difference >> 2;
+	difference &= NIBBLE_LOW & numbers_mask(size);
+
+	return size - __builtin_popcountll(difference);
+}
+
+/**
+ * Sum of the byte lanes of min(a, b), every lane below 128
+*/
+static uint8_t sum_min(uint64_t a, uint64_t b)
+{
+	// The high bit of a lane of (a | 0x80) - b stays set where a >= b, no borrow crosses lanes
+	uint64_t a_greater = (((a | BYTE_HIGH) - b) & BYTE_HIGH) >> 7;
+	uint64_t mask = a_greater * 0xFF;
+	uint64_t min = (b & mask) | (a & ~mask);
+
+	return (min * BYTE_LOW) >> 56;  // Adds all the lanes into the top byte
+}
+
+uint16_t CODE_score_counts(uint64_t secret, const struct code_counts *secret_counts,
+						   uint64_t guess, const struct code_counts *guess_counts, uint8_t size)
+{
+	uint8_t exact = CODE_exact(secret, guess, size);
+	// Numbers in common regardless of the position, the exact matches included
+	uint8_t common = sum_min(secret_counts->lanes[0], guess_counts->lanes[0])
+		+ sum_min(secret_counts->lanes[1], guess_counts->lanes[1]);
+
+	return SCORE_PACK(exact, common - exact);
+}
+
+uint16_t CODE_score(uint64_t secret, uint64_t guess, uint8_t size)
+{
+	struct code_counts secret_counts = CODE_counts(secret, size);
+	struct code_counts guess_counts = CODE_counts(guess, size);
+	return CODE_score_counts(secret, &secret_counts, guess, &guess_counts, size);
+}
+
+int CODE_set_init(struct code_set *set, uint8_t size, uint32_t capacity)
+{
+	memset(set, 0, sizeof(*set));
+	set->size = size;
+	set->capacity = capacity;
+
+	// Aligned to a cache line for the vector loads
+	size_t bytes = ((size_t)capacity * sizeof(uint64_t) + 63) & ~(size_t)63;
+	if (!bytes)
+		bytes = 64;
+	set->codes = aligned_alloc(64, bytes);
+	set->counts[0] = aligned_alloc(64, bytes);
+	set->counts[1] = aligned_alloc(64, bytes);
+	set->owned = true;
+	if (!set->codes || !set->counts[0] || !set->counts[1])
+	{
+		perror("Unable to allocate memory for the code set");
+		CODE_set_free(set);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+int CODE_set_init_arena(struct code_set *set, uint8_t size, uint32_t capacity, struct arena *arena)
+{
+	memset(set, 0, sizeof(*set));
+	set->size = size;
+	set->capacity = capacity;
+
+	size_t bytes = (size_t)capacity * sizeof(uint64_t);
+	set->codes = ARENA_alloc(arena, bytes);
+	set->counts[0] = ARENA_alloc(arena, bytes);
+	set->counts[1] = ARENA_alloc(arena, bytes);
+	if (!set->codes || !set->counts[0] || !set->counts[1])
+	{
+		fprintf(stderr, "Error - Not enough arena memory for a set of %u codes\n", capacity);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+void CODE_set_free(struct code_set *set)
+{
+	if (set->owned)
+	{
+		free(set->codes);
+		free(set->counts[0]);
+		free(set->counts[1]);
+	}
+	memset(set, 0, sizeof(*set));
+}
+
+int CODE_set_add(struct code_set *set, uint64_t code)
+{
+	if (set->length == set->capacity)
+		return FAILURE;
+
+	struct code_counts counts = CODE_counts(code, set->size);
+	set->codes[set->length] = code;
+	set->counts[0][set->length] = counts.lanes[0];
+	set->counts[1][set->length] = counts.lanes[1];
+	set->length++;
+
+	return SUCCESS;
+}
+
+uint32_t CODE_set_filter(const struct code_set *from, struct code_set *to, uint64_t guess, uint16_t score,
+						 uint16_t scores[])
+{
+	CODE_score_many(guess, from, scores, NULL);
+
+	// Kept codes never move forward, so filtering a set into itself is safe
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < from->length; i++)
+	{
+		to->codes[kept] = from->codes[i];
+		to->counts[0][kept] = from->counts[0][i];
+		to->counts[1][kept] = from->counts[1][i];
+		kept += scores[i] == score;
+	}
+	to->length = kept;
+	return kept;
+}
+
+/**
+ * Stores the score of code i of the set and counts its class
+*/
+static inline void store_score(uint32_t i, uint8_t exact, uint8_t approx, uint8_t size,
+							   uint16_t scores[], uint32_t partitions[])
+{
+	if (scores)
+		scores[i] = SCORE_PACK(exact, approx);
+	if (partitions)
+		partitions[exact * (size + 1) + approx]++;
+}
+
+/**
+ * Scores the codes from first to the end of the set one by one
+*/
+static void score_scalar(uint64_t guess, const struct code_counts *guess_counts, const struct code_set *set,
+						 uint32_t first, uint16_t scores[], uint32_t partitions[])
+{
+	for (uint32_t i = first; i < set->length; i++)
+	{
+		struct code_counts counts = {{set->counts[0][i], set->counts[1][i]}};
+		uint16_t score = CODE_score_counts(set->codes[i], &counts, guess, guess_counts, set->size);
+		store_score(i, SCORE_EXACT(score), SCORE_APPROX(score), set->size, scores, partitions);
+	}
+}
+
+static void score_many_scalar(uint64_t guess, const struct code_set *set, uint16_t scores[], uint32_t partitions[])
+{
+	struct code_counts guess_counts = CODE_counts(guess, set->size);
+	score_scalar(guess, &guess_counts, set, 0, scores, partitions);
+}
+
+#ifdef CODE_X86
+/*
+ * The vector kernels do the same as CODE_score_counts on 4 (AVX2) or
+ * 2 (SSE) codes at once. _mm_sad_epu8 against zero adds up the bytes of
+ * every 64-bit lane, which gives both the popcount of the folded
+ * difference and the sum of the per byte minimum of the colour counts.
+*/
+
+__attribute__((target("avx2")))
+static void score_many_avx2(uint64_t guess, const struct code_set *set, uint16_t scores[], uint32_t partitions[])
+{
+	struct code_counts guess_counts = CODE_counts(guess, set->size);
+	const __m256i guess_code = _mm256_set1_epi64x(guess);
+	const __m256i guess_lo = _mm256_set1_epi64x(guess_counts.lanes[0]);
+	const __m256i guess_hi = _mm256_set1_epi64x(guess_counts.lanes[1]);
+	const __m256i nibbles = _mm256_set1_epi64x(NIBBLE_LOW & numbers_mask(set->size));
+	const __m256i byte_low = _mm256_set1_epi64x(BYTE_LOW);
+	const __m256i size = _mm256_set1_epi64x(set->size);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i classes_row = _mm256_set1_epi64x(set->size + 1);
+	// Bytes 0-1 and 8-9 of every 128-bit half to the bottom, then the bottom dwords of both halves together
+	const __m256i pack_scores = _mm256_setr_epi8(0, 1, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+												 0, 1, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m256i pack_lanes = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+
+	uint32_t lane_partitions[4][CODE_CLASSES(CODE_NUMBERS_MAX)];
+	if (partitions)
+		memset(lane_partitions, 0, sizeof(lane_partitions));
+
+	uint32_t i = 0;
+	for (; i + 4 <= set->length; i += 4)
+	{
+		__m256i difference = _mm256_xor_si256(_mm256_load_si256((const __m256i *)&set->codes[i]), guess_code);
+		difference = _mm256_or_si256(difference, _mm256_srli_epi64(difference, 1));
+		difference = _mm256_or_si256(difference, _mm256_srli_epi64(difference, 2));
+		difference = _mm256_and_si256(difference, nibbles);
+		// Bits 0 and 4 of every byte can be set, count them per byte
+		__m256i bits = _mm256_add_epi8(_mm256_and_si256(difference, byte_low),
+									   _mm256_and_si256(_mm256_srli_epi64(difference, 4), byte_low));
+		__m256i exact = _mm256_sub_epi64(size, _mm256_sad_epu8(bits, zero));
+
+		__m256i lo = _mm256_min_epu8(_mm256_load_si256((const __m256i *)&set->counts[0][i]), guess_lo);
+		__m256i hi = _mm256_min_epu8(_mm256_load_si256((const __m256i *)&set->counts[1][i]), guess_hi);
+		__m256i common = _mm256_add_epi64(_mm256_sad_epu8(lo, zero), _mm256_sad_epu8(hi, zero));
+		__m256i approx = _mm256_sub_epi64(common, exact);
+
+		// score = exact << 8 | approx, class = exact * (size + 1) + approx
+		__m256i score = _mm256_or_si256(_mm256_slli_epi64(exact, 8), approx);
+		__m256i class = _mm256_add_epi64(_mm256_mul_epu32(exact, classes_row), approx);
+		if (scores)
+		{
+			// The low 16 bits of every 64-bit lane next to each other
+			__m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(score, pack_scores), pack_lanes);
+			_mm_storel_epi64((__m128i *)&scores[i], _mm256_castsi256_si128(packed));
+		}
+		if (partitions)
+		{
+			// One histogram per lane, so consecutive codes of the same class do not wait for each other
+			lane_partitions[0][_mm256_extract_epi64(class, 0)]++;
+			lane_partitions[1][_mm256_extract_epi64(class, 1)]++;
+			lane_partitions[2][_mm256_extract_epi64(class, 2)]++;
+			lane_partitions[3][_mm256_extract_epi64(class, 3)]++;
+		}
+	}
+
+	if (partitions)
+	{
+		for (uint32_t c = 0; c < CODE_CLASSES(set->size); c++)
+			partitions[c] += lane_partitions[0][c] + lane_partitions[1][c] + lane_partitions[2][c] + lane_partitions[3][c];
+	}
+	score_scalar(guess, &guess_counts, set, i, scores, partitions);
+}
+
+__attribute__((target("sse4.2")))
+static void score_many_sse42(uint64_t guess, const struct code_set *set, uint16_t scores[], uint32_t partitions[])
+{
+	struct code_counts guess_counts = CODE_counts(guess, set->size);
+	const __m128i guess_code = _mm_set1_epi64x(guess);
+	const __m128i guess_lo = _mm_set1_epi64x(guess_counts.lanes[0]);
+	const __m128i guess_hi = _mm_set1_epi64x(guess_counts.lanes[1]);
+	const __m128i nibbles = _mm_set1_epi64x(NIBBLE_LOW & numbers_mask(set->size));
+	const __m128i byte_low = _mm_set1_epi64x(BYTE_LOW);
+	const __m128i size = _mm_set1_epi64x(set->size);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i classes_row = _mm_set1_epi64x(set->size + 1);
+	const __m128i pack_scores = _mm_setr_epi8(0, 1, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	uint32_t lane_partitions[2][CODE_CLASSES(CODE_NUMBERS_MAX)];
+	if (partitions)
+		memset(lane_partitions, 0, sizeof(lane_partitions));
+
+	uint32_t i = 0;
+	for (; i + 2 <= set->length; i += 2)
+	{
+		__m128i difference = _mm_xor_si128(_mm_load_si128((const __m128i *)&set->codes[i]), guess_code);
+		difference = _mm_or_si128(difference, _mm_srli_epi64(difference, 1));
+		difference = _mm_or_si128(difference, _mm_srli_epi64(difference, 2));
+		difference = _mm_and_si128(difference, nibbles);
+		__m128i bits = _mm_add_epi8(_mm_and_si128(difference, byte_low),
+									_mm_and_si128(_mm_srli_epi64(difference, 4), byte_low));
+		__m128i exact = _mm_sub_epi64(size, _mm_sad_epu8(bits, zero));
+
+		__m128i lo = _mm_min_epu8(_mm_load_si128((const __m128i *)&set->counts[0][i]), guess_lo);
+		__m128i hi = _mm_min_epu8(_mm_load_si128((const __m128i *)&set->counts[1][i]), guess_hi);
+		__m128i common = _mm_add_epi64(_mm_sad_epu8(lo, zero), _mm_sad_epu8(hi, zero));
+		__m128i approx = _mm_sub_epi64(common, exact);
+
+		__m128i score = _mm_or_si128(_mm_slli_epi64(exact, 8), approx);
+		__m128i class = _mm_add_epi64(_mm_mul_epu32(exact, classes_row), approx);
+		if (scores)
+		{
+			uint32_t packed = _mm_cvtsi128_si32(_mm_shuffle_epi8(score, pack_scores));
+			memcpy(&scores[i], &packed, sizeof(packed));
+		}
+		if (partitions)
+		{
+			lane_partitions[0][_mm_cvtsi128_si64(class)]++;
+			lane_partitions[1][_mm_extract_epi64(class, 1)]++;
+		}
+	}
+
+	if (partitions)
+	{
+		for (uint32_t c = 0; c < CODE_CLASSES(set->size); c++)
+			partitions[c] += lane_partitions[0][c] + lane_partitions[1][c];
+	}
+
+	score_scalar(guess, &guess_counts, set, i, scores, partitions);
+}
+#endif
+
+struct kernel
+{
+	const char *name;
+	void (*score_many)(uint64_t guess, const struct code_set *set, uint16_t scores[], uint32_t partitions[]);
+};
+
+static const struct kernel kernels[] =
+{
+	[CODE_KERNEL_SCALAR] = {"scalar", score_many_scalar},
+#ifdef CODE_X86
+	[CODE_KERNEL_SSE42] = {"sse4.2", score_many_sse42},
+	[CODE_KERNEL_AVX2] = {"avx2", score_many_avx2},
+#endif
+};
+
+static const struct kernel *kernel;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static bool supported(enum code_kernel type)
+{
+	switch (type)
+	{
+		case CODE_KERNEL_SCALAR:
+			return true;
+#ifdef CODE_X86
+		case CODE_KERNEL_SSE42:
+			return __builtin_cpu_supports("sse4.2");
+		case CODE_KERNEL_AVX2:
+			return __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return false;
+	}
+}
+
+/**
+ * Picks the fastest kernel the CPU supports
+*/
+static void select_auto(void)
+{
+	if (kernel)
+		return;  // Selected by CODE_select_kernel
+
+	enum code_kernel type = CODE_KERNEL_SCALAR;
+	if (supported(CODE_KERNEL_AVX2))
+		type = CODE_KERNEL_AVX2;
+	else if (supported(CODE_KERNEL_SSE42))
+		type = CODE_KERNEL_SSE42;
+	kernel = &kernels[type];
+}
+
+bool CODE_select_kernel(enum code_kernel type)
+{
+	if (type == CODE_KERNEL_AUTO)
+	{
+		kernel = NULL;
+		select_auto();
+		return true;
+	}
+	if (!supported(type))
+		return false;
+
+	kernel = &kernels[type];
+	return true;
+}
+
+const char *CODE_kernel_name(void)
+{
+	pthread_once(&kernel_once, select_auto);
+	return kernel->name;
+}
+
+void CODE_score_many(uint64_t guess, const struct code_set *set, uint16_t scores[], uint32_t partitions[])
+{
+	pthread_once(&kernel_once, select_auto);
+	STATS_BEGIN(score_start);
+	kernel->score_many(guess, set, scores, partitions);
+	STATS_END(STATS_SCORE_MANY_NS, score_start);
+}
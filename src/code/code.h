@@ -0,0 +1,165 @@
+#ifndef CODE_H
+#define CODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../score/score.h"
+#include "../arena/arena.h"
+
+/**
+ * Packed codes - a whole sequence in one uint64_t, 4 bits per number.
+ * Number i of the sequence is in bits 4i to 4i + 3, the unused high
+ * numbers are 0. A candidate set of packed codes is 8 codes per cache line
+ * and a pair is scored with a few word operations instead of loops.
+ *
+ * The colour counts of a code (how many times each number appears) are
+ * packed as well, one byte per number: lanes[0] holds the numbers 0-7,
+ * lanes[1] the numbers 8-15. Solvers scoring the same codes many times can
+ * compute them once with CODE_counts.
+*/
+
+// Longest sequence that fits in a packed code
+#define CODE_NUMBERS_MAX 16
+// Largest number that fits in 4 bits
+#define CODE_COLOURS_MAX 15
+
+struct code_counts
+{
+	uint64_t lanes[2];
+};
+
+/**
+ * Packs size numbers (0 to CODE_COLOURS_MAX) into a code
+*/
+uint64_t CODE_encode(const int numbers[], uint8_t size);
+
+/**
+ * Unpacks the first size numbers of the code
+*/
+void CODE_decode(uint64_t code, int numbers[], uint8_t size);
+
+/**
+ * Returns the number at the position
+*/
+static inline uint8_t CODE_get(uint64_t code, uint8_t position)
+{
+	return (code >> (position * 4)) & 0xF;
+}
+
+/**
+ * Returns the index of the code among all the codes of size numbers from
+ * 1 to colours, the first number is the least significant digit.
+*/
+uint32_t CODE_rank(uint64_t code, uint8_t size, uint8_t colours);
+
+/**
+ * Returns the code with the given index, see CODE_rank
+*/
+uint64_t CODE_unrank(uint32_t rank, uint8_t size, uint8_t colours);
+
+/**
+ * Returns the colour counts of the first size numbers of the code
+*/
+struct code_counts CODE_counts(uint64_t code, uint8_t size);
+
+/**
+ * Returns the number of positions with the same number (exact matches)
+*/
+uint8_t CODE_exact(uint64_t secret, uint64_t guess, uint8_t size);
+
+/**
+ * Returns the packed score of the guess (see score.h)
+*/
+uint16_t CODE_score(uint64_t secret, uint64_t guess, uint8_t size);
+
+/**
+ * Same as CODE_score with the colour counts of both codes computed beforehand
+*/
+uint16_t CODE_score_counts(uint64_t secret, const struct code_counts *secret_counts,
+						   uint64_t guess, const struct code_counts *guess_counts, uint8_t size);
+
+/**
+ * Candidate set in a structure of arrays layout for batch scoring:
+ * the codes and the two halves of their colour counts in separate arrays.
+*/
+struct code_set
+{
+	uint8_t size;  // Sequence length of the codes
+	uint32_t length;
+	uint32_t capacity;
+	uint64_t *codes;
+	uint64_t *counts[2];  // counts[k][i] - lanes[k] of the colour counts of codes[i]
+	bool owned;  // The arrays were allocated by CODE_set_init
+};
+
+// Arena memory of a set of capacity codes, see CODE_set_init_arena
+#define CODE_SET_ARENA_SIZE(capacity) (3 * ARENA_SIZE((size_t)(capacity) * sizeof(uint64_t)))
+
+// Number of feedback classes of a sequence length
+#define CODE_CLASSES(size) (((size) + 1) * ((size) + 1))
+// Feedback class of a packed score, from 0 to CODE_CLASSES(size) - 1
+#define CODE_CLASS(score, size) (SCORE_EXACT(score) * ((size) + 1) + SCORE_APPROX(score))
+
+/**
+ * Implementations of CODE_score_many
+*/
+enum code_kernel
+{
+	CODE_KERNEL_AUTO,  // The fastest one the CPU supports
+	CODE_KERNEL_SCALAR,
+	CODE_KERNEL_SSE42,  // x86-64 only
+	CODE_KERNEL_AVX2,  // x86-64 only
+};
+
+/**
+ * Allocates an empty set for capacity codes of the given length.
+ * Returns 0 on success, -1 on failure.
+*/
+int CODE_set_init(struct code_set *set, uint8_t size, uint32_t capacity);
+
+/**
+ * Same as CODE_set_init with the memory (CODE_SET_ARENA_SIZE) from the arena.
+ * Returns 0 on success, -1 if the arena is full.
+*/
+int CODE_set_init_arena(struct code_set *set, uint8_t size, uint32_t capacity, struct arena *arena);
+
+/**
+ * Releases the memory of the set, the memory of an arena goes back with the arena
+*/
+void CODE_set_free(struct code_set *set);
+
+/**
+ * Adds the code to the set. Returns 0 on success, -1 if the set is full.
+*/
+int CODE_set_add(struct code_set *set, uint64_t code);
+
+/**
+ * Copies the codes of from which score the given packed score against the
+ * guess into to (which can be from itself) and returns their number.
+ * to needs the capacity of from->length codes, scores is scratch space
+ * for from->length scores.
+*/
+uint32_t CODE_set_filter(const struct code_set *from, struct code_set *to, uint64_t guess, uint16_t score,
+						 uint16_t scores[]);
+
+/**
+ * Selects the implementation of CODE_score_many, CODE_KERNEL_AUTO by default.
+ * Not thread-safe, meant to be called at the start of the program.
+ * Returns false (and keeps the current one) if the CPU does not support it.
+*/
+bool CODE_select_kernel(enum code_kernel kernel);
+
+/**
+ * Returns the name of the selected CODE_score_many implementation
+*/
+const char *CODE_kernel_name(void);
+
+/**
+ * Scores the guess against every code of the set.
+ * scores - receives the packed score of every code, can be NULL
+ * partitions - CODE_CLASSES(set->size) counters, the counter of the feedback
+ *              class of every code is incremented, can be NULL
+*/
+void CODE_score_many(uint64_t guess, const struct code_set *set, uint16_t scores[], uint32_t partitions[]);
+
+#endif
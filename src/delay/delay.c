@@ -0,0 +1,105 @@
+#include "delay.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "../timeunits.h"
+#include "../stats/stats.h"
+
+// Number of sleeps measured by the calibration
+#define CALIBRATION_SAMPLES 64
+// Length of each measured sleep
+#define CALIBRATION_SLEEP_NS US_TO_NS(20)
+// Percentile of the measured overshoots used as the spin time
+#define CALIBRATION_PERCENTILE 90
+// Extra spin time on top of the measured overshoot
+#define SPIN_MARGIN_NS US_TO_NS(10)
+// Bounds of the spin time
+#define SPIN_MIN_NS US_TO_NS(20)
+#define SPIN_MAX_NS MS_TO_NS(2)
+
+static uint64_t spin_time = SPIN_MAX_NS;  // Safe value until calibrated
+static pthread_once_t calibrate_once = PTHREAD_ONCE_INIT;
+static void (*delay_hook)(uint64_t ns);
+
+uint64_t DELAY_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+	return (uint64_t)now.tv_sec * SEC_TO_NS(1u) + now.tv_nsec;
+}
+
+/**
+ * Sleeps ns nanoseconds with clock_nanosleep (relative, CLOCK_MONOTONIC)
+*/
+static void sleep_ns(uint64_t ns)
+{
+	struct timespec delay =
+	{
+		.tv_sec = ns / SEC_TO_NS(1u),
+		.tv_nsec = ns % SEC_TO_NS(1u),
+	};
+	clock_nanosleep(CLOCK_MONOTONIC, 0, &delay, NULL);
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+void DELAY_calibrate(void)
+{
+	uint64_t overshoot[CALIBRATION_SAMPLES];
+
+	for (int i = 0; i < CALIBRATION_SAMPLES; i++)
+	{
+		uint64_t start = DELAY_now();
+		sleep_ns(CALIBRATION_SLEEP_NS);
+		uint64_t elapsed = DELAY_now() - start;
+		overshoot[i] = elapsed > CALIBRATION_SLEEP_NS ? elapsed - CALIBRATION_SLEEP_NS : 0;
+	}
+
+	qsort(overshoot, CALIBRATION_SAMPLES, sizeof(overshoot[0]), compare_u64);
+	uint64_t spin = overshoot[CALIBRATION_SAMPLES * CALIBRATION_PERCENTILE / 100] + SPIN_MARGIN_NS;
+
+	if (spin < SPIN_MIN_NS)
+		spin = SPIN_MIN_NS;
+	if (spin > SPIN_MAX_NS)
+		spin = SPIN_MAX_NS;
+	spin_time = spin;
+}
+
+uint64_t DELAY_get_spin_time(void)
+{
+	pthread_once(&calibrate_once, DELAY_calibrate);
+	return spin_time;
+}
+
+void DELAY_ns(uint64_t ns)
+{
+	if (delay_hook)
+	{
+		delay_hook(ns);
+		return;
+	}
+
+	STATS_BEGIN(delay_start);
+	uint64_t deadline = DELAY_now() + ns;
+	uint64_t spin = DELAY_get_spin_time();
+
+	// Sleep for the bulk of the delay, the scheduler may wake us up late by up to spin
+	if (ns > spin)
+		sleep_ns(ns - spin);
+
+	// Spin for the rest
+	while (DELAY_now() < deadline)
+		;
+	STATS_END(STATS_SLEEP_NS, delay_start);
+}
+
+void DELAY_set_hook(void (*hook)(uint64_t ns))
+{
+	delay_hook = hook;
+}
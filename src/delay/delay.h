@@ -0,0 +1,40 @@
+#ifndef DELAY_H
+#define DELAY_H
+
+#include <stdint.h>
+
+/**
+ * Precise delays.
+ * Long waits sleep with clock_nanosleep() and the last part of the wait
+ * (the calibrated sleep overshoot) is spent spinning on CLOCK_MONOTONIC_RAW,
+ * so short delays are not stretched by the scheduler.
+*/
+
+/**
+ * Measures how much clock_nanosleep() overshoots on this system.
+ * Called automatically by the first delay, calling it again recalibrates.
+*/
+void DELAY_calibrate(void);
+
+/**
+ * Returns the time (ns) that is spun instead of slept at the end of a delay
+*/
+uint64_t DELAY_get_spin_time(void);
+
+/**
+ * Waits ns nanoseconds
+*/
+void DELAY_ns(uint64_t ns);
+
+/**
+ * Returns the time (ns) of CLOCK_MONOTONIC_RAW
+*/
+uint64_t DELAY_now(void);
+
+/**
+ * Replaces waiting with a call of hook (for example GPIO_sim_advance to move
+ * the manual clock of the GPIO simulator). NULL restores the real delays.
+*/
+void DELAY_set_hook(void (*hook)(uint64_t ns));
+
+#endif
@@ -0,0 +1,206 @@
+#include "game.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../score/score.h"
+#include "../stats/stats.h"
+
+#define SUCCESS 0
+#define FAILURE -1
+
+// Calls the output callback if it is set
+#define OUTPUT(game, callback, ...) \
+	do \
+	{ \
+		if ((game)->output && (game)->output->callback) \
+			(game)->output->callback((game)->context, __VA_ARGS__); \
+	} while (0)
+
+static void on_input_timeout(struct timer *timer, uint64_t now);
+
+int GAME_init(struct game *game, const struct game_settings *settings,
+			  const struct game_output *output, void *context, struct timer_wheel *wheel,
+			  struct arena *arena)
+{
+	memset(game, 0, sizeof(*game));
+	// Without rounds the game never ends, without numbers nothing can be scored
+	if (!settings->numbers || !settings->max || !settings->rounds)
+	{
+		fprintf(stderr, "Error - A game needs numbers, a maximum number and rounds above 0 (%hhu, %hhu, %hhu)\n",
+				settings->numbers, settings->max, settings->rounds);
+		return FAILURE;
+	}
+
+	game->state = GAME_SECRET;
+	game->settings = *settings;
+	game->output = output;
+	game->context = context;
+	game->wheel = wheel;
+	game->score = SCORE_kernel(settings->numbers);
+	TIMER_init(&game->input_timer, on_input_timeout, game);
+
+	game->secret = ARENA_alloc(arena, settings->numbers * sizeof(int));
+	game->guess = ARENA_alloc(arena, settings->numbers * sizeof(int));
+	if (!game->secret || !game->guess)
+	{
+		fprintf(stderr, "Error - Not enough arena memory for a game of %hhu numbers\n", settings->numbers);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+void GAME_free(struct game *game)
+{
+	TIMER_cancel(game->wheel, &game->input_timer);
+	game->secret = NULL;
+	game->guess = NULL;
+}
+
+/**
+ * Waits for the first digit of the current round
+*/
+static void start_input(struct game *game)
+{
+	game->state = GAME_INPUT;
+	game->position = 0;
+	game->presses = 0;
+	OUTPUT(game, input, game->position);
+}
+
+void GAME_start(struct game *game, const int *secret)
+{
+	memcpy(game->secret, secret, game->settings.numbers * sizeof(int));
+	game->round = 1;
+	start_input(game);
+}
+
+/**
+ * Scores the complete guess and moves to GAME_CONTINUE or GAME_OVER
+*/
+static void score_guess(struct game *game)
+{
+	game->state = GAME_FEEDBACK;
+	OUTPUT(game, guess, game->guess, game->settings.numbers);
+
+	const struct game_settings *settings = &game->settings;
+	STATS_BEGIN(score_start);
+	uint16_t score = MATRIX_covers(settings->matrix, settings->numbers, settings->max)
+		? MATRIX_score(settings->matrix, game->secret, game->guess)
+		: game->score(game->secret, game->guess, settings->numbers, settings->max);
+	STATS_END(STATS_SCORE_NS, score_start);
+	uint8_t exact = SCORE_EXACT(score);
+	uint8_t approx = SCORE_APPROX(score);
+
+	if (exact == game->settings.numbers)
+	{
+		game->state = GAME_OVER;
+		OUTPUT(game, success, game->round);
+		return;
+	}
+
+	game->state = GAME_CONTINUE;
+	OUTPUT(game, feedback, exact, approx);
+}
+
+/**
+ * No press since the input timeout - accept the digit
+*/
+static void on_input_timeout(struct timer *timer, uint64_t now)
+{
+	(void)now;
+	struct game *game = timer->context;
+
+	game->guess[game->position] = game->presses;
+	OUTPUT(game, digit, game->position, game->presses);
+
+	game->presses = 0;
+	if (++game->position < game->settings.numbers)
+		OUTPUT(game, input, game->position);
+	else
+		score_guess(game);
+}
+
+/**
+ * Button event while entering a digit
+*/
+static void input_button(struct game *game, uint8_t level, uint64_t timestamp)
+{
+	if (level)
+	{
+		TIMER_cancel(game->wheel, &game->input_timer);  // The timeout restarts after the release
+		game->presses++;
+		if (game->presses > game->settings.max)  // wrap around
+			game->presses = 1;
+		OUTPUT(game, presses, game->position, game->presses);
+	}
+	else if (game->presses)
+		TIMER_schedule(game->wheel, &game->input_timer, timestamp + game->settings.input_timeout);
+}
+
+/**
+ * Button event after a wrong guess - a full press (and release) continues
+*/
+static void continue_button(struct game *game, uint8_t level)
+{
+	if (level || !game->pressed)
+		return;
+
+	if (game->round == game->settings.rounds)
+	{
+		game->state = GAME_OVER;
+		OUTPUT(game, game_over, game->round);
+		return;
+	}
+
+	game->round++;
+	OUTPUT(game, next_round, game->round);
+	start_input(game);
+}
+
+int GAME_submit_guess(struct game *game, const int *guess)
+{
+	if (game->state == GAME_CONTINUE)
+	{
+		game->pressed = true;
+		continue_button(game, 0);  // Same as a press and release of the button
+	}
+	if (game->state != GAME_INPUT)
+		return FAILURE;
+
+	TIMER_cancel(game->wheel, &game->input_timer);
+	memcpy(game->guess, guess, game->settings.numbers * sizeof(int));
+	score_guess(game);
+
+	if (game->state == GAME_CONTINUE && game->round == game->settings.rounds)
+	{
+		game->state = GAME_OVER;  // Nobody will press the button to see the end
+		OUTPUT(game, game_over, game->round);
+	}
+
+	return SUCCESS;
+}
+
+void GAME_button(struct game *game, uint8_t level, uint64_t timestamp)
+{
+	switch (game->state)
+	{
+		case GAME_INPUT:
+			input_button(game, level, timestamp);
+			break;
+		case GAME_CONTINUE:
+			continue_button(game, level);
+			break;
+		default:
+			break;  // No input expected
+	}
+
+	game->pressed = level;
+}
+
+bool GAME_is_over(const struct game *game)
+{
+	return game->state == GAME_OVER;
+}
@@ -0,0 +1,127 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../score/score.h"
+#include "../timer/timer.h"
+#include "../matrix/matrix.h"
+#include "../arena/arena.h"
+
+/**
+ * Mastermind game engine.
+ * A game is a state machine driven by timestamped button events
+ * (GAME_button) and by its timer on a timer wheel. The engine never blocks
+ * or sleeps, everything it shows goes through the output callbacks, so one
+ * thread can run any number of games from a single event loop.
+ *
+ * GAME_SECRET -> GAME_INPUT (digit 0 .. numbers - 1) -> GAME_FEEDBACK
+ *     -> GAME_CONTINUE -> GAME_INPUT (next round) ...
+ *     -> GAME_OVER (correct guess, or the last round was played)
+*/
+
+// Time without a press after which the entered digit is accepted
+#define GAME_INPUT_TIMEOUT_MS 2000
+
+enum game_state
+{
+	GAME_SECRET,  // Waiting for the secret (GAME_start)
+	GAME_INPUT,  // Entering a digit - every press increments it, a timeout accepts it
+	GAME_FEEDBACK,  // The guess is complete and is being scored
+	GAME_CONTINUE,  // Wrong guess, waiting for a press to start the next round
+	GAME_OVER,
+};
+
+struct game_settings
+{
+	uint8_t numbers;  // Sequence length
+	uint8_t rounds;  // Number of rounds
+	uint8_t max;  // Maximum number (colours)
+	uint64_t input_timeout;  // ns, see GAME_INPUT_TIMEOUT_MS
+	const struct matrix *matrix;  // Precomputed scores, NULL or another code space - computed
+};
+
+/**
+ * Output of the game, every callback is optional (can be NULL).
+ * The callbacks are called from GAME_button, GAME_submit_guess and from
+ * TIMER_advance and must not block either.
+ * The first parameter is the context given to GAME_init.
+*/
+struct game_output
+{
+	void (*input)(void *context, uint8_t position);  // Waiting for the digit at position
+	void (*presses)(void *context, uint8_t position, uint8_t presses);  // Digit incremented
+	void (*digit)(void *context, uint8_t position, uint8_t value);  // Digit accepted
+	void (*guess)(void *context, const int *guess, uint8_t length);  // Guess complete
+	void (*feedback)(void *context, uint8_t exact, uint8_t approx);  // Wrong guess
+	void (*next_round)(void *context, uint8_t round);  // The player continued
+	void (*success)(void *context, uint8_t rounds);  // Correct guess in the given round
+	void (*game_over)(void *context, uint8_t rounds);  // All the rounds were played
+};
+
+struct game
+{
+	enum game_state state;
+	struct game_settings settings;
+	const struct game_output *output;
+	void *context;  // Passed to the output callbacks
+	struct timer_wheel *wheel;
+	struct timer input_timer;  // Accepts the digit
+	uint8_t round;  // Current round, from 1
+	uint8_t position;  // Digit being entered
+	uint8_t presses;  // Value of that digit, 0 - not pressed yet
+	bool pressed;  // The button is held down
+	int *secret;
+	int *guess;
+	score_kernel score;  // Kernel of the sequence length, see SCORE_kernel
+};
+
+// Arena memory of a game of the sequence length, see GAME_init
+#define GAME_ARENA_SIZE(numbers) (2 * ARENA_SIZE((size_t)(numbers) * sizeof(int)))
+
+/**
+ * Initialises the game in the GAME_SECRET state.
+ * The output can be shared by many games, context tells them apart.
+ * The timer of the game goes on the given wheel. The memory of the game
+ * (GAME_ARENA_SIZE) comes from the arena and stays in use until the arena
+ * is reset, so a session resets its arena before every new game.
+ * Returns 0 on success, -1 on failure (numbers, max or rounds is 0, or
+ * the arena is full).
+*/
+int GAME_init(struct game *game, const struct game_settings *settings,
+			  const struct game_output *output, void *context, struct timer_wheel *wheel,
+			  struct arena *arena);
+
+/**
+ * Cancels the timer of the game, its memory goes back with its arena
+*/
+void GAME_free(struct game *game);
+
+/**
+ * Sets the secret (settings.numbers numbers) and starts the first round
+*/
+void GAME_start(struct game *game, const int *secret);
+
+/**
+ * Handles a debounced button event.
+ * level - 1 pressed, 0 released
+ * timestamp - time (ns) of the event, on the clock of the wheel
+*/
+void GAME_button(struct game *game, uint8_t level, uint64_t timestamp);
+
+/**
+ * Plays a whole guess (settings.numbers numbers) at once, for players
+ * without a button. Any partly entered digits are dropped and after a wrong
+ * guess the next round is started without waiting for a press. A wrong guess
+ * in the last round ends the game.
+ * Returns 0 on success, -1 if the game does not take a guess now
+ * (GAME_SECRET or GAME_OVER).
+*/
+int GAME_submit_guess(struct game *game, const int *guess);
+
+/**
+ * Returns true once the game has finished
+*/
+bool GAME_is_over(const struct game *game);
+
+#endif
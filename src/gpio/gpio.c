@@ -1,169 +1,81 @@
 #include "gpio.h"
+#include "gpio_backend.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <unistd.h>
 #include <stdint.h>
 #include <time.h>
 #include "../timeunits.h"
-
-#define BCM2708_PERI_BASE 0x3F000000
-#define GPIO_BASE (BCM2708_PERI_BASE + 0x200000) /* GPIO controller */
-
-#define PAGE_SIZE (4*1024)
-#define BLOCK_SIZE (4*1024)
-
-#define SUCCESS 0
-#define FAILURE -1
+#include "../stats/stats.h"
 
 #define BTN_TIMEOUT_S 2  // seconds
-#define BTN_PROBE_TIME_MS 100
+#define BTN_PROBE_TIME_MS 100  // Pins 32-53 have no events and are polled
 #define BOUNCE_TIME_MS 30
 
+#if defined(__arm__) || defined(__aarch64__)
+#define DEFAULT_BACKEND (&GPIO_mmap_backend)
+#else
+#define DEFAULT_BACKEND (&GPIO_sim_backend)  // No BCM2708 peripherals on this host
+#endif
 
-static void *gpio_map;
 
-// I/O access
-static volatile unsigned int *gpio;
+static const struct gpio_backend *backend = DEFAULT_BACKEND;
 
-int GPIO_init(void)
+void GPIO_set_backend(enum gpio_backend_type type)
 {
-	int mem_fd;
-	if ((mem_fd = open("/dev/mem", O_RDWR | O_SYNC)) < 0)
-	{
-		perror("Can't open /dev/mem");
-		return FAILURE;
-	}
-
-	// mmap GPIO
-	gpio_map = mmap(
-		NULL,  // Any adddress in our space will do
-		BLOCK_SIZE,  // Map length
-		PROT_READ | PROT_WRITE,  // Enable reading & writting to the mapped memory
-		MAP_SHARED,  // Shared with other processes
-		mem_fd,  // File to map
-		GPIO_BASE  // Offset to GPIO peripheral
-	);
+	backend = type == GPIO_BACKEND_SIM ? &GPIO_sim_backend : &GPIO_mmap_backend;
+}
 
-	close(mem_fd);
+const struct gpio_backend *GPIO_get_backend(void)
+{
+	return backend;
+}
 
-	if (gpio_map == MAP_FAILED)
-	{
-		fprintf(stderr, "mmap error %d\n", (int)gpio_map);
-		return FAILURE;
-	}
+const char *GPIO_backend_name(void)
+{
+	return backend->name;
+}
 
-	gpio = (volatile unsigned int *)gpio_map;
-	return SUCCESS;
+int GPIO_init(void)
+{
+	return backend->init();
 }
 
 void GPIO_set_in(uint8_t pin)
 {
-	if (!gpio)
-	{
-		fprintf(stderr, "Error: Null GPIO pointer\n");
-		return;
-	}
+	backend->set_in(pin);
+}
 
-	asm volatile
-	(
-		/* Get the function select register address offset
-		 * by calculating the remainder of the pin number
-		 * when dividing by 10.
-		 * The division is done by repeated subtraction.
-		*/
+void GPIO_set_out(uint8_t pin)
+{
+	backend->set_out(pin);
+}
 
-		// Setup
-		"MOV R8, %[pin]\n"
-		"MOV R9, #0\n"  // Quotient
-		"MOV R10, R8\n"  // Remainder
-		"MOV R12, #10\n"  // Divisor
-		"B cond\n"  // Go to loop condition
-		// Division loop
-		"div:\n"
-		"SUBS R10, R10, R12\n" // remainder = remainder - divisor
-		"ADDPL R9, #1\n"  // If the result of the subtraction is not negative, add 1 to the quotient
-		"cond:\n"
-		"CMP R10, R12\n"  // Check if the remainder can be divided (i.e. >= 10)
-		"BHS div\n"  // If R10 >= 10, divide again.
+void GPIO_set_direction_mask(uint32_t out_mask, uint32_t in_mask)
+{
+	backend->set_direction_mask(out_mask, in_mask);
+}
 
-		// At this point R9 is the offset multiplier for the function register.
-		// Multiply by 4 to get the right offset
-		"MOV R12, #4\n"
-		"MOV R8, R9\n"
-		"MUL R9, R8, R12\n"
-		// Reset the 3 bits that belong to the pin function.
-		"MOV R14, %[gpio]\n"  // Get the base address of GPIO into R14
-		"LDR R4, [R14, R9]\n"  // Load contents of at GPIO+R9 (function select register)
-		"MOV R3, #3\n"  // Multiplier for the shift (number of bits per function select of a pin)
-		"MOV R5, #7\n"  // Reset bit mask
-		"MUL R6, R10, R3\n"  // Multiply reminder by 3 (R3) to get the correct shift multiplier
-		"LSL R5, R6\n"  // Shift the mask
-		"BIC R4, R4, R5\n"  // Clear the bits belonging to that pin
-		"STR R4, [R14, R9]\n"
-		:
-		:[pin]"r"(pin),
-		 [gpio]"r"(gpio)
-		:"memory"
-	);
+void GPIO_set_state(uint8_t pin, uint8_t state)
+{
+	STATS_COUNT(STATS_GPIO_WRITES, 1);
+	backend->set_state(pin, state);
 }
 
-void GPIO_set_out(uint8_t pin)
+void GPIO_write_mask(uint32_t set_mask, uint32_t clear_mask)
 {
-	if (!gpio)
-	{
-		fprintf(stderr,"Error: Null GPIO pointer\n");
-		return;
-	}
+	STATS_COUNT(STATS_GPIO_WRITES, 1);
+	backend->write_mask(set_mask, clear_mask);
+}
 
-	GPIO_set_in(pin);
-	asm volatile
-	(
-		"MOV R5, #1\n"  // 1 is output
-		"LSL R5, R6\n"  // Shift the output bit to the correct position of that pin
-		"ORR R4, R5\n"  // Set the pin as output
-		"STR R4, [R14, R9]\n"  // Store the new contents of the register
-		:
-		:[pin]"r"(pin),
-		 [gpio]"r"(gpio)
-		:"memory"
-	);
+uint32_t GPIO_read_levels(void)
+{
+	STATS_COUNT(STATS_GPIO_READS, 1);
+	return backend->read_levels();
 }
 
-void GPIO_set_state(uint8_t pin, uint8_t state)
+uint64_t GPIO_now(void)
 {
-	if (state)
-	{
-		asm volatile
-		(
-			"MOV R5, %[gpio]\n"  // Get the base address of GPIO
-			"LDR R6, [R5, #0x1C]\n"  // Get the contents of GPSET0 register (offset 0x1C or 28 dec.)
-			"MOV R7, #1\n"  // 1 for setting the state
-			"LSL R7, %[pin]\n"  // pin number == shift amount
-			"STR R7, [R5, #0x1C]\n"  // Store the new contents of the register
-			:
-			:[pin]"r"(pin),
-			 [gpio]"r"(gpio)
-			:"memory"
-		);
-	}
-	else
-	{
-		asm volatile
-		(
-			// Similar to when state > 0, except the register is GPCLR0 (offset 0x28 or 40 dec.)
-			"MOV R5, %[gpio]\n"
-			"LDR R6, [R5, #0x28]\n"
-			"MOV R7, #1\n"
-			"LSL R7, %[pin]\n"
-			"STR R7, [R5, #0x28]\n"
-			:
-			:[pin]"r"(pin),
-			 [gpio]"r"(gpio)
-			:"memory"
-		);
-	}
+	return backend->now();
 }
 
 /**
@@ -172,26 +84,15 @@ void GPIO_set_state(uint8_t pin, uint8_t state)
 */
 static uint8_t get_state(uint8_t pin)
 {
-	uint32_t state = 0;
-
-	asm volatile
-	(
-		"MOV R5, %[gpio]\n"  // Get the base address of GPIO
-		"LDR R6, [R5, #0x34]\n"  // Get the contents of GPLEV0 register
-		"MOV R7, %[pin]\n"  // Get the pin number, used for shifting
-		"MOV R8, #1\n"
-		"LSL R8, R7\n" // Shift the 1 to the right place
-		"AND %[state], R6, R8\n"
-		:[state]"=r"(state)
-		:[pin]"r"(pin),
-		 [gpio]"r"(gpio)
-	);
-
-	return state > 0;
+	STATS_COUNT(STATS_GPIO_READS, 1);
+	return backend->get_state(pin);
 }
 
 uint8_t GPIO_get_state(uint8_t pin)
 {
+	if (GPIO_sampler_has_levels() && pin < 32)
+		return (GPIO_get_levels() >> pin) & 1;  // Already debounced by the sampler
+
 	struct timespec delay =
 	{
 		.tv_sec = 0,
@@ -199,20 +100,58 @@ uint8_t GPIO_get_state(uint8_t pin)
 	};
 	if (get_state(pin))  // Check if the button is pressed
 	{
+		STATS_BEGIN(sleep_start);
 		nanosleep(&delay, NULL);  // Wait BOUNCE_TIME_MS and check again
+		STATS_END(STATS_SLEEP_NS, sleep_start);
 		if (get_state(pin))
 			return 1; // If it's still pressed (button state stabilized), return 1
 	}
 	return 0;
 }
 
-uint8_t GPIO_get_button_press(uint8_t pin)
+/**
+ * Polls the state of the pin every BTN_PROBE_TIME_MS until it is level.
+ * Returns false on timeout (negative - none).
+*/
+static bool poll_edge(uint8_t pin, uint8_t level, int32_t timeout_ms)
 {
-	while (GPIO_get_state(pin) == 0)
-		;  // Wait for the button to be pressed
-	while (GPIO_get_state(pin) != 0)
-		;  // Wait for the button to be released
+	struct timespec delay =
+	{
+		.tv_sec = 0,
+		.tv_nsec = MS_TO_NS(BTN_PROBE_TIME_MS),
+	};
+	for (int32_t waited = 0; GPIO_get_state(pin) != level; waited += BTN_PROBE_TIME_MS)
+	{
+		if (timeout_ms >= 0 && waited >= timeout_ms)
+			return false;
+		nanosleep(&delay, NULL);
+	}
+	return true;
+}
 
+/**
+ * Waits until the debounced level of the pin changes to level.
+ * Returns false on timeout (see GPIO_wait_event).
+*/
+static bool wait_edge(uint8_t pin, uint8_t level, int32_t timeout_ms)
+{
+	if (pin >= 32)
+		return poll_edge(pin, level, timeout_ms);  // The events (and GPIO_PIN_MASK) only cover pins 0-31
+
+	struct gpio_event event;
+	do
+	{
+		if (!GPIO_wait_event(GPIO_PIN_MASK(pin), timeout_ms, &event))
+			return false;
+	} while (event.level != level);
+
+	return true;
+}
+
+uint8_t GPIO_get_button_press(uint8_t pin)
+{
+	wait_edge(pin, 1, -1);  // Wait for the button to be pressed
+	wait_edge(pin, 0, -1);  // Wait for the button to be released
 	return 1;
 }
 
@@ -225,26 +164,10 @@ uint8_t GPIO_get_button_presses(uint8_t pin, uint8_t max, void (*click_handler)(
 	if (click_handler)
 		click_handler(presses);
 
-	uint32_t timeout = SEC_TO_NS(BTN_TIMEOUT_S);
-	uint32_t probe_time = MS_TO_NS(BTN_PROBE_TIME_MS);
-
-	struct timespec delay =
-	{
-		.tv_sec = 0,
-		.tv_nsec = probe_time,
-	};
-
-	for (uint32_t i = 0; i < timeout; i += probe_time)
+	// The timeout restarts after every release
+	while (wait_edge(pin, 1, SEC_TO_MS(BTN_TIMEOUT_S)))
 	{
-		if (GPIO_get_state(pin) == 0)
-		{
-			nanosleep(&delay, NULL);
-			delay.tv_nsec = probe_time;
-			continue;
-		}
-
 		// Button has been pressed
-		i = 0;  // Reset the timeout counter
 		presses++;
 		if (presses > max)  // wrap around
 			presses = 1;
@@ -253,9 +176,7 @@ uint8_t GPIO_get_button_presses(uint8_t pin, uint8_t max, void (*click_handler)(
 			click_handler(presses);
 
 		// Wait for the button to be released
-		while (GPIO_get_state(pin) != 0)
-			;
-
+		wait_edge(pin, 0, -1);
 	}
 	return presses;
 }
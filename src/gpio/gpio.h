@@ -2,6 +2,30 @@
 #define GPIO_H
 
 #include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * GPIO backends
+ * GPIO_BACKEND_MMAP - BCM2708 registers memory-mapped from /dev/mem (Raspberry Pi)
+ * GPIO_BACKEND_SIM - simulated register file in memory, see gpio_sim.h
+*/
+enum gpio_backend_type
+{
+	GPIO_BACKEND_MMAP,
+	GPIO_BACKEND_SIM,
+};
+
+/**
+ * Selects the backend used by all of the GPIO functions.
+ * Has to be called before GPIO_init(). The default is the memory-mapped
+ * backend on ARM and the simulated backend on any other architecture.
+*/
+void GPIO_set_backend(enum gpio_backend_type type);
+
+/**
+ * Returns the name of the selected backend ("mmap" or "sim")
+*/
+const char *GPIO_backend_name(void);
 
 /**
  * Initialises the GPIO module.
@@ -19,21 +43,115 @@ void GPIO_set_in(uint8_t pin);
 */
 void GPIO_set_out(uint8_t pin);
 
+/**
+ * Sets all pins in out_mask as outputs and all pins in in_mask as inputs.
+ * Costs one read-modify-write of every function select register (10 pins
+ * each) with one of the pins, instead of one or two per pin.
+ * Only pins 0-31, see GPIO_PIN_MASK.
+*/
+void GPIO_set_direction_mask(uint32_t out_mask, uint32_t in_mask);
+
 /**
  * Changes the state of the pin
  * 0 - low, 1 - high
 */
 void GPIO_set_state(uint8_t pin, uint8_t state);
 
+/**
+ * Bit of the pin in the masks of GPIO_write_mask (pins 0-31 only)
+*/
+#define GPIO_PIN_MASK(pin) (1u << (pin))
+
+/**
+ * Drives all pins in set_mask high and all pins in clear_mask low.
+ * Costs at most one GPSET0 and one GPCLR0 store, a zero mask is skipped.
+ * Only pins 0-31 (bank 0) can be written this way.
+*/
+void GPIO_write_mask(uint32_t set_mask, uint32_t clear_mask);
+
+/**
+ * Returns the raw (not debounced) levels of pins 0-31 with one GPLEV0 load
+*/
+uint32_t GPIO_read_levels(void);
+
+/**
+ * Returns the current time (ns) of the clock used for the event timestamps.
+ * On the simulated backend this is the virtual clock.
+*/
+uint64_t GPIO_now(void);
+
 /**
  * Returns the state of the pin (with debouncing)
  * 0 - low, 1 - high
 */
 uint8_t GPIO_get_state(uint8_t pin);
 
+/**
+ * Debounced change of the level of an input pin
+*/
+struct gpio_event
+{
+	uint64_t timestamp;  // Time (ns) of the first sample with the new level
+	uint8_t pin;
+	uint8_t level;  // 1 - rising edge (press), 0 - falling edge (release)
+};
+
+// Default sampling period of the input sampler
+#define GPIO_SAMPLE_PERIOD_US 5000
+// Number of consecutive samples a new level has to be seen for to be accepted
+#define GPIO_DEBOUNCE_SAMPLES 4
+
+/**
+ * Starts a thread which samples GPLEV0 (all of pins 0-31 with one load)
+ * every period_us microseconds and debounces every pin.
+ * While the sampler runs GPIO_get_state() returns the debounced level
+ * of pins 0-31 without waiting.
+ * Returns 0 on success, -1 on failure.
+*/
+int GPIO_sampler_start(uint32_t period_us);
+
+/**
+ * Stops the sampler thread
+*/
+void GPIO_sampler_stop(void);
+
+/**
+ * Takes one sample and updates the debounced levels and events.
+ * Called by the sampler thread - can also be called directly (for example
+ * with the manual clock of the simulator) when the thread is not running.
+*/
+void GPIO_sampler_tick(void);
+
+/**
+ * Returns true once the sampler has taken the first sample
+*/
+bool GPIO_sampler_has_levels(void);
+
+/**
+ * Returns the debounced levels of pins 0-31, one bit per pin
+*/
+uint32_t GPIO_get_levels(void);
+
+/**
+ * Takes the oldest debounced event out of the queue.
+ * Returns false if there is no event.
+*/
+bool GPIO_poll_event(struct gpio_event *event);
+
+/**
+ * Blocks (without using the CPU) until a debounced event of one of the pins
+ * in pin_mask arrives, events of the other pins are dropped.
+ * Starts the sampler if it is not running yet.
+ * timeout_ms - maximum time to wait, -1 waits forever, 0 does not wait at all
+ * Returns false if no event arrived before the timeout.
+*/
+bool GPIO_wait_event(uint32_t pin_mask, int32_t timeout_ms, struct gpio_event *event);
+
 /**
  * Waits for a press of the button (high level of the pin).
  * Returns 1 after the button is released (low level).
+ * The wait is event driven (see GPIO_wait_event) for pins 0-31, the
+ * other pins are polled.
 */
 uint8_t GPIO_get_button_press(uint8_t pin);
 
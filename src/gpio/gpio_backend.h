@@ -0,0 +1,72 @@
+#ifndef GPIO_BACKEND_H
+#define GPIO_BACKEND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Interface implemented by every GPIO backend.
+ * The functions in gpio.c only talk to the hardware (or the simulator)
+ * through one of these structures.
+*/
+
+// BCM2835 register offsets (in bytes) from the GPIO base address
+#define GPIO_GPFSEL0 0x00
+#define GPIO_GPSET0 0x1C
+#define GPIO_GPCLR0 0x28
+#define GPIO_GPLEV0 0x34
+
+// Function select registers with pins 0-31 (GPFSEL0-3, 10 pins each)
+#define GPIO_FSEL_REGISTERS 4
+
+/**
+ * Bits of function select register fsel to clear (every pin of either mask)
+ * and to set afterwards (the output pins) for GPIO_set_direction_mask.
+ * Returns false if the register has none of the pins.
+*/
+static inline bool GPIO_fsel_masks(uint8_t fsel, uint32_t out_mask, uint32_t in_mask, uint32_t *clear,
+								   uint32_t *set)
+{
+	*clear = 0;
+	*set = 0;
+	for (uint8_t i = 0; i < 10 && fsel * 10 + i < 32; i++)
+	{
+		uint32_t pin = 1u << (fsel * 10 + i);
+		if ((out_mask | in_mask) & pin)
+			*clear |= 7u << (i * 3);
+		if (out_mask & pin)
+			*set |= 1u << (i * 3);
+	}
+	return *clear != 0;
+}
+
+struct gpio_backend
+{
+	const char *name;
+	int (*init)(void);  // Returns 0 on success, -1 on failure
+	void (*set_in)(uint8_t pin);
+	void (*set_out)(uint8_t pin);
+	void (*set_direction_mask)(uint32_t out_mask, uint32_t in_mask);  // Pins 0-31
+	void (*set_state)(uint8_t pin, uint8_t state);
+	void (*write_mask)(uint32_t set_mask, uint32_t clear_mask);
+	uint8_t (*get_state)(uint8_t pin);  // Raw (not debounced) level of the pin
+	uint32_t (*read_levels)(void);  // Raw levels of pins 0-31 (one GPLEV0 load)
+	uint64_t (*now)(void);  // Timestamp in nanoseconds for the input events
+};
+
+/**
+ * Returns the backend selected with GPIO_set_backend()
+*/
+const struct gpio_backend *GPIO_get_backend(void);
+
+/**
+ * Memory-mapped BCM2708 registers (/dev/mem), see gpio_mmap.c
+*/
+extern const struct gpio_backend GPIO_mmap_backend;
+
+/**
+ * Simulated in-memory register file, see gpio_sim.c
+*/
+extern const struct gpio_backend GPIO_sim_backend;
+
+#endif
@@ -0,0 +1,354 @@
+#include "gpio_backend.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+
+#define BCM2708_PERI_BASE 0x3F000000
+#define GPIO_BASE (BCM2708_PERI_BASE + 0x200000) /* GPIO controller */
+
+#define PAGE_SIZE (4*1024)
+#define BLOCK_SIZE (4*1024)
+
+#define SUCCESS 0
+#define FAILURE -1
+
+
+static void *gpio_map;
+
+// I/O access
+static volatile unsigned int *gpio;
+
+static int mmap_init(void)
+{
+	int mem_fd;
+	if ((mem_fd = open("/dev/mem", O_RDWR | O_SYNC)) < 0)
+	{
+		perror("Can't open /dev/mem");
+		return FAILURE;
+	}
+
+	// mmap GPIO
+	gpio_map = mmap(
+		NULL,  // Any adddress in our space will do
+		BLOCK_SIZE,  // Map length
+		PROT_READ | PROT_WRITE,  // Enable reading & writting to the mapped memory
+		MAP_SHARED,  // Shared with other processes
+		mem_fd,  // File to map
+		GPIO_BASE  // Offset to GPIO peripheral
+	);
+
+	close(mem_fd);
+
+	if (gpio_map == MAP_FAILED)
+	{
+		perror("mmap error");
+		return FAILURE;
+	}
+
+	gpio = (volatile unsigned int *)gpio_map;
+	return SUCCESS;
+}
+
+#if defined(__arm__)
+
+/*
+ * The assembly below only uses registers given to it as operands, so it
+ * is safe at any optimisation level: the compiler knows which registers
+ * it changes and no value is carried over between two asm statements.
+*/
+
+/**
+ * Sets the 3 function select bits of the pin to function (0 - input, 1 - output)
+*/
+static void mmap_set_function(uint8_t pin, uint32_t function)
+{
+	uint32_t quotient;
+	uint32_t remainder;
+	uint32_t divisor;
+	uint32_t contents;
+	uint32_t mask;
+
+	asm volatile
+	(
+		/* Get the function select register address offset
+		 * by calculating the remainder of the pin number
+		 * when dividing by 10.
+		 * The division is done by repeated subtraction.
+		*/
+
+		// Setup
+		"MOV %[quotient], #0\n"
+		"MOV %[remainder], %[pin]\n"
+		"MOV %[divisor], #10\n"
+		"B 2f\n"  // Go to loop condition
+		// Division loop
+		"1:\n"
+		"SUBS %[remainder], %[remainder], %[divisor]\n"  // remainder = remainder - divisor
+		"ADDPL %[quotient], %[quotient], #1\n"  // If the result of the subtraction is not negative, add 1 to the quotient
+		"2:\n"
+		"CMP %[remainder], %[divisor]\n"  // Check if the remainder can be divided (i.e. >= 10)
+		"BHS 1b\n"  // If remainder >= 10, divide again.
+
+		// At this point the quotient is the offset multiplier for the function register.
+		// Multiply by 4 to get the right offset
+		"LSL %[quotient], %[quotient], #2\n"
+		// Reset the 3 bits that belong to the pin function.
+		"LDR %[contents], [%[gpio], %[quotient]]\n"  // Load the function select register
+		"ADD %[remainder], %[remainder], %[remainder], LSL #1\n"  // Multiply the remainder by 3 to get the shift
+		"MOV %[mask], #7\n"  // Reset bit mask
+		"LSL %[mask], %[mask], %[remainder]\n"  // Shift the mask
+		"BIC %[contents], %[contents], %[mask]\n"  // Clear the bits belonging to that pin
+		"LSL %[mask], %[function], %[remainder]\n"  // Shift the function to the correct position of that pin
+		"ORR %[contents], %[contents], %[mask]\n"  // Set the pin function
+		"STR %[contents], [%[gpio], %[quotient]]\n"  // Store the new contents of the register
+		:[quotient]"=&r"(quotient),
+		 [remainder]"=&r"(remainder),
+		 [divisor]"=&r"(divisor),
+		 [contents]"=&r"(contents),
+		 [mask]"=&r"(mask)
+		:[pin]"r"((uint32_t)pin),
+		 [function]"r"(function),
+		 [gpio]"r"(gpio)
+		:"cc", "memory"
+	);
+}
+
+static void mmap_set_in(uint8_t pin)
+{
+	if (!gpio)
+	{
+		fprintf(stderr, "Error: Null GPIO pointer\n");
+		return;
+	}
+
+	mmap_set_function(pin, 0);  // 0 is input
+}
+
+static void mmap_set_out(uint8_t pin)
+{
+	if (!gpio)
+	{
+		fprintf(stderr,"Error: Null GPIO pointer\n");
+		return;
+	}
+
+	mmap_set_function(pin, 1);  // 1 is output
+}
+
+static void mmap_set_direction_mask(uint32_t out_mask, uint32_t in_mask)
+{
+	if (!gpio)
+	{
+		fprintf(stderr, "Error: Null GPIO pointer\n");
+		return;
+	}
+
+	for (uint8_t fsel = 0; fsel < GPIO_FSEL_REGISTERS; fsel++)
+	{
+		uint32_t clear;
+		uint32_t set;
+		uint32_t contents;
+		if (!GPIO_fsel_masks(fsel, out_mask, in_mask, &clear, &set))
+			continue;
+
+		asm volatile
+		(
+			"LDR %[contents], [%[gpio], %[offset]]\n"  // Load the function select register
+			"BIC %[contents], %[contents], %[clear]\n"  // Clear the bits of every pin
+			"ORR %[contents], %[contents], %[set]\n"  // Set the outputs
+			"STR %[contents], [%[gpio], %[offset]]\n"  // Store the new contents of the register
+			:[contents]"=&r"(contents)
+			:[offset]"r"((uint32_t)fsel * 4),
+			 [clear]"r"(clear),
+			 [set]"r"(set),
+			 [gpio]"r"(gpio)
+			:"memory"
+		);
+	}
+}
+
+static void mmap_set_state(uint8_t pin, uint8_t state)
+{
+	uint32_t mask;
+
+	if (state)
+	{
+		asm volatile
+		(
+			"MOV %[mask], #1\n"  // 1 for setting the state
+			"LSL %[mask], %[mask], %[pin]\n"  // pin number == shift amount
+			"STR %[mask], [%[gpio], #0x1C]\n"  // Store it in GPSET0 (offset 0x1C or 28 dec.)
+			:[mask]"=&r"(mask)
+			:[pin]"r"((uint32_t)pin),
+			 [gpio]"r"(gpio)
+			:"memory"
+		);
+	}
+	else
+	{
+		asm volatile
+		(
+			// Similar to when state > 0, except the register is GPCLR0 (offset 0x28 or 40 dec.)
+			"MOV %[mask], #1\n"
+			"LSL %[mask], %[mask], %[pin]\n"
+			"STR %[mask], [%[gpio], #0x28]\n"
+			:[mask]"=&r"(mask)
+			:[pin]"r"((uint32_t)pin),
+			 [gpio]"r"(gpio)
+			:"memory"
+		);
+	}
+}
+
+static void mmap_write_mask(uint32_t set_mask, uint32_t clear_mask)
+{
+	asm volatile
+	(
+		// No loads are needed - writing 0 to a GPSET0/GPCLR0 bit has no effect
+		"CMP %[clear], #0\n"
+		"STRNE %[clear], [%[gpio], #0x28]\n"  // Clear all pins in the mask at once (GPCLR0)
+		"CMP %[set], #0\n"
+		"STRNE %[set], [%[gpio], #0x1C]\n"  // Set all pins in the mask at once (GPSET0)
+		:
+		:[set]"r"(set_mask),
+		 [clear]"r"(clear_mask),
+		 [gpio]"r"(gpio)
+		:"cc", "memory"
+	);
+}
+
+/**
+ * Returns the state of pin
+ * 0 - low, 1 - high
+*/
+static uint8_t mmap_get_state(uint8_t pin)
+{
+	uint32_t state = 0;
+
+	asm volatile
+	(
+		"LDR %[state], [%[gpio], #0x34]\n"  // Get the contents of GPLEV0 register
+		"LSR %[state], %[state], %[pin]\n"  // Shift the pin to bit 0
+		"AND %[state], %[state], #1\n"
+		:[state]"=&r"(state)
+		:[pin]"r"((uint32_t)pin),
+		 [gpio]"r"(gpio)
+		:"memory"
+	);
+
+	return state > 0;
+}
+
+static uint32_t mmap_read_levels(void)
+{
+	uint32_t levels;
+
+	asm volatile
+	(
+		"LDR %[levels], [%[gpio], #0x34]\n"  // Get the contents of GPLEV0 register
+		:[levels]"=r"(levels)
+		:[gpio]"r"(gpio)
+		:"memory"
+	);
+
+	return levels;
+}
+
+#else
+
+/*
+ * Portable C accessors, used when the inline assembly above cannot be assembled
+ * (for example a 64-bit kernel on the Raspberry Pi).
+*/
+
+static void mmap_set_in(uint8_t pin)
+{
+	if (!gpio)
+	{
+		fprintf(stderr, "Error: Null GPIO pointer\n");
+		return;
+	}
+
+	volatile unsigned int *fsel = gpio + (GPIO_GPFSEL0 / 4) + pin / 10;
+	*fsel &= ~(7u << ((pin % 10) * 3));
+}
+
+static void mmap_set_out(uint8_t pin)
+{
+	if (!gpio)
+	{
+		fprintf(stderr, "Error: Null GPIO pointer\n");
+		return;
+	}
+
+	mmap_set_in(pin);
+	volatile unsigned int *fsel = gpio + (GPIO_GPFSEL0 / 4) + pin / 10;
+	*fsel |= 1u << ((pin % 10) * 3);
+}
+
+static void mmap_set_direction_mask(uint32_t out_mask, uint32_t in_mask)
+{
+	if (!gpio)
+	{
+		fprintf(stderr, "Error: Null GPIO pointer\n");
+		return;
+	}
+
+	for (uint8_t fsel = 0; fsel < GPIO_FSEL_REGISTERS; fsel++)
+	{
+		uint32_t clear;
+		uint32_t set;
+		if (GPIO_fsel_masks(fsel, out_mask, in_mask, &clear, &set))
+			gpio[GPIO_GPFSEL0 / 4 + fsel] = (gpio[GPIO_GPFSEL0 / 4 + fsel] & ~clear) | set;
+	}
+}
+
+static void mmap_set_state(uint8_t pin, uint8_t state)
+{
+	gpio[(state ? GPIO_GPSET0 : GPIO_GPCLR0) / 4] = 1u << pin;
+}
+
+static void mmap_write_mask(uint32_t set_mask, uint32_t clear_mask)
+{
+	if (clear_mask)
+		gpio[GPIO_GPCLR0 / 4] = clear_mask;
+	if (set_mask)
+		gpio[GPIO_GPSET0 / 4] = set_mask;
+}
+
+static uint8_t mmap_get_state(uint8_t pin)
+{
+	return (gpio[GPIO_GPLEV0 / 4] >> pin) & 1;
+}
+
+static uint32_t mmap_read_levels(void)
+{
+	return gpio[GPIO_GPLEV0 / 4];
+}
+
+#endif
+
+static uint64_t mmap_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+const struct gpio_backend GPIO_mmap_backend =
+{
+	.name = "mmap",
+	.init = mmap_init,
+	.set_in = mmap_set_in,
+	.set_out = mmap_set_out,
+	.set_direction_mask = mmap_set_direction_mask,
+	.set_state = mmap_set_state,
+	.write_mask = mmap_write_mask,
+	.get_state = mmap_get_state,
+	.read_levels = mmap_read_levels,
+	.now = mmap_now,
+};
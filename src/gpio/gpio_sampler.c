@@ -0,0 +1,244 @@
+#include "gpio.h"
+#include "gpio_backend.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include "../timeunits.h"
+#include "../stats/stats.h"
+
+#define SUCCESS 0
+#define FAILURE -1
+
+// Size of the event queue (power of 2), the oldest events are dropped when it is full
+#define EVENT_QUEUE_SIZE 64
+
+static uint64_t sample_period = US_TO_NS((uint64_t)GPIO_SAMPLE_PERIOD_US);
+
+/*
+ * Debouncer state for all 32 pins - a 2 bit vertical counter.
+ * Bit n of count0/count1 is the counter of pin n. The counter is reset
+ * whenever the sample equals the debounced level and the level toggles
+ * after GPIO_DEBOUNCE_SAMPLES consecutive different samples.
+*/
+static uint32_t count0;
+static uint32_t count1;
+static _Atomic uint32_t levels;
+static atomic_bool has_levels;
+
+static struct gpio_event events[EVENT_QUEUE_SIZE];
+static size_t events_head;  // Next event to be taken
+static size_t events_length;
+static pthread_mutex_t events_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t events_cond;  // Signalled on every new event, uses CLOCK_MONOTONIC
+static pthread_once_t events_cond_once = PTHREAD_ONCE_INIT;
+
+static pthread_t thread;
+static atomic_bool running;
+
+static void init_events_cond(void)
+{
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&events_cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+/**
+ * Adds an event to the queue, drops the oldest one if the queue is full
+*/
+static void push_event(uint64_t timestamp, uint8_t pin, uint8_t level)
+{
+	STATS_COUNT(STATS_GPIO_EVENTS, 1);
+	STATS_RECORD(STATS_DEBOUNCE_NS, GPIO_get_backend()->now() - timestamp);
+	pthread_once(&events_cond_once, init_events_cond);
+	pthread_mutex_lock(&events_lock);
+	if (events_length == EVENT_QUEUE_SIZE)
+	{
+		events_head = (events_head + 1) % EVENT_QUEUE_SIZE;
+		events_length--;
+	}
+	events[(events_head + events_length) % EVENT_QUEUE_SIZE] = (struct gpio_event)
+	{
+		.timestamp = timestamp,
+		.pin = pin,
+		.level = level,
+	};
+	events_length++;
+	pthread_cond_broadcast(&events_cond);
+	pthread_mutex_unlock(&events_lock);
+}
+
+void GPIO_sampler_tick(void)
+{
+	const struct gpio_backend *backend = GPIO_get_backend();
+	uint32_t sample = backend->read_levels();
+	uint64_t now = backend->now();
+
+	if (!atomic_load(&has_levels))
+	{
+		// The first sample is taken as stable
+		atomic_store(&levels, sample);
+		atomic_store(&has_levels, true);
+		return;
+	}
+
+	uint32_t state = atomic_load(&levels);
+	uint32_t delta = sample ^ state;  // Pins which differ from the debounced level
+
+	// Count down the pins in delta (3, 2, 1, 0), reset the other ones
+	count1 = (count1 ^ count0) & delta;
+	count0 = ~count0 & delta;
+	uint32_t toggle = delta & ~(count0 | count1);
+
+	if (!toggle)
+		return;
+
+	state ^= toggle;
+	atomic_store(&levels, state);
+
+	// The new level was first seen GPIO_DEBOUNCE_SAMPLES - 1 periods ago
+	uint64_t window = (GPIO_DEBOUNCE_SAMPLES - 1) * sample_period;
+	uint64_t timestamp = now > window ? now - window : 0;
+	for (uint8_t pin = 0; pin < 32; pin++)
+	{
+		if (toggle & GPIO_PIN_MASK(pin))
+			push_event(timestamp, pin, (state >> pin) & 1);
+	}
+}
+
+bool GPIO_sampler_has_levels(void)
+{
+	return atomic_load(&has_levels);
+}
+
+uint32_t GPIO_get_levels(void)
+{
+	return atomic_load(&levels);
+}
+
+/**
+ * Takes the oldest event of one of the pins in pin_mask out of the queue.
+ * Events of the other pins are dropped. Has to be called with events_lock held.
+ * Returns false if there is no such event.
+*/
+static bool pop_event(uint32_t pin_mask, struct gpio_event *event)
+{
+	while (events_length)
+	{
+		struct gpio_event oldest = events[events_head];
+		events_head = (events_head + 1) % EVENT_QUEUE_SIZE;
+		events_length--;
+
+		if (pin_mask & GPIO_PIN_MASK(oldest.pin))
+		{
+			*event = oldest;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool GPIO_poll_event(struct gpio_event *event)
+{
+	pthread_mutex_lock(&events_lock);
+	bool found = pop_event(UINT32_MAX, event);
+	pthread_mutex_unlock(&events_lock);
+
+	return found;
+}
+
+bool GPIO_wait_event(uint32_t pin_mask, int32_t timeout_ms, struct gpio_event *event)
+{
+	if (GPIO_sampler_start(GPIO_SAMPLE_PERIOD_US) != SUCCESS)
+		return false;
+	pthread_once(&events_cond_once, init_events_cond);
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	if (timeout_ms > 0)
+	{
+		deadline.tv_sec += timeout_ms / 1000;
+		deadline.tv_nsec += MS_TO_NS((long)(timeout_ms % 1000));
+		if (deadline.tv_nsec >= SEC_TO_NS(1))
+		{
+			deadline.tv_nsec -= SEC_TO_NS(1);
+			deadline.tv_sec++;
+		}
+	}
+
+	STATS_BEGIN(wait_start);
+	pthread_mutex_lock(&events_lock);
+	bool found = pop_event(pin_mask, event);
+	while (!found && timeout_ms != 0)
+	{
+		// Sleep until the sampler queues a new event (or the timeout expires)
+		int result = timeout_ms < 0
+			? pthread_cond_wait(&events_cond, &events_lock)
+			: pthread_cond_timedwait(&events_cond, &events_lock, &deadline);
+
+		found = pop_event(pin_mask, event);
+		if (result == ETIMEDOUT)
+			break;
+	}
+	pthread_mutex_unlock(&events_lock);
+	STATS_END(STATS_WAIT_EVENT_NS, wait_start);
+
+	return found;
+}
+
+/**
+ * Sampler thread - takes a sample at fixed (absolute) intervals
+*/
+static void *sample_loop(void *arg)
+{
+	(void)arg;
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	while (atomic_load(&running))
+	{
+		GPIO_sampler_tick();
+
+		next.tv_nsec += sample_period;
+		while (next.tv_nsec >= SEC_TO_NS(1))
+		{
+			next.tv_nsec -= SEC_TO_NS(1);
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	}
+
+	return NULL;
+}
+
+int GPIO_sampler_start(uint32_t period_us)
+{
+	if (atomic_load(&running))
+		return SUCCESS;
+
+	sample_period = US_TO_NS((uint64_t)period_us);
+	atomic_store(&running, true);
+	if (pthread_create(&thread, NULL, sample_loop, NULL) != 0)
+	{
+		atomic_store(&running, false);
+		perror("Unable to start the input sampler");
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+void GPIO_sampler_stop(void)
+{
+	if (!atomic_load(&running))
+		return;
+
+	atomic_store(&running, false);
+	pthread_join(thread, NULL);
+}
@@ -0,0 +1,430 @@
+#include "gpio_sim.h"
+#include "gpio_backend.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define SUCCESS 0
+#define FAILURE -1
+
+#define PINS 54
+#define GPIO_GPSET1 0x20
+#define GPIO_GPCLR1 0x2C
+#define GPIO_GPLEV1 0x38
+// Size of the register block (up to GPPUDCLK1)
+#define REGISTER_WORDS (0xA0 / 4 + 1)
+
+#define SCRIPT_INITIAL_CAPACITY 64
+
+/**
+ * Scripted change of an input level
+*/
+struct input_change
+{
+	uint64_t time;
+	uint8_t pin;
+	uint8_t level;
+};
+
+static uint32_t registers[REGISTER_WORDS];
+static uint64_t output_latch;  // Levels driven by the program (GPSET/GPCLR)
+static uint64_t input_levels;  // Levels driven from the outside (scripted)
+
+static struct input_change *script;
+static size_t script_length;
+static size_t script_capacity;
+static size_t script_next;  // First change that has not been applied yet
+
+static bool manual_clock;
+static uint64_t manual_time;
+static bool clock_started;
+static struct timespec start_time;
+
+static struct gpio_sim_counters counters;
+static uint64_t access_time;  // Manual clock advance per bus transaction
+static void (*output_hook)(uint64_t levels);
+
+// The simulator can be used from several threads (for example the input sampler)
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+static uint64_t now_unlocked(void)
+{
+	if (manual_clock)
+		return manual_time;
+
+	if (!clock_started)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start_time);
+		clock_started = true;
+	}
+
+	return monotonic_ns() - ((uint64_t)start_time.tv_sec * 1000000000u + start_time.tv_nsec);
+}
+
+uint64_t GPIO_sim_now(void)
+{
+	pthread_mutex_lock(&lock);
+	uint64_t now = now_unlocked();
+	pthread_mutex_unlock(&lock);
+	return now;
+}
+
+/**
+ * Applies all of the scripted input changes that are due
+*/
+static void apply_script(void)
+{
+	uint64_t now = now_unlocked();
+
+	for (; script_next < script_length && script[script_next].time <= now; script_next++)
+	{
+		uint64_t bit = (uint64_t)1 << script[script_next].pin;
+		if (script[script_next].level)
+			input_levels |= bit;
+		else
+			input_levels &= ~bit;
+	}
+}
+
+static bool is_output(uint8_t pin)
+{
+	if (pin >= PINS)
+		return false;
+
+	uint32_t function = (registers[GPIO_GPFSEL0 / 4 + pin / 10] >> ((pin % 10) * 3)) & 7;
+	return function == 1;
+}
+
+bool GPIO_sim_is_output(uint8_t pin)
+{
+	pthread_mutex_lock(&lock);
+	bool output = is_output(pin);
+	pthread_mutex_unlock(&lock);
+	return output;
+}
+
+/**
+ * Returns the levels of all pins - outputs read back their latch, inputs the scripted level
+*/
+static uint64_t pin_levels(void)
+{
+	uint64_t outputs = 0;
+	for (uint8_t pin = 0; pin < PINS; pin++)
+	{
+		if (is_output(pin))
+			outputs |= (uint64_t)1 << pin;
+	}
+
+	return (output_latch & outputs) | (input_levels & ~outputs);
+}
+
+static uint32_t read_register(uint32_t offset)
+{
+	if (offset / 4 >= REGISTER_WORDS)
+		return 0;
+
+	switch (offset)
+	{
+	case GPIO_GPSET0:
+	case GPIO_GPSET1:
+	case GPIO_GPCLR0:
+	case GPIO_GPCLR1:
+		return 0;  // Write-only
+	case GPIO_GPLEV0:
+		apply_script();
+		return (uint32_t)pin_levels();
+	case GPIO_GPLEV1:
+		apply_script();
+		return (uint32_t)(pin_levels() >> 32);
+	default:
+		return registers[offset / 4];
+	}
+}
+
+uint32_t GPIO_sim_read_register(uint32_t offset)
+{
+	pthread_mutex_lock(&lock);
+	uint32_t value = read_register(offset);
+	pthread_mutex_unlock(&lock);
+	return value;
+}
+
+/**
+ * Bus read of a register
+*/
+static uint32_t sim_read(uint32_t offset)
+{
+	pthread_mutex_lock(&lock);
+	counters.reads++;
+	if (manual_clock)
+		manual_time += access_time;
+	uint32_t value = read_register(offset);
+	pthread_mutex_unlock(&lock);
+	return value;
+}
+
+/**
+ * Bus write to a register
+*/
+static void sim_write(uint32_t offset, uint32_t value)
+{
+	pthread_mutex_lock(&lock);
+	counters.writes++;
+	if (manual_clock)
+		manual_time += access_time;
+
+	bool outputs_changed = false;
+	switch (offset)
+	{
+	case GPIO_GPSET0:
+		output_latch |= value;
+		outputs_changed = true;
+		break;
+	case GPIO_GPSET1:
+		output_latch |= (uint64_t)value << 32;
+		outputs_changed = true;
+		break;
+	case GPIO_GPCLR0:
+		output_latch &= ~(uint64_t)value;
+		outputs_changed = true;
+		break;
+	case GPIO_GPCLR1:
+		output_latch &= ~((uint64_t)value << 32);
+		outputs_changed = true;
+		break;
+	case GPIO_GPLEV0:
+	case GPIO_GPLEV1:
+		break;  // Read-only
+	default:
+		if (offset / 4 < REGISTER_WORDS)
+			registers[offset / 4] = value;
+	}
+	uint64_t levels = output_latch;
+	void (*hook)(uint64_t levels) = output_hook;
+	pthread_mutex_unlock(&lock);
+
+	// Called without the lock, the hook may use the other GPIO_sim functions
+	if (outputs_changed && hook)
+		hook(levels);
+}
+
+/**
+ * Clears the registers and the output latch
+*/
+static void clear_registers(void)
+{
+	memset(registers, 0, sizeof(registers));
+	output_latch = 0;
+}
+
+void GPIO_sim_reset(void)
+{
+	pthread_mutex_lock(&lock);
+	clear_registers();
+	input_levels = 0;
+	script_length = 0;
+	script_next = 0;
+	manual_time = 0;
+	memset(&counters, 0, sizeof(counters));
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+	clock_started = true;
+	pthread_mutex_unlock(&lock);
+}
+
+void GPIO_sim_use_manual_clock(bool manual)
+{
+	pthread_mutex_lock(&lock);
+	if (manual && !manual_clock)
+		manual_time = now_unlocked();  // Continue from the current time
+	else if (!manual && manual_clock)
+	{
+		// Move the start time so that the clock continues from the manual time
+		uint64_t start = monotonic_ns() - manual_time;
+		start_time.tv_sec = start / 1000000000u;
+		start_time.tv_nsec = start % 1000000000u;
+		clock_started = true;
+	}
+
+	manual_clock = manual;
+	pthread_mutex_unlock(&lock);
+}
+
+void GPIO_sim_advance(uint64_t ns)
+{
+	pthread_mutex_lock(&lock);
+	if (manual_clock)
+		manual_time += ns;
+	pthread_mutex_unlock(&lock);
+}
+
+int GPIO_sim_script_input(uint8_t pin, uint64_t at_ns, uint8_t level)
+{
+	if (pin >= PINS)
+	{
+		fprintf(stderr, "Error: Pin %hhu does not exist\n", pin);
+		return FAILURE;
+	}
+
+	pthread_mutex_lock(&lock);
+	if (script_length == script_capacity)
+	{
+		size_t capacity = script_capacity ? script_capacity * 2 : SCRIPT_INITIAL_CAPACITY;
+		struct input_change *resized = realloc(script, capacity * sizeof(*script));
+		if (!resized)
+		{
+			pthread_mutex_unlock(&lock);
+			perror("Unable to allocate memory for the input script");
+			return FAILURE;
+		}
+		script = resized;
+		script_capacity = capacity;
+	}
+
+	// Keep the script sorted by time (changes at the same time keep their order)
+	size_t i = script_length;
+	while (i > script_next && script[i - 1].time > at_ns)
+	{
+		script[i] = script[i - 1];
+		i--;
+	}
+	script[i] = (struct input_change){ .time = at_ns, .pin = pin, .level = level != 0 };
+	script_length++;
+	pthread_mutex_unlock(&lock);
+
+	return SUCCESS;
+}
+
+int GPIO_sim_script_press(uint8_t pin, uint64_t at_ns, uint64_t duration_ns)
+{
+	if (GPIO_sim_script_input(pin, at_ns, 1) != SUCCESS)
+		return FAILURE;
+	return GPIO_sim_script_input(pin, at_ns + duration_ns, 0);
+}
+
+void GPIO_sim_set_input(uint8_t pin, uint8_t level)
+{
+	if (pin >= PINS)
+		return;
+
+	pthread_mutex_lock(&lock);
+	if (level)
+		input_levels |= (uint64_t)1 << pin;
+	else
+		input_levels &= ~((uint64_t)1 << pin);
+	pthread_mutex_unlock(&lock);
+}
+
+void GPIO_sim_set_output_hook(void (*hook)(uint64_t levels))
+{
+	pthread_mutex_lock(&lock);
+	output_hook = hook;
+	pthread_mutex_unlock(&lock);
+}
+
+void GPIO_sim_set_access_time(uint64_t ns)
+{
+	pthread_mutex_lock(&lock);
+	access_time = ns;
+	pthread_mutex_unlock(&lock);
+}
+
+uint8_t GPIO_sim_get_output(uint8_t pin)
+{
+	pthread_mutex_lock(&lock);
+	uint8_t level = pin < PINS && (output_latch >> pin) & 1;
+	pthread_mutex_unlock(&lock);
+	return level;
+}
+
+void GPIO_sim_get_counters(struct gpio_sim_counters *sim_counters)
+{
+	pthread_mutex_lock(&lock);
+	*sim_counters = counters;
+	pthread_mutex_unlock(&lock);
+}
+
+/**
+ * The script and the clock are kept, so inputs can be scripted before GPIO_init()
+*/
+static int sim_init(void)
+{
+	pthread_mutex_lock(&lock);
+	clear_registers();
+	pthread_mutex_unlock(&lock);
+	return SUCCESS;
+}
+
+static void sim_set_in(uint8_t pin)
+{
+	uint32_t offset = GPIO_GPFSEL0 + (pin / 10) * 4;
+	sim_write(offset, sim_read(offset) & ~(7u << ((pin % 10) * 3)));
+}
+
+static void sim_set_out(uint8_t pin)
+{
+	sim_set_in(pin);
+	uint32_t offset = GPIO_GPFSEL0 + (pin / 10) * 4;
+	sim_write(offset, sim_read(offset) | (1u << ((pin % 10) * 3)));
+}
+
+static void sim_set_direction_mask(uint32_t out_mask, uint32_t in_mask)
+{
+	for (uint8_t fsel = 0; fsel < GPIO_FSEL_REGISTERS; fsel++)
+	{
+		uint32_t clear;
+		uint32_t set;
+		if (!GPIO_fsel_masks(fsel, out_mask, in_mask, &clear, &set))
+			continue;
+
+		uint32_t offset = GPIO_GPFSEL0 + fsel * 4;
+		sim_write(offset, (sim_read(offset) & ~clear) | set);
+	}
+}
+
+static void sim_set_state(uint8_t pin, uint8_t state)
+{
+	sim_write(state ? GPIO_GPSET0 : GPIO_GPCLR0, 1u << pin);
+}
+
+static void sim_write_mask(uint32_t set_mask, uint32_t clear_mask)
+{
+	if (clear_mask)
+		sim_write(GPIO_GPCLR0, clear_mask);
+	if (set_mask)
+		sim_write(GPIO_GPSET0, set_mask);
+}
+
+static uint8_t sim_get_state(uint8_t pin)
+{
+	return (sim_read(GPIO_GPLEV0) >> pin) & 1;
+}
+
+static uint32_t sim_read_levels(void)
+{
+	return sim_read(GPIO_GPLEV0);
+}
+
+const struct gpio_backend GPIO_sim_backend =
+{
+	.name = "sim",
+	.init = sim_init,
+	.set_in = sim_set_in,
+	.set_out = sim_set_out,
+	.set_direction_mask = sim_set_direction_mask,
+	.set_state = sim_set_state,
+	.write_mask = sim_write_mask,
+	.get_state = sim_get_state,
+	.read_levels = sim_read_levels,
+	.now = GPIO_sim_now,
+};
@@ -0,0 +1,101 @@
+#ifndef GPIO_SIM_H
+#define GPIO_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Simulated GPIO register file.
+ * Select it with GPIO_set_backend(GPIO_BACKEND_SIM) before GPIO_init().
+ *
+ * The simulator keeps a virtual clock in nanoseconds. By default the clock
+ * follows CLOCK_MONOTONIC from the moment the simulator was reset, so
+ * unmodified programs see inputs change in real time. With the manual clock
+ * the time only moves when GPIO_sim_advance() is called.
+*/
+
+/**
+ * Bus transactions performed on the simulated registers
+*/
+struct gpio_sim_counters
+{
+	uint64_t reads;
+	uint64_t writes;
+};
+
+/**
+ * Clears all the registers, the scripted inputs, the counters
+ * and restarts the virtual clock from 0.
+*/
+void GPIO_sim_reset(void);
+
+/**
+ * manual - true: the clock only moves with GPIO_sim_advance()
+ *          false: the clock follows the real monotonic clock (default)
+*/
+void GPIO_sim_use_manual_clock(bool manual);
+
+/**
+ * Returns the current virtual time in nanoseconds
+*/
+uint64_t GPIO_sim_now(void);
+
+/**
+ * Moves the manual clock forward by ns nanoseconds.
+ * Has no effect when the clock follows the real time.
+*/
+void GPIO_sim_advance(uint64_t ns);
+
+/**
+ * Schedules the input level of the pin to change at virtual time at_ns.
+ * Returns 0 on success, -1 on failure.
+*/
+int GPIO_sim_script_input(uint8_t pin, uint64_t at_ns, uint8_t level);
+
+/**
+ * Schedules a button press: high at at_ns, low again after duration_ns.
+ * Returns 0 on success, -1 on failure.
+*/
+int GPIO_sim_script_press(uint8_t pin, uint64_t at_ns, uint64_t duration_ns);
+
+/**
+ * Changes the input level of the pin immediately.
+ * Meant for simulated devices connected to the pins (see GPIO_sim_set_output_hook).
+*/
+void GPIO_sim_set_input(uint8_t pin, uint8_t level);
+
+/**
+ * Registers a function called after every write to GPSET/GPCLR with the
+ * new output latch (bit n - level driven on pin n). NULL removes the hook.
+ * Used to connect simulated devices, for example the HD44780 model in lcd_sim.h.
+*/
+void GPIO_sim_set_output_hook(void (*hook)(uint64_t levels));
+
+/**
+ * Cost of one bus transaction - with the manual clock every register
+ * read or write moves the clock forward by ns nanoseconds (0 by default).
+*/
+void GPIO_sim_set_access_time(uint64_t ns);
+
+/**
+ * Returns the level the program drives on the pin (output latch)
+*/
+uint8_t GPIO_sim_get_output(uint8_t pin);
+
+/**
+ * Returns true if the pin is configured as an output
+*/
+bool GPIO_sim_is_output(uint8_t pin);
+
+/**
+ * Returns the contents of the register at the given byte offset
+ * without counting it as a bus transaction.
+*/
+uint32_t GPIO_sim_read_register(uint32_t offset);
+
+/**
+ * Copies the bus transaction counters
+*/
+void GPIO_sim_get_counters(struct gpio_sim_counters *counters);
+
+#endif
@@ -1,78 +1,98 @@
 #include "lcd.h"
 #include <stdint.h>
 #include <stdbool.h>
-#include <time.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
 #include "../gpio/gpio.h"
+#include "../delay/delay.h"
 #include "../timeunits.h"
+#include "../stats/stats.h"
+#include "lcd_hw.h"
 
-// RPi GPIO pin assignments
-#define LCD_RS 25
-#define LCD_E 24
-#define LCD_D4 23
-#define LCD_D5 10
-#define LCD_D6 27
-#define LCD_D7 22
-
-/* Instructions */
-// Clear display
-#define LCD_CLEAR 0x01
-// Return home
-#define LCD_HOME 0x02
-
-// Entry mode set
-#define LCD_ENTRY_MODE				0x04
-	#define LCD_EM_SHIFT_CURSOR		0
-	#define LCD_EM_SHIFT_DISPLAY	0x01
-	#define LCD_EM_DECREMENT		0
-	#define LCD_EM_INCREMENT		0x02
-
-// Display on/off control
-#define LCD_DISPLAY_ONOFF			0x08
-	#define LCD_DISPLAY_OFF			0
-	#define LCD_DISPLAY_ON			0x04
-	#define LCD_CURSOR_OFF			0
-	#define LCD_CURSOR_ON			0x02
-	#define LCD_CURSOR_NOBLINK		0
-	#define LCD_CURSOR_BLINK		0x01
-
-// Cursor or display shift
-#define LCD_DISPLAY_CURSOR_SHIFT	0x10
-	#define LCD_SHIFT_CURSOR		0
-	#define LCD_SHIFT_DISPLAY		0x08
-	#define LCD_SHIFT_LEFT			0
-	#define LCD_SHIFT_RIGHT			0x04
-
-// Function set
-#define LCD_FUNCTION_SET			0x20
-	#define LCD_FONT5x7				0
-	#define LCD_FONT5x10			0x04
-	#define LCD_ONE_LINE			0
-	#define LCD_TWO_LINE			0x08
-	#define LCD_4_BIT				0
-	#define LCD_8_BIT				0x10
-
-// Set CGRAM address
-#define LCD_CGRAM_SET				0x40
-
-// Set DDRAM address
-#define LCD_DDRAM_SET				0x80
+// The DDRAM address is not known (for example after writing to CGRAM)
+#define ADDRESS_UNKNOWN -1
+
+// Execution times of the instructions
+#define LCD_CLEAR_TIME_NS MS_TO_NS(2)
+#define LCD_INSTRUCTION_TIME_NS US_TO_NS(50)
+// Fastest execution times (350 kHz oscillator), the busy flag is not polled before
+#define LCD_CLEAR_MIN_NS US_TO_NS(1170)
+#define LCD_INSTRUCTION_MIN_NS US_TO_NS(28)
+// Time between two reads of the busy flag
+#define LCD_BUSY_POLL_NS US_TO_NS(2)
+// Give up on the busy flag (and go back to the fixed delays) after this time
+#define LCD_BUSY_TIMEOUT_NS MS_TO_NS(10)
+
+// Number of queued bytes in asynchronous mode (power of 2)
+#define RING_SIZE 256
+// Queue entry: the byte in the low 8 bits and the level of RS above them
+#define RING_RS 0x100
+
+#define SUCCESS 0
+#define FAILURE -1
+
+// Contents the callers want on the display (LCD_buffer_* functions)
+static char buffer[LCD_ROWS][LCD_COLUMNS];
+// Contents of the DDRAM of the display, as far as we know
+static char screen[LCD_ROWS][LCD_COLUMNS];
+// Current DDRAM address of the display
+static int16_t address = ADDRESS_UNKNOWN;
+
+// GPIO pin connected to R/W
+static uint8_t rw_pin = LCD_RW_NONE;
+// Poll the busy flag instead of waiting the worst case execution time
+static bool busy_flag;
+
+/*
+ * Asynchronous mode - single producer (the caller), single consumer (writer thread) ring.
+ * ring_head counts the queued entries and is only written by the producer,
+ * ring_tail counts the written entries and is only written by the writer thread.
+*/
+static uint16_t ring[RING_SIZE];
+static _Atomic size_t ring_head;
+static _Atomic size_t ring_tail;
+static atomic_bool async;
+static atomic_bool writer_running;
+static atomic_bool writer_sleeping;
+static pthread_t writer;
+// Only used to put the writer to sleep when the ring is empty and to wait for it in LCD_sync
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t writer_idle = PTHREAD_COND_INITIALIZER;
 
 
 /**
  * Writes an 8-bit data to the LCD using D4-D7 pins
+ * rs - level of the RS pin (0 - command, 1 - data)
 */
-static void write(uint8_t data);
+static void write(uint8_t data, uint8_t rs);
 
 /**
- * Writes 4 bits (a nibble) to the LCD using D4-D7 pins
+ * Writes 4 bits (a nibble) to the LCD using D4-D7 pins and pulses E.
+ * The data lines and RS are updated together with one GPSET0 and one GPCLR0 store.
 */
-static void write_nibble(uint8_t nibble);
+static void write_nibble(uint8_t nibble, uint8_t rs);
+
+/**
+ * Polls the busy flag until the LCD is ready for the next instruction,
+ * sent min_ns ago at the earliest.
+ * Returns false if the LCD is still busy after LCD_BUSY_TIMEOUT_NS.
+*/
+static bool wait_ready(uint64_t min_ns);
 
 /**
  * Set all the pins used by the LCD as outputs
 */
 static void init_pins(void)
 {
+	if (rw_pin != LCD_RW_NONE)
+	{
+		GPIO_set_out(rw_pin);
+		GPIO_set_state(rw_pin, 0);  // Write
+	}
 	GPIO_set_out(LCD_RS);
 	GPIO_set_out(LCD_E);
 	GPIO_set_out(LCD_D4);
@@ -81,23 +101,13 @@ static void init_pins(void)
 	GPIO_set_out(LCD_D7);
 
 	// Wait for the input voltage to stabilize
-	struct timespec delay = {
-		.tv_sec = 0,
-		.tv_nsec = MS_TO_NS(15),
-	};
-	nanosleep(&delay, NULL);
+	DELAY_ns(MS_TO_NS(15));
 
-	GPIO_set_state(LCD_RS, 0);
-	GPIO_set_state(LCD_E, 0);
+	GPIO_write_mask(0, LCD_RS_MASK | LCD_E_MASK);
 }
 
 static void set_4_bit_mode(void)
 {
-	struct timespec delay =
-	{
-		.tv_sec = 0,
-		.tv_nsec = 0,
-	};
 	/*
 	 * We need to change the HD44780 interface to use 4-bit data lines
 	 * It is set to 8-bit mode by default so we have to execute the following
@@ -106,27 +116,17 @@ static void set_4_bit_mode(void)
 	// Repeat the following 3 times
 	for (uint8_t i = 0; i < 3; i++)
 	{
-		GPIO_set_state(LCD_E, 1);
-		write_nibble(0x03);  // 8-bit mode
-		GPIO_set_state(LCD_E, 0);
-		delay.tv_nsec = MS_TO_NS(5);
-		nanosleep(&delay, NULL);
+		write_nibble(0x03, 0);  // 8-bit mode
+		DELAY_ns(MS_TO_NS(5));
 	}
 
 	// Set it to 4-bit mode
-	GPIO_set_state(LCD_E, 1);
-	write_nibble(0x02);  // 4-bit mode
-	GPIO_set_state(LCD_E, 0);
+	write_nibble(0x02, 0);  // 4-bit mode
 }
 
 static void set_up_display(void)
 {
-	struct timespec delay =
-	{
-		.tv_sec = 0,
-		.tv_nsec = MS_TO_NS(1),
-	};
-	nanosleep(&delay, NULL);
+	DELAY_ns(MS_TO_NS(1));
 	// Set the LCD to 4 bits, 2 lines, 5x7 font
 	LCD_write_command(LCD_FUNCTION_SET | LCD_FONT5x7 | LCD_TWO_LINE | LCD_4_BIT);
 	// Clear the display
@@ -134,9 +134,6 @@ static void set_up_display(void)
 	// Clear the DDRAM contents
 	LCD_write_command(LCD_CLEAR);
 
-	delay.tv_nsec = MS_TO_NS(2);
-	nanosleep(&delay, NULL);
-
 	// Address and cursor increment (when writing)
 	LCD_write_command(LCD_ENTRY_MODE | LCD_EM_SHIFT_CURSOR | LCD_EM_INCREMENT);
 	// Turn the LCD on, without the cursor and without blinking
@@ -148,24 +145,117 @@ void LCD_init(bool init_gpio)
 	if (init_gpio)
 		GPIO_init();
 
+	busy_flag = false;  // The busy flag can not be read before the 4-bit mode is set up
 	init_pins();
 	set_4_bit_mode();
+	busy_flag = rw_pin != LCD_RW_NONE;
 	set_up_display();
 }
 
+void LCD_set_rw_pin(uint8_t pin)
+{
+	rw_pin = pin;
+}
+
 void LCD_clear(void)
 {
 	LCD_write_command(LCD_CLEAR);
-	struct timespec delay = {
-		.tv_sec = 0,
-		.tv_nsec = MS_TO_NS(2),
-	};
-	nanosleep(&delay, NULL);
 }
 
 void LCD_go_to(uint8_t x, uint8_t y)
 {
-	LCD_write_command(LCD_DDRAM_SET | (x + (0x40 * y)));
+	int16_t target = x + (LCD_ROW_OFFSET * y);
+	if (target != address)  // The address set is not needed if the display is already there
+		LCD_write_command(LCD_DDRAM_SET | target);
+}
+
+/**
+ * Returns the screen cell of the DDRAM address, NULL if it is not visible
+*/
+static char *screen_cell(int16_t ddram_address)
+{
+	if (ddram_address == ADDRESS_UNKNOWN)
+		return NULL;
+
+	uint8_t row = ddram_address >= LCD_ROW_OFFSET;
+	uint8_t column = ddram_address - row * LCD_ROW_OFFSET;
+	return column < LCD_COLUMNS ? &screen[row][column] : NULL;
+}
+
+/**
+ * Updates the screen contents and the address after writing data
+*/
+static void track_data(uint8_t data)
+{
+	char *cell = screen_cell(address);
+	if (cell)
+	{
+		*cell = data;
+		// Direct writes are kept in the buffer too, so LCD_flush() does not undo them
+		buffer[0][cell - screen[0]] = data;
+	}
+
+	if (address == ADDRESS_UNKNOWN)
+		return;
+
+	// The address is incremented after every write and wraps to the other row
+	if (address == LCD_ROW_END)
+		address = LCD_ROW_OFFSET;
+	else if (address == LCD_ROW_OFFSET + LCD_ROW_END)
+		address = 0;
+	else
+		address++;
+}
+
+/**
+ * Updates the screen contents and the address after a command
+*/
+static void track_command(uint8_t command)
+{
+	if (command & LCD_DDRAM_SET)
+		address = command & ~LCD_DDRAM_SET;
+	else if (command & (LCD_CGRAM_SET | LCD_DISPLAY_CURSOR_SHIFT))
+		address = ADDRESS_UNKNOWN;  // Writes go to CGRAM, or the cursor was moved
+	else if (command & (LCD_FUNCTION_SET | LCD_DISPLAY_ONOFF | LCD_ENTRY_MODE))
+		return;  // The address and the contents do not change
+	else if (command & LCD_HOME)
+		address = 0;
+	else if (command & LCD_CLEAR)
+	{
+		memset(screen, ' ', sizeof(screen));
+		memset(buffer, ' ', sizeof(buffer));
+		address = 0;
+	}
+}
+
+void LCD_buffer_clear(void)
+{
+	memset(buffer, ' ', sizeof(buffer));
+}
+
+void LCD_buffer_write(uint8_t x, uint8_t y, const char *text)
+{
+	if (y >= LCD_ROWS)
+		return;
+
+	for (; *text && x < LCD_COLUMNS; x++)
+		buffer[y][x] = *text++;
+}
+
+void LCD_flush(void)
+{
+	for (uint8_t y = 0; y < LCD_ROWS; y++)
+	{
+		for (uint8_t x = 0; x < LCD_COLUMNS; x++)
+		{
+			if (buffer[y][x] == screen[y][x])
+				continue;
+
+			// Consecutive changed cells only need one address set
+			LCD_go_to(x, y);
+			LCD_write_data(buffer[y][x]);
+		}
+	}
 }
 
 void LCD_write_text(char *text)
@@ -174,16 +264,126 @@ void LCD_write_text(char *text)
 		LCD_write_data(*text++);
 }
 
+/**
+ * Queues the byte for the writer thread.
+ * Only waits if the ring is full.
+*/
+static void push(uint8_t data, uint8_t rs)
+{
+	size_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+	while (head - atomic_load_explicit(&ring_tail, memory_order_acquire) == RING_SIZE)
+		sched_yield();
+
+	ring[head % RING_SIZE] = data | (rs ? RING_RS : 0);
+	atomic_store(&ring_head, head + 1);
+
+	if (atomic_load(&writer_sleeping))
+	{
+		pthread_mutex_lock(&writer_lock);
+		pthread_cond_signal(&writer_work);
+		pthread_mutex_unlock(&writer_lock);
+	}
+}
+
+/**
+ * Writes the byte directly or queues it in asynchronous mode
+*/
+static void send(uint8_t data, uint8_t rs)
+{
+	if (atomic_load_explicit(&async, memory_order_relaxed))
+		push(data, rs);
+	else
+		write(data, rs);
+}
+
+/**
+ * Writer thread - drains the ring with the normal (blocking) timing
+*/
+static void *write_loop(void *arg)
+{
+	(void)arg;
+
+	for (;;)
+	{
+		size_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+		if (tail != atomic_load_explicit(&ring_head, memory_order_acquire))
+		{
+			uint16_t entry = ring[tail % RING_SIZE];
+			write(entry & 0xFF, (entry & RING_RS) != 0);
+			atomic_store_explicit(&ring_tail, tail + 1, memory_order_release);
+			continue;
+		}
+
+		// The ring is empty - wake up LCD_sync and sleep until a byte is pushed
+		pthread_mutex_lock(&writer_lock);
+		atomic_store(&writer_sleeping, true);
+		bool empty = atomic_load(&ring_head) == tail;
+		bool stop = empty && !atomic_load(&writer_running);
+		if (empty)
+		{
+			pthread_cond_broadcast(&writer_idle);
+			if (!stop)
+				pthread_cond_wait(&writer_work, &writer_lock);
+		}
+		atomic_store(&writer_sleeping, false);
+		pthread_mutex_unlock(&writer_lock);
+
+		if (stop)
+			return NULL;
+	}
+}
+
+int LCD_start_async(void)
+{
+	if (atomic_load(&async))
+		return SUCCESS;
+
+	atomic_store(&writer_running, true);
+	if (pthread_create(&writer, NULL, write_loop, NULL) != 0)
+	{
+		atomic_store(&writer_running, false);
+		perror("Unable to start the LCD writer");
+		return FAILURE;
+	}
+	atomic_store(&async, true);
+
+	return SUCCESS;
+}
+
+void LCD_sync(void)
+{
+	if (!atomic_load(&async))
+		return;
+
+	pthread_mutex_lock(&writer_lock);
+	while (atomic_load(&ring_tail) != atomic_load(&ring_head))
+		pthread_cond_wait(&writer_idle, &writer_lock);
+	pthread_mutex_unlock(&writer_lock);
+}
+
+void LCD_stop_async(void)
+{
+	if (!atomic_load(&async))
+		return;
+
+	atomic_store(&async, false);
+	pthread_mutex_lock(&writer_lock);
+	atomic_store(&writer_running, false);
+	pthread_cond_signal(&writer_work);
+	pthread_mutex_unlock(&writer_lock);
+	pthread_join(writer, NULL);  // The writer drains the ring before it stops
+}
+
 void LCD_write_data(uint8_t data)
 {
-	GPIO_set_state(LCD_RS, 1);
-	write(data);
+	send(data, 1);
+	track_data(data);
 }
 
 void LCD_write_command(uint8_t command)
 {
-	GPIO_set_state(LCD_RS, 0);
-	write(command);
+	send(command, 0);
+	track_command(command);
 }
 
 void LCD_display_cursor(bool display, bool blink)
@@ -194,26 +394,70 @@ void LCD_display_cursor(bool display, bool blink)
 	LCD_write_command(function);
 }
 
-static void write(uint8_t data)
+static void write(uint8_t data, uint8_t rs)
+{
+	STATS_COUNT(rs ? STATS_LCD_DATA : STATS_LCD_COMMANDS, 1);
+	write_nibble(data >> 4, rs);  // Write the most significant 4 bits first
+	write_nibble(data, rs);  // Write the remaining 4 bits
+
+	// Clear and return home take much longer than the other instructions
+	bool slow = !rs && (data == LCD_CLEAR || (data & ~LCD_CLEAR) == LCD_HOME);
+	if (busy_flag)
+	{
+		if (wait_ready(slow ? LCD_CLEAR_MIN_NS : LCD_INSTRUCTION_MIN_NS))
+			return;
+
+		fprintf(stderr, "Warning - The LCD busy flag is stuck, using fixed delays\n");
+		busy_flag = false;
+	}
+
+	DELAY_ns(slow ? LCD_CLEAR_TIME_NS : LCD_INSTRUCTION_TIME_NS);
+}
+
+static bool wait_ready(uint64_t min_ns)
 {
-	GPIO_set_state(LCD_E, 1);
-	write_nibble(data >> 4);  // Write the most significant 4 bits first
-	GPIO_set_state(LCD_E, 0);
-	GPIO_set_state(LCD_E, 1);
-	write_nibble(data);  // Write the remaining 4 bits
-	GPIO_set_state(LCD_E, 0);
+	uint32_t rw_mask = GPIO_PIN_MASK(rw_pin);
+	bool busy;
+
+	// No instruction is done sooner, reading the flag before would only cost bus transactions
+	DELAY_ns(min_ns);
 
-	struct timespec delay = {
-		.tv_sec = 0,
-		.tv_nsec = US_TO_NS(50),
-	};
-	nanosleep(&delay, NULL);
+	// The LCD drives the data lines while R/W is high
+	GPIO_set_direction_mask(0, LCD_DATA_MASK);
+	GPIO_write_mask(rw_mask, LCD_RS_MASK);  // Read the busy flag and address (RS = 0, R/W = 1)
+
+	uint64_t deadline = DELAY_now() + LCD_BUSY_TIMEOUT_NS;
+	for (;;)
+	{
+		// High nibble - the busy flag is on D7
+		GPIO_write_mask(LCD_E_MASK, 0);
+		busy = (GPIO_read_levels() & GPIO_PIN_MASK(LCD_D7)) != 0;
+		GPIO_write_mask(0, LCD_E_MASK);
+		// Low nibble (rest of the address) has to be clocked out as well
+		GPIO_write_mask(LCD_E_MASK, 0);
+		GPIO_write_mask(0, LCD_E_MASK);
+		if (!busy || DELAY_now() >= deadline)
+			break;
+		DELAY_ns(LCD_BUSY_POLL_NS);
+	}
+
+	GPIO_write_mask(0, rw_mask);
+	GPIO_set_direction_mask(LCD_DATA_MASK, 0);
+
+	return !busy;
 }
 
-static void write_nibble(uint8_t nibble)
+static void write_nibble(uint8_t nibble, uint8_t rs)
 {
-	GPIO_set_state(LCD_D4, nibble & 0x01);
-	GPIO_set_state(LCD_D5, nibble & 0x02);
-	GPIO_set_state(LCD_D6, nibble & 0x04);
-	GPIO_set_state(LCD_D7, nibble & 0x08);
+	uint32_t set = 0;
+	set |= (nibble & 0x01) ? GPIO_PIN_MASK(LCD_D4) : 0;
+	set |= (nibble & 0x02) ? GPIO_PIN_MASK(LCD_D5) : 0;
+	set |= (nibble & 0x04) ? GPIO_PIN_MASK(LCD_D6) : 0;
+	set |= (nibble & 0x08) ? GPIO_PIN_MASK(LCD_D7) : 0;
+	set |= rs ? LCD_RS_MASK : 0;
+
+	// RS and the data have to be stable before E goes high, the LCD latches them when E goes low
+	GPIO_write_mask(set, (LCD_DATA_MASK | LCD_RS_MASK) & ~set);
+	GPIO_write_mask(LCD_E_MASK, 0);
+	GPIO_write_mask(0, LCD_E_MASK);
 }
\ No newline at end of file
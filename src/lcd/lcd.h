@@ -4,6 +4,10 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Size of the display
+#define LCD_COLUMNS 16
+#define LCD_ROWS 2
+
 /**
  * Initialises the LCD display
  * If init_gpio is true, the function will
@@ -11,8 +15,19 @@
 */
 void LCD_init(bool init_gpio);
 
+// R/W is not connected (tied to ground)
+#define LCD_RW_NONE 0xFF
+
 /**
- * Clears the entire display
+ * Sets the GPIO pin (0-31) connected to R/W, has to be called before LCD_init.
+ * When R/W is connected the driver polls the busy flag of the display
+ * and continues as soon as the display is ready, otherwise (LCD_RW_NONE,
+ * the default) it waits the worst case execution time of every instruction.
+*/
+void LCD_set_rw_pin(uint8_t pin);
+
+/**
+ * Clears the entire display (and the frame buffer)
 */
 void LCD_clear(void);
 
@@ -42,4 +57,50 @@ void LCD_write_command(uint8_t command);
  * blink - enable blinking when blink=true, disable if false
 */
 void LCD_display_cursor(bool display, bool blink);
+
+/**
+ * Asynchronous mode
+ * Starts a writer thread. From now on the LCD functions only queue the
+ * commands and data and return immediately, the writer thread sends them
+ * to the display with the proper timing.
+ * Returns 0 on success, -1 on failure.
+*/
+int LCD_start_async(void);
+
+/**
+ * Waits until the writer thread has sent everything that was queued.
+ * Returns immediately when the asynchronous mode is not running.
+*/
+void LCD_sync(void);
+
+/**
+ * Sends everything that was queued and stops the writer thread.
+ * The LCD functions block again until the data is sent.
+*/
+void LCD_stop_async(void);
+
+/**
+ * Frame buffer
+ * The LCD_buffer_* functions draw into a 16x2 shadow copy of the display
+ * without any bus transactions. LCD_flush() then writes only the characters
+ * which differ from the display contents.
+*/
+
+/**
+ * Fills the frame buffer with spaces
+*/
+void LCD_buffer_clear(void);
+
+/**
+ * Writes text into the frame buffer at the x, y position.
+ * The text is clipped at the end of the row.
+*/
+void LCD_buffer_write(uint8_t x, uint8_t y, const char *text);
+
+/**
+ * Sends the changed characters of the frame buffer to the display.
+ * Neighbouring changes share one DDRAM address set, the display is never cleared.
+ * The DDRAM address (cursor) is left after the last written character.
+*/
+void LCD_flush(void);
 #endif
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef LCD_HW_H
+#define LCD_HW_H
+
+/**
+ * HD44780 wiring and instruction set.
+ * Shared by the LCD driver and the simulated display (lcd_sim.c).
+*/
+
+#include "../gpio/gpio.h"
+
+// RPi GPIO pin assignments (R/W is tied to ground unless set with LCD_set_rw_pin)
+#define LCD_RS 25
+#define LCD_E 24
+#define LCD_D4 23
+#define LCD_D5 10
+#define LCD_D6 27
+#define LCD_D7 22
+
+// GPIO_write_mask masks of the pins above
+#define LCD_RS_MASK GPIO_PIN_MASK(LCD_RS)
+#define LCD_E_MASK GPIO_PIN_MASK(LCD_E)
+#define LCD_DATA_MASK (GPIO_PIN_MASK(LCD_D4) | GPIO_PIN_MASK(LCD_D5) | \
+					   GPIO_PIN_MASK(LCD_D6) | GPIO_PIN_MASK(LCD_D7))
+
+/* Instructions */
+// Clear display
+#define LCD_CLEAR 0x01
+// Return home
+#define LCD_HOME 0x02
+
+// Entry mode set
+#define LCD_ENTRY_MODE				0x04
+	#define LCD_EM_SHIFT_CURSOR		0
+	#define LCD_EM_SHIFT_DISPLAY	0x01
+	#define LCD_EM_DECREMENT		0
+	#define LCD_EM_INCREMENT		0x02
+
+// Display on/off control
+#define LCD_DISPLAY_ONOFF			0x08
+	#define LCD_DISPLAY_OFF			0
+	#define LCD_DISPLAY_ON			0x04
+	#define LCD_CURSOR_OFF			0
+	#define LCD_CURSOR_ON			0x02
+	#define LCD_CURSOR_NOBLINK		0
+	#define LCD_CURSOR_BLINK		0x01
+
+// Cursor or display shift
+#define LCD_DISPLAY_CURSOR_SHIFT	0x10
+	#define LCD_SHIFT_CURSOR		0
+	#define LCD_SHIFT_DISPLAY		0x08
+	#define LCD_SHIFT_LEFT			0
+	#define LCD_SHIFT_RIGHT			0x04
+
+// Function set
+#define LCD_FUNCTION_SET			0x20
+	#define LCD_FONT5x7				0
+	#define LCD_FONT5x10			0x04
+	#define LCD_ONE_LINE			0
+	#define LCD_TWO_LINE			0x08
+	#define LCD_4_BIT				0
+	#define LCD_8_BIT				0x10
+
+// Set CGRAM address
+#define LCD_CGRAM_SET				0x40
+
+// Set DDRAM address
+#define LCD_DDRAM_SET				0x80
+
+// DDRAM address of the first character of the second row
+#define LCD_ROW_OFFSET 0x40
+// Last DDRAM address of a row (the address wraps around to the other row after it)
+#define LCD_ROW_END 0x27
+
+#endif
@@ -0,0 +1,189 @@
+#include "lcd_sim.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../gpio/gpio.h"
+#include "../gpio/gpio_sim.h"
+#include "../timeunits.h"
+#include "lcd_hw.h"
+
+// Execution times from the HD44780 datasheet (fosc = 270 kHz)
+#define CLEAR_TIME_NS US_TO_NS(1520)
+#define INSTRUCTION_TIME_NS US_TO_NS(37)
+#define DATA_TIME_NS US_TO_NS(41)
+
+#define DDRAM_SIZE (LCD_ROW_OFFSET + LCD_ROW_END + 1)
+
+static uint8_t rw;
+static uint64_t previous_levels;
+static bool four_bit;  // The display starts in 8-bit mode
+static bool have_high_nibble;  // Waiting for the low nibble in 4-bit mode
+static uint8_t high_nibble;
+static bool read_high_nibble;  // Next read returns the high nibble
+static uint8_t ddram[DDRAM_SIZE];
+static uint8_t address_counter;
+static bool cgram;  // Data goes to CGRAM (not modelled) instead of DDRAM
+static uint64_t busy_until;
+static struct lcd_sim_counters counters;
+
+static bool pin_high(uint64_t levels, uint8_t pin)
+{
+	return (levels >> pin) & 1;
+}
+
+static uint8_t data_nibble(uint64_t levels)
+{
+	return pin_high(levels, LCD_D4)
+		| pin_high(levels, LCD_D5) << 1
+		| pin_high(levels, LCD_D6) << 2
+		| pin_high(levels, LCD_D7) << 3;
+}
+
+/**
+ * Drives the data lines (seen by the program when the pins are inputs)
+*/
+static void drive_nibble(uint8_t nibble)
+{
+	GPIO_sim_set_input(LCD_D4, nibble & 0x01);
+	GPIO_sim_set_input(LCD_D5, nibble & 0x02);
+	GPIO_sim_set_input(LCD_D6, nibble & 0x04);
+	GPIO_sim_set_input(LCD_D7, nibble & 0x08);
+}
+
+static void increment_address(void)
+{
+	if (address_counter == LCD_ROW_END)
+		address_counter = LCD_ROW_OFFSET;
+	else if (address_counter >= LCD_ROW_OFFSET + LCD_ROW_END)
+		address_counter = 0;
+	else
+		address_counter++;
+}
+
+static void execute(uint8_t byte, bool rs)
+{
+	uint64_t now = GPIO_sim_now();
+	if (now < busy_until)
+	{
+		counters.violations++;  // A real display ignores the byte
+		return;
+	}
+
+	if (rs)
+	{
+		if (!cgram && address_counter < DDRAM_SIZE)
+			ddram[address_counter] = byte;
+		increment_address();
+		counters.data++;
+		busy_until = now + DATA_TIME_NS;
+		return;
+	}
+
+	counters.instructions++;
+	busy_until = now + INSTRUCTION_TIME_NS;
+
+	if (byte & LCD_DDRAM_SET)
+	{
+		address_counter = byte & ~LCD_DDRAM_SET;
+		cgram = false;
+	}
+	else if (byte & LCD_CGRAM_SET)
+		cgram = true;
+	else if (byte & LCD_FUNCTION_SET)
+		four_bit = !(byte & LCD_8_BIT);
+	else if (byte == LCD_CLEAR)
+	{
+		memset(ddram, ' ', sizeof(ddram));
+		address_counter = 0;
+		cgram = false;
+		busy_until = now + CLEAR_TIME_NS;
+	}
+	else if ((byte & ~LCD_CLEAR) == LCD_HOME)
+	{
+		address_counter = 0;
+		cgram = false;
+		busy_until = now + CLEAR_TIME_NS;
+	}
+	// Entry mode, display control and shifts only change what is shown
+}
+
+/**
+ * Called by the GPIO simulator after every change of the outputs
+*/
+static void on_outputs(uint64_t levels)
+{
+	bool e_rising = !pin_high(previous_levels, LCD_E) && pin_high(levels, LCD_E);
+	bool e_falling = pin_high(previous_levels, LCD_E) && !pin_high(levels, LCD_E);
+	bool rs = pin_high(levels, LCD_RS);
+	bool read = rw != LCD_RW_NONE && pin_high(levels, rw);
+
+	if (rw != LCD_RW_NONE && pin_high(previous_levels, rw) && !read)
+	{
+		drive_nibble(0);  // Stop driving the data lines
+		read_high_nibble = true;
+	}
+	previous_levels = levels;
+
+	if (read)
+	{
+		if (!e_rising || rs)
+			return;
+
+		// Busy flag and address counter, high nibble first
+		uint8_t value = (GPIO_sim_now() < busy_until ? 0x80 : 0) | (address_counter & 0x7F);
+		if (read_high_nibble)
+			counters.busy_reads++;
+		drive_nibble(read_high_nibble ? value >> 4 : value & 0x0F);
+		read_high_nibble = !read_high_nibble;
+		return;
+	}
+
+	if (!e_falling)
+		return;
+
+	// The display latches the data lines when E goes low
+	uint8_t nibble = data_nibble(levels);
+	if (!four_bit)
+		execute(nibble << 4, rs);  // D0-D3 are not connected
+	else if (!have_high_nibble)
+	{
+		high_nibble = nibble;
+		have_high_nibble = true;
+	}
+	else
+	{
+		execute(high_nibble << 4 | nibble, rs);
+		have_high_nibble = false;
+	}
+}
+
+void LCD_sim_attach(uint8_t rw_pin)
+{
+	rw = rw_pin;
+	previous_levels = 0;
+	four_bit = false;
+	have_high_nibble = false;
+	read_high_nibble = true;
+	memset(ddram, ' ', sizeof(ddram));
+	address_counter = 0;
+	cgram = false;
+	busy_until = 0;
+	memset(&counters, 0, sizeof(counters));
+	GPIO_sim_set_output_hook(on_outputs);
+}
+
+void LCD_sim_detach(void)
+{
+	GPIO_sim_set_output_hook(NULL);
+}
+
+void LCD_sim_get_row(uint8_t row, char text[LCD_COLUMNS + 1])
+{
+	memcpy(text, &ddram[row ? LCD_ROW_OFFSET : 0], LCD_COLUMNS);
+	text[LCD_COLUMNS] = '\0';
+}
+
+void LCD_sim_get_counters(struct lcd_sim_counters *sim_counters)
+{
+	*sim_counters = counters;
+}
@@ -0,0 +1,48 @@
+#ifndef LCD_SIM_H
+#define LCD_SIM_H
+
+#include <stdint.h>
+#include "lcd.h"
+
+/**
+ * Simulated HD44780 display connected to the simulated GPIO backend.
+ * The model decodes the nibbles written by the driver, keeps the DDRAM
+ * contents and the busy time of every instruction (on the simulator clock)
+ * and drives the busy flag on D7 when R/W is high.
+ *
+ * With the manual clock of the simulator the busy flag only clears if the
+ * clock moves while it is polled - set a bus access time with
+ * GPIO_sim_set_access_time() and route the delays to GPIO_sim_advance
+ * with DELAY_set_hook().
+*/
+
+struct lcd_sim_counters
+{
+	uint64_t instructions;  // Executed instructions
+	uint64_t data;  // Written characters
+	uint64_t busy_reads;  // Reads of the busy flag
+	uint64_t violations;  // Instructions or data sent while the display was busy (ignored)
+};
+
+/**
+ * Connects the model to the GPIO simulator and resets it (8-bit mode, empty DDRAM).
+ * rw_pin - pin connected to R/W, LCD_RW_NONE if it is tied to ground
+*/
+void LCD_sim_attach(uint8_t rw_pin);
+
+/**
+ * Disconnects the model from the GPIO simulator
+*/
+void LCD_sim_detach(void);
+
+/**
+ * Copies the visible characters of the row into text (null terminated)
+*/
+void LCD_sim_get_row(uint8_t row, char text[LCD_COLUMNS + 1]);
+
+/**
+ * Copies the counters of the model
+*/
+void LCD_sim_get_counters(struct lcd_sim_counters *counters);
+
+#endif
@@ -0,0 +1,228 @@
+#include "led.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include "../gpio/gpio.h"
+#include "../timer/timer.h"
+#include "../timeunits.h"
+
+#define SUCCESS 0
+#define FAILURE -1
+
+// Number of steps that can be queued
+#define LED_QUEUE_SIZE 256
+// Resolution of the timer wheel
+#define LED_TICK_NS MS_TO_NS(10)
+
+struct step
+{
+	uint8_t pin;
+	uint8_t level;
+	uint16_t toggles;  // The level is inverted and held again this many times, so flashes are one step
+	uint32_t hold_ms;
+};
+
+static struct step steps[LED_QUEUE_SIZE];
+static size_t steps_head;  // Next step to be played
+static size_t steps_length;
+static struct step current;
+static bool playing;  // A step is being held
+
+static struct timer_wheel wheel;
+static struct timer sequencer;  // Expires at the end of the current step
+
+static pthread_t thread;
+static bool running;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work;  // New steps or stop, uses CLOCK_MONOTONIC
+static pthread_cond_t idle = PTHREAD_COND_INITIALIZER;  // Everything is played
+static pthread_cond_t space = PTHREAD_COND_INITIALIZER;  // A step left the full queue
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * SEC_TO_NS(1u) + now.tv_nsec;
+}
+
+/**
+ * Drives the level of the current step and holds it. Has to be called with the lock held.
+*/
+static void play_current(uint64_t now)
+{
+	if (current.pin != LED_NONE)
+		GPIO_set_state(current.pin, current.level);
+
+	playing = true;
+	TIMER_schedule(&wheel, &sequencer, now + MS_TO_NS((uint64_t)current.hold_ms));
+}
+
+/**
+ * Starts the next queued step. Has to be called with the lock held.
+*/
+static void play_next(uint64_t now)
+{
+	current = steps[steps_head];
+	steps_head = (steps_head + 1) % LED_QUEUE_SIZE;
+	steps_length--;
+	pthread_cond_signal(&space);
+
+	play_current(now);
+}
+
+/**
+ * End of the current level
+*/
+static void on_step_end(struct timer *timer, uint64_t now)
+{
+	(void)timer;
+	if (current.toggles)
+	{
+		current.toggles--;
+		current.level = !current.level;
+		play_current(now);
+		return;
+	}
+
+	playing = false;
+	if (steps_length)
+		play_next(now);
+}
+
+/**
+ * LED thread - sleeps until the next timer expires or a step is queued
+*/
+static void *led_loop(void *arg)
+{
+	(void)arg;
+
+	pthread_mutex_lock(&lock);
+	for (;;)
+	{
+		uint64_t now = now_ns();
+		TIMER_advance(&wheel, now);
+		if (!playing && steps_length)
+			play_next(now);
+
+		if (!playing)
+		{
+			pthread_cond_broadcast(&idle);
+			if (!running)
+				break;
+		}
+
+		uint64_t expires = TIMER_next_expiry(&wheel);
+		if (expires == TIMER_NONE)
+			pthread_cond_wait(&work, &lock);
+		else if (expires > now)
+		{
+			struct timespec deadline =
+			{
+				.tv_sec = expires / SEC_TO_NS(1u),
+				.tv_nsec = expires % SEC_TO_NS(1u),
+			};
+			pthread_cond_timedwait(&work, &lock, &deadline);
+		}
+	}
+	pthread_mutex_unlock(&lock);
+
+	return NULL;
+}
+
+int LED_start(void)
+{
+	static bool initialised;
+	if (!initialised)
+	{
+		pthread_condattr_t attr;
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(&work, &attr);
+		pthread_condattr_destroy(&attr);
+		initialised = true;
+	}
+
+	pthread_mutex_lock(&lock);
+	if (running)
+	{
+		pthread_mutex_unlock(&lock);
+		return SUCCESS;
+	}
+
+	TIMER_wheel_init(&wheel, LED_TICK_NS, now_ns());
+	TIMER_init(&sequencer, on_step_end, NULL);
+	running = true;
+	if (pthread_create(&thread, NULL, led_loop, NULL) != 0)
+	{
+		running = false;
+		pthread_mutex_unlock(&lock);
+		perror("Unable to start the LED thread");
+		return FAILURE;
+	}
+	pthread_mutex_unlock(&lock);
+
+	return SUCCESS;
+}
+
+void LED_stop(void)
+{
+	pthread_mutex_lock(&lock);
+	if (!running)
+	{
+		pthread_mutex_unlock(&lock);
+		return;
+	}
+	running = false;
+	pthread_cond_signal(&work);
+	pthread_cond_broadcast(&space);
+	pthread_mutex_unlock(&lock);
+
+	pthread_join(thread, NULL);  // The thread plays the remaining steps first
+}
+
+/**
+ * Appends the step, waits for the LED thread to play one if the queue is full
+*/
+static int queue(struct step step)
+{
+	pthread_mutex_lock(&lock);
+	while (steps_length == LED_QUEUE_SIZE && running)
+		pthread_cond_wait(&space, &lock);
+	if (steps_length == LED_QUEUE_SIZE)
+	{
+		pthread_mutex_unlock(&lock);
+		fprintf(stderr, "Warning - LED queue is full and the LED thread is not running, step dropped\n");
+		return FAILURE;
+	}
+
+	steps[(steps_head + steps_length) % LED_QUEUE_SIZE] = step;
+	steps_length++;
+	pthread_cond_signal(&work);
+	pthread_mutex_unlock(&lock);
+
+	return SUCCESS;
+}
+
+int LED_queue_step(uint8_t pin, uint8_t level, uint32_t hold_ms)
+{
+	return queue((struct step){.pin = pin, .level = level, .hold_ms = hold_ms});
+}
+
+int LED_queue_flashes(uint8_t pin, uint8_t flashes)
+{
+	if (!flashes)
+		return SUCCESS;
+
+	// On, off, on, off .. - one step however many flashes
+	return queue((struct step){.pin = pin, .level = 1, .toggles = 2 * flashes - 1, .hold_ms = LED_FLASH_MS});
+}
+
+void LED_sync(void)
+{
+	pthread_mutex_lock(&lock);
+	while (running && (playing || steps_length))
+		pthread_cond_wait(&idle, &lock);
+	pthread_mutex_unlock(&lock);
+}
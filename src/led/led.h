@@ -0,0 +1,48 @@
+#ifndef LED_H
+#define LED_H
+
+#include <stdint.h>
+
+/**
+ * Non-blocking LED animations.
+ * Steps are queued and played in order by a background thread driven by
+ * a timer wheel, so the caller never waits for the LEDs.
+*/
+
+// "Pin" of a step that only waits
+#define LED_NONE 0xFF
+// Length of the on and off parts of one flash
+#define LED_FLASH_MS 500
+
+/**
+ * Starts the LED thread.
+ * Returns 0 on success, -1 on failure.
+*/
+int LED_start(void);
+
+/**
+ * Waits until all queued steps are played and stops the LED thread
+*/
+void LED_stop(void);
+
+/**
+ * Queues a step: drive the pin to level and hold it for hold_ms
+ * before the next step. pin LED_NONE only waits hold_ms.
+ * Waits for a free place while the queue is full, steps are never dropped.
+ * Returns 0 on success, -1 if the queue is full and the LED thread is not running.
+*/
+int LED_queue_step(uint8_t pin, uint8_t level, uint32_t hold_ms);
+
+/**
+ * Queues flashes of the LED (LED_FLASH_MS on, LED_FLASH_MS off) as one
+ * step, so any number of flashes takes one place in the queue.
+ * Returns 0 on success, -1 if the queue is full (see LED_queue_step).
+*/
+int LED_queue_flashes(uint8_t pin, uint8_t flashes);
+
+/**
+ * Waits until all queued steps are played
+*/
+void LED_sync(void);
+
+#endif
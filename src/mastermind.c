@@ -1,20 +1,33 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <time.h>
-#include <unistd.h>
 #include <string.h>
+#include <signal.h>
+#include <arpa/inet.h>
 #include "timeunits.h"
 
 #include "gpio/gpio.h"
 #include "lcd/lcd.h"
+#include "led/led.h"
+#include "timer/timer.h"
+#include "game/game.h"
+#include "server/server.h"
+#include "matrix/matrix.h"
+#include "simulate/simulate.h"
+#include "solver/solver.h"
+#include "candidates/candidates.h"
+#include "rng/rng.h"
+#include "trace/trace.h"
+#include "delay/delay.h"
+#include "stats/stats.h"
+#include "arena/arena.h"
 
 #define LED_G 13
 #define LED_R 5
 #define BTN 19
 
-#define SEC 1000000
-#define HALF_SEC 500000
+#define SEC_MS 1000
+#define HALF_SEC_MS 500
 
 #define SETTINGS 3
 #define ARG_CHARACTERS 4
@@ -27,11 +40,32 @@
 // Default maximum number
 #define MAX_DEF 3
 
+// Resolution of the game timers
+#define TIMER_TICK_NS MS_TO_NS(10)
+
 // Game settings with default values
 static uint8_t number_of_numbers = NUMBERS_DEF;
 static uint8_t number_of_rounds = ROUNDS_DEF;
 static uint8_t max_random = MAX_DEF;
 static bool debug = false;
+static const char *server_address = NULL;  // --server=, NULL - play on the hardware
+static const char *matrix_path = NULL;  // --matrix=, NULL - compute the scores
+static const char *build_matrix_path = NULL;  // --build-matrix=, NULL - play
+static struct matrix matrix;  // Mapped --matrix file
+static const char *simulate_games = NULL;  // --simulate=, NULL - play
+static const char *simulate_threads = NULL;  // --threads=, NULL - one per CPU
+static const char *seed_arg = NULL;  // --seed=, NULL - a different seed every run
+static uint64_t seed;
+static const char *record_path = NULL;  // --record=, NULL - not recorded
+static const char *replay_path = NULL;  // --replay=, NULL - play
+static bool realtime = false;  // --realtime, replay at the recorded speed
+static const char *stats_format = NULL;  // --stats=, NULL - no statistics
+static uint64_t last_input = 0;  // Time of the last button event, 0 - none yet
+static struct rng rng;  // Secrets of the game
+static struct code_set space;  // Every code of the game, for the candidates
+static struct candidates candidates;  // Codes consistent with the feedback, debug only
+static bool tracking = false;  // candidates are kept up to date
+static uint64_t last_guess;  // Packed, pruned with the feedback
 
 struct setting
 {
@@ -40,13 +74,21 @@ struct setting
 	char description[DESC_MAX_LENGTH];  // description of the setting
 };
 
-static uint8_t cursor_x = 0;  // Keep track of where the cursor is for input
+/**
+ * Cursor position of the digit at position in the guess
+*/
+static uint8_t MM_cursor_x(uint8_t position)
+{
+	return position * 2;
+}
 
 /**
- * This function will be called by GPIO_get_button_presses on every button press
+ * Called by the game on every button press while a digit is entered
 */
-void MM_handle_button_press(uint8_t presses)
+void MM_handle_button_press(void *context, uint8_t position, uint8_t presses)
 {
+	(void)context;
+
 	if (presses > 99)  // buffer of 3 characters can only fit 2 digits
 	{
 		fprintf(stderr, "Warning - presses does not fit into the buffer. \
@@ -54,29 +96,18 @@ void MM_handle_button_press(uint8_t presses)
 		return;
 	}
 	char buff[3];
-	sprintf(buff, "%d", presses);
-	LCD_write_text(buff);
-	LCD_go_to(cursor_x, 0);  // The cursor will move 2 characters to the right, move it back
+	sprintf(buff, "%-2d", presses);  // Pad with a space so a shorter number overwrites a longer one
+	LCD_buffer_write(MM_cursor_x(position), 0, buff);
+	LCD_flush();  // Only the changed digits are written
+	LCD_go_to(MM_cursor_x(position), 0);  // The cursor moves to the right when writing, move it back
 }
 
+/**
+ * Queues the flashes, the LED thread plays them in the background
+*/
 void MM_flash_led(const int led, const int number_of_flashes)
 {
-	for (int i = 0; i < number_of_flashes; i++)
-	{
-		GPIO_set_state(led, 1);
-		usleep(HALF_SEC);
-		GPIO_set_state(led, 0);
-		usleep(HALF_SEC);
-	}
-}
-
-static void MM_get_one_number(int *input)
-{
-	LCD_display_cursor(true, true);  // Enable blinking cursor
-	*input = GPIO_get_button_presses(BTN, max_random, MM_handle_button_press);
-	cursor_x += 2;  // Update the cursor position
-	LCD_go_to(cursor_x, 0);  // Move the cursor to that position
-	LCD_display_cursor(true, false);  // Display cursor but don't blink
+	LED_queue_flashes(led, number_of_flashes);
 }
 
 /**
@@ -95,74 +126,6 @@ static void MM_end_input(void)
 {
 	LCD_display_cursor(false, false);  // Turn off the cursor
 	MM_flash_led(LED_R, 2);  // End of sequence flash
-	cursor_x = 0;
-}
-
-/**
- * Returns a pointer to an integer array with the user input
-*/
-int *MM_get_guess(void)
-{
-	int *input = malloc(number_of_numbers * sizeof(int));
-	if (!input)
-	{
-		perror("Unable to allocate memory for the input");
-		return NULL;
-	}
-
-	for (int i = 0; i < number_of_numbers; i++)
-	{
-		MM_get_one_number(&input[i]);
-		MM_acknowledge_input(input[i]);
-	}
-	MM_end_input();
-	return input;
-}
-
-/**
- * Calculates the number of exact and approximate (wrong position) matches.
-*/
-void MM_calculate_matches(int *exact, int *approx, int secret[], int guess[], size_t size)
-{
-	/*
-	 * The algorithm creates a bool array of size N.
-	 * This is done to solve the issue where a loop
-	 * for approximate matches would count the same
-	 * number twice.
-	*/
-	bool *counted = calloc(size, sizeof(bool));  // Create the array, initialised with 0s (false)
-
-	for (size_t i = 0; i < size; i++)
-	{
-		if (guess[i] == secret[i])
-		{
-			(*exact)++;
-			/*
-			 * It may happen that secret[i] was already checked and counted as an approximate match
-			 * Therefore, if the counted flag at position i is true we need to decrement the number
-			 * of approximate matches because this number will be actually an exact match.
-			*/
-			if (counted[i])
-				(*approx)--;
-
-			counted[i] = true;
-		}
-		else
-		{
-			// Check if the number exists somewhere else in the array
-			for (size_t j = 0; j < size; j++)
-			{
-				if (guess[i] == secret[j] && !counted[j])  // If the same and not already counted
-				{
-					counted[j] = true;
-					(*approx)++;
-					break;  // Found a match for guess[i] - exit the loop and get the next guess number
-				}
-			}
-		}
-	}
-
-	free(counted);
 }
 
 /**
@@ -176,10 +139,16 @@ bool MM_init()
 	GPIO_set_out(LED_G);
 	GPIO_set_out(LED_R);
 	GPIO_set_in(BTN);
+	if (GPIO_sampler_start(GPIO_SAMPLE_PERIOD_US) != 0)
+		return false;
 	GPIO_set_state(LED_G, 0);
 	GPIO_set_state(LED_R, 0);
 	LCD_init(false);
 	LCD_go_to(0, 0);
+	if (LCD_start_async() != 0)  // The game does not wait for the display from now on
+		return false;
+	if (LED_start() != 0)  // Nor for the LEDs
+		return false;
 
 	return true;
 }
@@ -189,19 +158,19 @@ bool MM_init()
 */
 void MM_attempt_output(int approx, int exact)
 {
-	LCD_clear();
+	LCD_buffer_clear();
 
 	// LCD Exact output
-	LCD_go_to(0, 0);
-	char exact_buffer[10];
-	sprintf(exact_buffer, "Exact: %d", exact);
-	LCD_write_text(exact_buffer);
+	char exact_buffer[LCD_COLUMNS + 1];
+	snprintf(exact_buffer, sizeof(exact_buffer), "Exact: %d", exact);
+	LCD_buffer_write(0, 0, exact_buffer);
 
 	// LCD approx output
-	LCD_go_to(0, 1);
-	char approx_buffer[10];
-	sprintf(approx_buffer, "Approx: %d", approx);
-	LCD_write_text(approx_buffer);
+	char approx_buffer[LCD_COLUMNS + 1];
+	snprintf(approx_buffer, sizeof(approx_buffer), "Approx: %d", approx);
+	LCD_buffer_write(0, 1, approx_buffer);
+
+	LCD_flush();
 
 	// Flashes for number of exact matches
 	MM_flash_led(LED_G, exact);
@@ -216,41 +185,35 @@ void MM_attempt_output(int approx, int exact)
 */
 void MM_success_output(int number_of_rounds)
 {
-	usleep(SEC);
-	LCD_clear();
-	LCD_go_to(0, 0);
-	LCD_write_text("Success!");
+	LCD_buffer_clear();
+	LCD_buffer_write(0, 0, "Success!");
 
 	// Display the number of played rounds
-	LCD_go_to(0, 1);
-	char rounds_buffer[16];
-	sprintf(rounds_buffer, "Rounds: %d", number_of_rounds);
-	LCD_write_text(rounds_buffer);
+	char rounds_buffer[LCD_COLUMNS + 1];
+	snprintf(rounds_buffer, sizeof(rounds_buffer), "Rounds: %d", number_of_rounds);
+	LCD_buffer_write(0, 1, rounds_buffer);
+	LCD_flush();
 
-	GPIO_set_state(LED_R, 1);
-	usleep(HALF_SEC);
+	LED_queue_step(LED_NONE, 0, SEC_MS);  // Pause after the input acknowledgement
+	LED_queue_step(LED_R, 1, HALF_SEC_MS);
 	MM_flash_led(LED_G, 3);
-	usleep(HALF_SEC);
-	GPIO_set_state(LED_R, 0);
+	LED_queue_step(LED_NONE, 0, HALF_SEC_MS);
+	LED_queue_step(LED_R, 0, 0);
 }
 
 /**
  * Returns pseudo-randomly generated secret
- * for user to guess
+ * for user to guess, allocated from the arena
 */
-int *MM_generate_secret()
+int *MM_generate_secret(struct arena *arena)
 {
-	int *secret = malloc(number_of_numbers * sizeof(int));
-	srand(time(NULL));
-
-	for (int i = 0; i < number_of_numbers; i++)
-	{
-		secret[i] = (rand() % max_random) + 1;
-	}
+	int *secret = ARENA_alloc(arena, number_of_numbers * sizeof(int));
+	if (secret)
+		RNG_code(&rng, secret, number_of_numbers, max_random);
 	return secret;
 }
 
-static void MM_output_numbers(char *message, int *array, size_t array_size)
+static void MM_output_numbers(char *message, const int *array, size_t array_size)
 {
 	printf("%s:", message);
 	for (size_t i = 0; i < array_size; i++)
@@ -260,6 +223,166 @@ static void MM_output_numbers(char *message, int *array, size_t array_size)
 	printf("\n");
 }
 
+/**
+ * Called by the game when it waits for the digit at position
+*/
+static void MM_handle_input(void *context, uint8_t position)
+{
+	(void)context;
+	(void)position;
+	LCD_display_cursor(true, true);  // Enable blinking cursor
+}
+
+/**
+ * Called by the game when the digit at position has been accepted
+*/
+static void MM_handle_digit(void *context, uint8_t position, uint8_t value)
+{
+	(void)context;
+	LCD_go_to(MM_cursor_x(position + 1), 0);  // Move the cursor to the next digit
+	LCD_display_cursor(true, false);  // Display cursor but don't blink
+	MM_acknowledge_input(value);
+}
+
+/**
+ * Called by the game when the whole guess has been entered
+*/
+static void MM_handle_guess(void *context, const int *guess, uint8_t length)
+{
+	(void)context;
+	MM_end_input();
+
+	if (debug)
+	{
+		MM_output_numbers("Guess", guess, length);
+	}
+	if (tracking)
+		last_guess = CODE_encode(guess, length);
+}
+
+/**
+ * Adds the time since the last button event to the input to feedback statistics
+*/
+static void MM_record_feedback_latency(void)
+{
+	if (last_input)
+		STATS_RECORD(STATS_INPUT_FEEDBACK_NS, GPIO_now() - last_input);
+}
+
+static void MM_handle_feedback(void *context, uint8_t exact, uint8_t approx)
+{
+	(void)context;
+	MM_attempt_output(approx, exact);
+	printf("Press the button to continue...\n");
+	LCD_display_cursor(true, true);
+	MM_record_feedback_latency();
+
+	if (tracking)
+		printf("Remaining candidates: %u\n", CANDIDATES_prune(&candidates, last_guess, SCORE_PACK(exact, approx)));
+}
+
+static void MM_handle_next_round(void *context, uint8_t round)
+{
+	(void)context;
+	(void)round;
+	LCD_display_cursor(true, false);
+	MM_flash_led(LED_R, 3);
+	LCD_buffer_clear();
+	LCD_flush();
+	LCD_go_to(0, 0);  // Input starts from the top left corner
+}
+
+static void MM_handle_success(void *context, uint8_t rounds)
+{
+	(void)context;
+	MM_success_output(rounds);
+	MM_record_feedback_latency();
+}
+
+/**
+ * Only called if the user failed to guess the secret
+*/
+static void MM_handle_game_over(void *context, uint8_t rounds)
+{
+	(void)context;
+	(void)rounds;
+	LCD_display_cursor(false, false);
+	MM_flash_led(LED_R, 3);
+	LCD_buffer_clear();
+	LCD_buffer_write(0, 0, "GAME OVER");
+	LCD_flush();
+}
+
+static const struct game_output MM_output =
+{
+	.input = MM_handle_input,
+	.presses = MM_handle_button_press,
+	.digit = MM_handle_digit,
+	.guess = MM_handle_guess,
+	.feedback = MM_handle_feedback,
+	.next_round = MM_handle_next_round,
+	.success = MM_handle_success,
+	.game_over = MM_handle_game_over,
+};
+
+/**
+ * Converts the time until the next timer expires to a GPIO_wait_event timeout
+*/
+static int32_t MM_timeout_ms(const struct timer_wheel *wheel, uint64_t now)
+{
+	uint64_t expires = TIMER_next_expiry(wheel);
+	if (expires == TIMER_NONE)
+		return -1;  // Nothing scheduled, wait for the button
+	if (expires <= now)
+		return 0;
+
+	uint64_t timeout = (expires - now + MS_TO_NS(1) - 1) / MS_TO_NS(1);  // Round up
+	return timeout > INT32_MAX ? INT32_MAX : (int32_t)timeout;
+}
+
+/**
+ * Returns the outcome of a finished game
+*/
+static struct trace_result MM_result(const struct game *game)
+{
+	struct trace_result result =
+	{
+		.round = game->round,
+		.won = memcmp(game->secret, game->guess, game->settings.numbers * sizeof(int)) == 0,
+	};
+	return result;
+}
+
+/**
+ * Runs the game until it is over.
+ * The only place where the program waits - for a button event or
+ * for the next timer of the game, whichever comes first.
+ * Every event is also written to the trace, if there is one.
+*/
+static void MM_run(struct game *game, struct timer_wheel *wheel, struct trace *trace)
+{
+	uint64_t advanced = GPIO_now();  // Time of the last TIMER_advance
+	while (!GAME_is_over(game))
+	{
+		struct gpio_event event;
+		if (GPIO_wait_event(GPIO_PIN_MASK(BTN), MM_timeout_ms(wheel, GPIO_now()), &event))
+		{
+			STATS_RECORD(STATS_INPUT_NS, GPIO_now() - event.timestamp);
+			TRACE_deliver(trace, game, wheel, &event, &advanced);  // In the order a replay sees
+			last_input = event.timestamp;
+		}
+
+		advanced = GPIO_now();
+		TIMER_advance(wheel, advanced);
+	}
+
+	if (trace)
+	{
+		struct trace_result result = MM_result(game);
+		TRACE_record_end(trace, GPIO_now(), &result);
+	}
+}
+
 /**
  * Returns true if the given argument is the debug argument
 */
@@ -268,6 +391,57 @@ static bool MM_debug_arg(char *arg)
 	return strcmp(arg, "-d") == 0;
 }
 
+/**
+ * Returns true if the given argument is "[name]=[value]", value is set to
+ * the part after "="
+*/
+static bool MM_value_arg(char *arg, const char *name, const char **value)
+{
+	size_t length = strlen(name);
+	if (strncmp(arg, name, length) != 0 || arg[length] != '=')
+		return false;
+
+	*value = arg + length + 1;
+	return true;
+}
+
+/**
+ * Returns true if the given argument is one of the long arguments:
+ * "--server" (default port), "--server=[port]", "--server=[host:port]",
+ * "--server=[Unix socket path]",
+ * "--matrix=[file]", "--build-matrix=[file]", "--simulate=[games]",
+ * "--threads=[threads]", "--seed=[seed]", "--record=[file]",
+ * "--replay=[file]", "--realtime" or "--stats[=text|json]"
+*/
+static bool MM_long_arg(char *arg)
+{
+	if (strcmp(arg, "--server") == 0)
+	{
+		server_address = "";
+		return true;
+	}
+	if (strcmp(arg, "--realtime") == 0)
+	{
+		realtime = true;
+		return true;
+	}
+	if (strcmp(arg, "--stats") == 0)
+	{
+		stats_format = "text";
+		return true;
+	}
+
+	return MM_value_arg(arg, "--server", &server_address) ||
+		   MM_value_arg(arg, "--matrix", &matrix_path) ||
+		   MM_value_arg(arg, "--build-matrix", &build_matrix_path) ||
+		   MM_value_arg(arg, "--simulate", &simulate_games) ||
+		   MM_value_arg(arg, "--threads", &simulate_threads) ||
+		   MM_value_arg(arg, "--seed", &seed_arg) ||
+		   MM_value_arg(arg, "--record", &record_path) ||
+		   MM_value_arg(arg, "--replay", &replay_path) ||
+		   MM_value_arg(arg, "--stats", &stats_format);
+}
+
 /**
  * Enables the debug flag, changes the game settings to default.
 */
@@ -347,70 +521,392 @@ static void MM_parse_args(int argc, char *argv[])
 			return;
 		}
 
-		MM_parse_settings(argv[i]);
+		if (!MM_long_arg(argv[i]))
+			MM_parse_settings(argv[i]);
 	}
 }
 
-int main(int argc, char *argv[])
+/**
+ * Returns the game settings given by the program arguments
+*/
+static struct game_settings MM_settings(void)
 {
-	printf("Welcome to Mastermind, coded by Adam Malek & Chris Hulme for Hardware-Software Interface.\n");
+	struct game_settings settings =
+	{
+		.numbers = number_of_numbers,
+		.rounds = number_of_rounds,
+		.max = max_random,
+		.input_timeout = MS_TO_NS((uint64_t)GAME_INPUT_TIMEOUT_MS),
+		.matrix = matrix.classes ? &matrix : NULL,
+	};
+	return settings;
+}
 
-	if (!MM_init())
+/**
+ * Maps the --matrix file. Without it (or if it cannot be used) the game
+ * computes the scores, so a missing file only gives a warning.
+*/
+static void MM_open_matrix(void)
+{
+	if (!matrix_path)
+		return;
+
+	if (MATRIX_open(&matrix, matrix_path) != 0)
 	{
-		fprintf(stderr, "Failed to initialise the game. This program has to be run with sudo privileges\n");
-		exit(EXIT_FAILURE);
+		printf("Warning - The scores will be computed\n");
+		return;
 	}
-	MM_parse_args(argc, argv);
-	int *secret = MM_generate_secret();
+	if (!MATRIX_covers(&matrix, number_of_numbers, max_random))
+	{
+		printf("Warning - %s has the scores of %hhu numbers from 1 to %hhu, "
+			   "the scores of other games will be computed\n", matrix_path, matrix.numbers, matrix.colours);
+	}
+}
 
-	if (debug)
+/**
+ * Starts keeping the codes consistent with the feedback, their number is
+ * printed after every round in debug mode
+*/
+static void MM_track_candidates(const struct game_settings *settings)
+{
+	if (SOLVER_space_init(&space, settings->numbers, settings->max) != 0)
 	{
-		MM_output_numbers("Secret", secret, number_of_numbers);
+		printf("Warning - The remaining candidates will not be printed\n");
+		return;
 	}
+	if (CANDIDATES_init(&candidates, &space, settings->max, settings->matrix) != 0)
+	{
+		CODE_set_free(&space);
+		return;
+	}
+	tracking = true;
+}
+
+/**
+ * Writes the matrix of the game settings to the --build-matrix file.
+ * Returns the exit status of the program.
+*/
+static int MM_build_matrix(void)
+{
+	printf("Building the matrix of %hhu numbers from 1 to %hhu\n", number_of_numbers, max_random);
+	if (MATRIX_build(build_matrix_path, number_of_numbers, max_random) != 0)
+		return EXIT_FAILURE;
 
-	bool success = false;  // Indicates whether the guess was successful (true) or not
+	printf("Matrix written to %s\n", build_matrix_path);
+	return EXIT_SUCCESS;
+}
+
+static void MM_stop_server(int signal)
+{
+	(void)signal;
+	SERVER_stop();
+}
 
-	// The following loop will repeat for the number of rounds or until the guess was successful
-	for (int i = 1; i <= number_of_rounds && !success; i++)
+/**
+ * Runs the game server instead of the game on the hardware.
+ * Returns the exit status of the program.
+*/
+static int MM_serve(void)
+{
+	struct server_config config =
 	{
-		int *guess = MM_get_guess();
+		.path = NULL,
+		.port = SERVER_PORT_DEF,
+		.max_sessions = SERVER_SESSIONS_DEF,
+		.settings = MM_settings(),
+		.seed = seed,
+	};
 
-		if (debug)
-		{
-			MM_output_numbers("Guess", guess, number_of_numbers);
-		}
+	if (number_of_numbers < 1 || number_of_numbers > SERVER_NUMBERS_MAX || max_random < 1 || number_of_rounds < 1)
+	{
+		fprintf(stderr, "Error - The server needs 1-%d numbers, a maximum number and rounds above 0\n",
+				SERVER_NUMBERS_MAX);
+		return EXIT_FAILURE;
+	}
 
-		int exact = 0;
-		int approximate = 0;
-		MM_calculate_matches(&exact, &approximate, secret, guess, number_of_numbers);
+	if (*server_address && SERVER_parse_address(server_address, &config) != 0)
+		return EXIT_FAILURE;
 
-		// Successful guess
-		if (exact == number_of_numbers)
-		{
-			MM_success_output(i);
-			success = true;
-		}
-		else
+	struct sigaction action = {.sa_handler = MM_stop_server};
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	if (config.path)
+		printf("Serving on %s\n", config.path);
+	else
+	{
+		struct in_addr host = {htonl(config.host ? config.host : INADDR_LOOPBACK)};
+		printf("Serving on %s:%hu\n", inet_ntoa(host), config.port);
+	}
+
+	int status = SERVER_run(&config) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	MATRIX_close(&matrix);
+	return status;
+}
+
+/**
+ * Parses a positive number of a long argument, returns false if it is not one
+*/
+static bool MM_parse_count(const char *name, const char *text, uint64_t max, uint64_t *value)
+{
+	char *end;
+	unsigned long long number = strtoull(text, &end, 10);
+	if (end == text || *end != '\0' || number == 0 || number > max)
+	{
+		fprintf(stderr, "Error - Invalid %s %s\n", name, text);
+		return false;
+	}
+
+	*value = number;
+	return true;
+}
+
+/**
+ * Dumps the statistics on exit and SIGUSR1 with --stats.
+ * Called before any thread is started. Returns false on failure.
+*/
+static bool MM_start_stats(void)
+{
+	if (!stats_format)
+		return true;
+
+	if (strcmp(stats_format, "text") != 0 && strcmp(stats_format, "json") != 0)
+	{
+		fprintf(stderr, "Error - Invalid statistics format %s (text or json)\n", stats_format);
+		return false;
+	}
+	return STATS_start(strcmp(stats_format, "json") == 0 ? STATS_JSON : STATS_TEXT) == 0;
+}
+
+/**
+ * Seeds the random numbers with --seed, or a different seed every run.
+ * Returns false if --seed is not a number.
+*/
+static bool MM_seed(void)
+{
+	if (!seed_arg)
+		seed = RNG_entropy();
+	else
+	{
+		char *end;
+		seed = strtoull(seed_arg, &end, 0);
+		if (end == seed_arg || *end != '\0')
 		{
-			MM_attempt_output(approximate, exact);
-			printf("Press the button to continue...\n");
-			LCD_display_cursor(true, true);
-			GPIO_get_button_press(BTN);
-			LCD_display_cursor(true, false);
-			MM_flash_led(LED_R, 3);
-			LCD_clear();
+			fprintf(stderr, "Error - Invalid seed %s\n", seed_arg);
+			return false;
 		}
-		free(guess);
 	}
 
-	if (!success)  // Only executed if the user failed to guess the secret
+	RNG_seed(&rng, seed);
+	return true;
+}
+
+static uint64_t replay_origin;  // DELAY_now time of the start of the replay
+
+/**
+ * With --realtime waits until the time of the trace (relative to the start of the replay)
+*/
+static void MM_replay_wait(uint64_t time)
+{
+	uint64_t now = DELAY_now() - replay_origin;
+	if (time > now)
+		DELAY_ns(time - now);
+}
+
+/**
+ * Plays the recorded events of the trace file on the game engine, at full
+ * speed without any output, or with --realtime at the recorded speed on
+ * the LCD and the LEDs. The game gets exactly the recorded timestamps, so
+ * it has to end the way it ended when it was recorded.
+ * Returns the exit status of the program.
+*/
+static int MM_replay(void)
+{
+	struct trace trace;
+	if (TRACE_open(&trace, replay_path) != 0)
+		return EXIT_FAILURE;
+
+	struct game_settings settings = MM_settings();
+	settings.numbers = trace.header.numbers;
+	settings.rounds = trace.header.rounds;
+	settings.max = trace.header.max;
+	printf("Replaying %hhu numbers from 1 to %hhu, %hhu rounds, seed %llu\n", settings.numbers, settings.max,
+		   settings.rounds, (unsigned long long)trace.header.seed);
+
+	if (realtime && !MM_init())
+	{
+		fprintf(stderr, "Failed to initialise the game. This program has to be run with sudo privileges\n");
+		TRACE_close(&trace);
+		return EXIT_FAILURE;
+	}
+
+	struct arena arena;
+	struct timer_wheel wheel;
+	struct game game;
+	TIMER_wheel_init(&wheel, TIMER_TICK_NS, 0);  // The times of the trace start from 0
+	if (ARENA_init(&arena, GAME_ARENA_SIZE(settings.numbers)) != 0 ||
+		GAME_init(&game, &settings, realtime ? &MM_output : NULL, NULL, &wheel, &arena) != 0)
+	{
+		ARENA_free(&arena);
+		TRACE_close(&trace);
+		return EXIT_FAILURE;
+	}
+
+	replay_origin = DELAY_now();
+	GAME_start(&game, trace.secret);
+
+	uint64_t events;
+	struct trace_result recorded;
+	int type = TRACE_replay(&trace, &game, &wheel, BTN, realtime ? MM_replay_wait : NULL, &events, &recorded);
+	uint64_t elapsed = DELAY_now() - replay_origin;
+
+	int status = EXIT_SUCCESS;
+	struct trace_result result = MM_result(&game);
+	if (type < 0)
+	{
+		fprintf(stderr, "Error - The trace is damaged or incomplete\n");
+		status = EXIT_FAILURE;
+	}
+	else if (!GAME_is_over(&game) || result.round != recorded.round || result.won != recorded.won)
+	{
+		fprintf(stderr, "Error - The replay ended differently: %s in round %hhu instead of %s in round %hhu\n",
+				!GAME_is_over(&game) ? "not over" : result.won ? "won" : "lost", result.round,
+				recorded.won ? "won" : "lost", recorded.round);
+		status = EXIT_FAILURE;
+	}
+	else
+	{
+		printf("Replayed %llu events (%.3f s of play) in %.3f ms: %s in round %hhu, as recorded\n",
+			   (unsigned long long)events, trace.last / 1e9, elapsed / 1e6, result.won ? "won" : "lost",
+			   result.round);
+	}
+
+	GAME_free(&game);
+	ARENA_free(&arena);
+	TRACE_close(&trace);
+	if (realtime)
+	{
+		LED_stop();
+		LCD_stop_async();
+	}
+	return status;
+}
+
+/**
+ * Plays --simulate games with the built-in codebreaker instead of the
+ * game on the hardware and prints the statistics.
+ * Returns the exit status of the program.
+*/
+static int MM_simulate(void)
+{
+	struct simulate_config config =
+	{
+		.threads = 0,
+		.seed = seed,
+		.settings = MM_settings(),
+	};
+
+	uint64_t threads = 0;
+	if (!MM_parse_count("number of games", simulate_games, UINT64_MAX, &config.games) ||
+		(simulate_threads && !MM_parse_count("number of threads", simulate_threads, UINT16_MAX, &threads)))
+		return EXIT_FAILURE;
+	config.threads = threads;
+
+	struct simulate_stats stats;
+	if (SIMULATE_run(&config, &stats) != 0)
+		return EXIT_FAILURE;
+
+	double seconds = stats.elapsed_ns / 1e9;
+	printf("Simulated %llu games of %hhu numbers from 1 to %hhu on %u threads in %.3f s (%.0f games/s)\n",
+		   (unsigned long long)stats.games, number_of_numbers, max_random, stats.threads, seconds,
+		   seconds > 0 ? stats.games / seconds : 0.0);
+	printf("Won within %hhu rounds: %.2f%%\n", number_of_rounds,
+		   stats.games ? 100.0 * stats.wins / stats.games : 0.0);
+	printf("Average number of guesses: %.4f\n", stats.games ? (double)stats.guesses / stats.games : 0.0);
+	printf("%8s %12s %8s\n", "guesses", "games", "%");
+	for (size_t i = 1; i <= SIMULATE_GUESSES_MAX; i++)
 	{
-		LCD_clear();
-		LCD_display_cursor(false, false);
-		LCD_go_to(0, 0);
-		LCD_write_text("GAME OVER");
+		if (stats.distribution[i])
+			printf("%7zu%s %12llu %8.3f\n", i, i == SIMULATE_GUESSES_MAX ? "+" : " ",
+				   (unsigned long long)stats.distribution[i], 100.0 * stats.distribution[i] / stats.games);
 	}
 
-	free(secret);
+	MATRIX_close(&matrix);
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+	printf("Welcome to Mastermind, coded by Adam Malek & Chris Hulme for Hardware-Software Interface.\n");
+
+	MM_parse_args(argc, argv);
+	if (build_matrix_path)
+		return MM_build_matrix();  // No game
+
+	if (!MM_seed() || !MM_start_stats())
+		return EXIT_FAILURE;
+	MM_open_matrix();
+	if (replay_path)
+		return MM_replay();  // Hardware only with --realtime
+	if (simulate_games)
+		return MM_simulate();  // No hardware needed
+	if (server_address)
+		return MM_serve();  // No hardware needed
+
+	if (!MM_init())
+	{
+		fprintf(stderr, "Failed to initialise the game. This program has to be run with sudo privileges\n");
+		exit(EXIT_FAILURE);
+	}
+
+	struct timer_wheel wheel;
+	TIMER_wheel_init(&wheel, TIMER_TICK_NS, GPIO_now());
+
+	// The game and its secret
+	struct arena arena;
+	if (ARENA_init(&arena, GAME_ARENA_SIZE(number_of_numbers) + ARENA_SIZE(number_of_numbers * sizeof(int))) != 0)
+		exit(EXIT_FAILURE);
+
+	struct game_settings settings = MM_settings();
+	struct game game;
+	if (GAME_init(&game, &settings, &MM_output, NULL, &wheel, &arena) != 0)
+		exit(EXIT_FAILURE);
+
+	if (debug)
+		MM_track_candidates(&settings);
+
+	int *secret = MM_generate_secret(&arena);
+
+	if (!secret)
+	{
+		fprintf(stderr, "Error - Not enough arena memory for the secret\n");
+		exit(EXIT_FAILURE);
+	}
+	if (debug)
+	{
+		printf("Seed: %llu\n", (unsigned long long)seed);
+		MM_output_numbers("Secret", secret, number_of_numbers);
+	}
+
+	struct trace trace;
+	bool recording = record_path &&
+		TRACE_create(&trace, record_path, &settings, seed, secret, GPIO_now()) == 0;
+
+	GAME_start(&game, secret);
+	MM_run(&game, &wheel, recording ? &trace : NULL);
+
+	if (recording && TRACE_close(&trace) == 0)
+		printf("Trace written to %s\n", record_path);
+
+	GAME_free(&game);
+	ARENA_free(&arena);
+	if (tracking)
+	{
+		CANDIDATES_free(&candidates);
+		CODE_set_free(&space);
+	}
+	MATRIX_close(&matrix);
+	LED_stop();  // Play the remaining LED animations before exiting
+	LCD_stop_async();  // Make sure the last screen is displayed before exiting
 	return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include "matrix.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../code/code.h"
+#include "../score/score.h"
+
+#define SUCCESS 0
+#define FAILURE -1
+
+#define BYTE_ORDER_MARK 0x01020304
+
+/**
+ * Returns the number of codes of the space, 0 if it is too large for a matrix
+*/
+static uint32_t count_codes(uint8_t numbers, uint8_t colours)
+{
+	if (numbers < 1 || numbers > CODE_NUMBERS_MAX || colours < 1 || colours > CODE_COLOURS_MAX ||
+		CODE_CLASSES(numbers) > UINT8_MAX + 1)
+		return 0;
+
+	uint64_t codes = 1;
+	for (uint8_t i = 0; i < numbers && codes <= MATRIX_CODES_MAX; i++)
+		codes *= colours;
+	return codes <= MATRIX_CODES_MAX ? codes : 0;
+}
+
+/**
+ * Writes the class bytes, one row (guess) at a time
+*/
+static int write_rows(FILE *file, uint8_t numbers, uint8_t colours, uint32_t codes)
+{
+	struct code_set set;
+	if (CODE_set_init(&set, numbers, codes) != SUCCESS)
+		return FAILURE;
+	for (uint32_t rank = 0; rank < codes; rank++)
+		CODE_set_add(&set, CODE_unrank(rank, numbers, colours));
+
+	uint16_t *scores = malloc(codes * sizeof(uint16_t));
+	uint8_t *row = malloc(codes);
+	int status = scores && row ? SUCCESS : FAILURE;
+	if (status != SUCCESS)
+		perror("Unable to allocate memory for a matrix row");
+
+	for (uint32_t guess = 0; guess < codes && status == SUCCESS; guess++)
+	{
+		CODE_score_many(set.codes[guess], &set, scores, NULL);
+		for (uint32_t secret = 0; secret < codes; secret++)
+			row[secret] = CODE_CLASS(scores[secret], numbers);
+
+		if (fwrite(row, 1, codes, file) != codes)
+		{
+			perror("Unable to write the matrix");
+			status = FAILURE;
+		}
+	}
+
+	free(scores);
+	free(row);
+	CODE_set_free(&set);
+	return status;
+}
+
+int MATRIX_build(const char *path, uint8_t numbers, uint8_t colours)
+{
+	uint32_t codes = count_codes(numbers, colours);
+	if (!codes)
+	{
+		fprintf(stderr, "Error - No matrix for %hhu numbers from 1 to %hhu (at most %d codes)\n",
+				numbers, colours, MATRIX_CODES_MAX);
+		return FAILURE;
+	}
+
+	// Written next to the destination, then renamed over it
+	size_t length = strlen(path) + sizeof(".tmp");
+	char *temporary = malloc(length);
+	if (!temporary)
+	{
+		perror("Unable to allocate memory for the file name");
+		return FAILURE;
+	}
+	snprintf(temporary, length, "%s.tmp", path);
+
+	FILE *file = fopen(temporary, "wb");
+	if (!file)
+	{
+		perror("Unable to create the matrix file");
+		free(temporary);
+		return FAILURE;
+	}
+
+	struct matrix_header header =
+	{
+		.magic = MATRIX_MAGIC,
+		.version = MATRIX_VERSION,
+		.byte_order = BYTE_ORDER_MARK,
+		.codes = codes,
+		.numbers = numbers,
+		.colours = colours,
+	};
+	int status = fwrite(&header, sizeof(header), 1, file) == 1 ? SUCCESS : FAILURE;
+	if (status == SUCCESS)
+		status = write_rows(file, numbers, colours, codes);
+	if (fclose(file) != 0)
+		status = FAILURE;
+
+	if (status == SUCCESS && rename(temporary, path) != 0)
+	{
+		perror("Unable to replace the matrix file");
+		status = FAILURE;
+	}
+	if (status != SUCCESS)
+		unlink(temporary);
+
+	free(temporary);
+	return status;
+}
+
+int MATRIX_open(struct matrix *matrix, const char *path)
+{
+	memset(matrix, 0, sizeof(*matrix));
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		perror("Unable to open the matrix file");
+		return FAILURE;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(struct matrix_header))
+	{
+		fprintf(stderr, "Error - %s is not a matrix file\n", path);
+		close(fd);
+		return FAILURE;
+	}
+
+	void *map = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);  // The mapping keeps the file
+	if (map == MAP_FAILED)
+	{
+		perror("Unable to map the matrix file");
+		return FAILURE;
+	}
+
+	const struct matrix_header *header = map;
+	uint32_t codes = count_codes(header->numbers, header->colours);
+	if (memcmp(header->magic, MATRIX_MAGIC, sizeof(MATRIX_MAGIC)) != 0 ||
+		header->version != MATRIX_VERSION || header->byte_order != BYTE_ORDER_MARK ||
+		!codes || header->codes != codes ||
+		(size_t)status.st_size != sizeof(*header) + (size_t)codes * codes)
+	{
+		fprintf(stderr, "Error - %s is not a version %d matrix file of this machine\n", path, MATRIX_VERSION);
+		munmap(map, status.st_size);
+		return FAILURE;
+	}
+
+	matrix->numbers = header->numbers;
+	matrix->colours = header->colours;
+	matrix->codes = codes;
+	matrix->classes = (const uint8_t *)map + sizeof(*header);
+	matrix->map = map;
+	matrix->map_size = status.st_size;
+
+	return SUCCESS;
+}
+
+void MATRIX_close(struct matrix *matrix)
+{
+	if (matrix->map)
+		munmap(matrix->map, matrix->map_size);
+	memset(matrix, 0, sizeof(*matrix));
+}
+
+bool MATRIX_covers(const struct matrix *matrix, uint8_t numbers, uint8_t colours)
+{
+	return matrix && matrix->classes && matrix->numbers == numbers && matrix->colours == colours;
+}
+
+/**
+ * Rank of a sequence of numbers from 1 to colours, see CODE_rank
+*/
+static uint32_t rank(const int numbers[], uint8_t size, uint8_t colours)
+{
+	uint32_t rank = 0;
+	for (uint8_t i = size; i-- > 0;)
+		rank = rank * colours + numbers[i] - 1;
+	return rank;
+}
+
+uint16_t MATRIX_score(const struct matrix *matrix, const int secret[], const int guess[])
+{
+	uint8_t class = MATRIX_class(matrix, rank(guess, matrix->numbers, matrix->colours),
+								 rank(secret, matrix->numbers, matrix->colours));
+	return SCORE_PACK(class / (matrix->numbers + 1), class % (matrix->numbers + 1));
+}
@@ -0,0 +1,85 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Precomputed feedback matrix.
+ * A file holds the score of every (guess, secret) pair of one code space
+ * (sequence length, maximum number) as one byte - the feedback class
+ * exact * (numbers + 1) + approx. Row g, column s is the score of the guess
+ * with rank g against the secret with rank s (see CODE_rank).
+ *
+ * The file is mapped read-only, so every process using the same file
+ * shares one copy in the page cache and nothing is computed at start.
+ *
+ * File layout (native byte order):
+ *   struct matrix_header, then codes * codes class bytes
+*/
+
+#define MATRIX_MAGIC "MMFBMAT"
+#define MATRIX_VERSION 1
+// Largest code space of a matrix, the file has codes^2 bytes
+#define MATRIX_CODES_MAX 65536
+
+struct matrix_header
+{
+	char magic[8];  // MATRIX_MAGIC
+	uint32_t version;  // MATRIX_VERSION
+	uint32_t byte_order;  // 0x01020304 written in the native byte order
+	uint32_t codes;  // colours^numbers
+	uint8_t numbers;
+	uint8_t colours;
+	uint8_t reserved[42];  // 0, pads the header to 64 bytes
+};
+
+struct matrix
+{
+	uint8_t numbers;
+	uint8_t colours;
+	uint32_t codes;
+	const uint8_t *classes;  // codes * codes
+	void *map;
+	size_t map_size;
+};
+
+/**
+ * Computes the matrix of the code space and writes it to path.
+ * The file is replaced atomically, readers never see a partial matrix.
+ * Returns 0 on success, -1 on failure.
+*/
+int MATRIX_build(const char *path, uint8_t numbers, uint8_t colours);
+
+/**
+ * Maps the matrix file read-only and checks its header.
+ * Returns 0 on success, -1 on failure.
+*/
+int MATRIX_open(struct matrix *matrix, const char *path);
+
+/**
+ * Unmaps the matrix
+*/
+void MATRIX_close(struct matrix *matrix);
+
+/**
+ * Returns true if the matrix has the scores of the given code space
+*/
+bool MATRIX_covers(const struct matrix *matrix, uint8_t numbers, uint8_t colours);
+
+/**
+ * Returns the packed score (see score.h) of the guess against the secret,
+ * both matrix->numbers numbers from 1 to matrix->colours
+*/
+uint16_t MATRIX_score(const struct matrix *matrix, const int secret[], const int guess[]);
+
+/**
+ * Returns the feedback class of the pair of ranks
+*/
+static inline uint8_t MATRIX_class(const struct matrix *matrix, uint32_t guess_rank, uint32_t secret_rank)
+{
+	return matrix->classes[(size_t)guess_rank * matrix->codes + secret_rank];
+}
+
+#endif
@@ -0,0 +1,349 @@
+#include "minimax.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../code/code.h"
+#include "../matrix/matrix.h"
+#include "../candidates/candidates.h"
+#include "../delay/delay.h"
+
+#define SUCCESS 0
+#define FAILURE -1
+
+// Candidates scored between two checks of the bound
+#define BLOCK 256
+// Worst case of a pruned guess
+#define PRUNED UINT32_MAX
+
+struct best
+{
+	uint32_t worst;  // PRUNED - no guess yet
+	bool candidate;
+	uint32_t rank;
+};
+
+struct search;
+
+struct worker
+{
+	pthread_t thread;
+	struct search *search;
+	uint32_t id;
+	_Atomic uint64_t range;  // next << 32 | end, the guess ranks left to the worker
+	struct best best;
+	uint64_t searched;
+	uint64_t pruned;
+	uint64_t symmetric;
+	uint32_t partitions[CODE_CLASSES(CODE_NUMBERS_MAX)];
+} __attribute__((aligned(64)));  // The ranges and histograms do not share cache lines
+
+struct search
+{
+	const struct candidates *candidates;
+	struct code_set set;  // The remaining candidates, compacted
+	uint32_t *ranks;  // Rank of every code of set
+	uint64_t deadline;
+	atomic_uint bound;  // Smallest worst case found so far
+	atomic_bool expired;
+	struct worker *workers;
+	uint32_t threads;
+};
+
+static uint64_t pack_range(uint32_t next, uint32_t end)
+{
+	return (uint64_t)next << 32 | end;
+}
+
+/**
+ * Takes the next guess of the worker's own range
+*/
+static bool pop(struct worker *worker, uint32_t *rank)
+{
+	uint64_t range = atomic_load(&worker->range);
+	for (;;)
+	{
+		uint32_t next = range >> 32;
+		uint32_t end = (uint32_t)range;
+		if (next >= end)
+			return false;
+		if (atomic_compare_exchange_weak(&worker->range, &range, pack_range(next + 1, end)))
+		{
+			*rank = next;
+			return true;
+		}
+	}
+}
+
+/**
+ * Takes the second half of the range of another worker, keeps the first
+ * guess of it and makes the rest the worker's own range.
+ * Only called when the own range is empty, which no other worker changes.
+*/
+static bool steal(struct worker *worker, uint32_t *rank)
+{
+	struct search *search = worker->search;
+	for (uint32_t i = 1; i < search->threads; i++)
+	{
+		struct worker *victim = &search->workers[(worker->id + i) % search->threads];
+		uint64_t range = atomic_load(&victim->range);
+		for (;;)
+		{
+			uint32_t next = range >> 32;
+			uint32_t end = (uint32_t)range;
+			if (next >= end)
+				break;
+
+			uint32_t split = end - (end - next + 1) / 2;
+			if (atomic_compare_exchange_weak(&victim->range, &range, pack_range(next, split)))
+			{
+				*rank = split;
+				atomic_store(&worker->range, pack_range(split + 1, end));
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/**
+ * Returns the size of the largest partition of the guess, PRUNED as soon
+ * as a partition is larger than bound
+*/
+static uint32_t worst_case(struct worker *worker, uint32_t guess_rank, uint32_t bound)
+{
+	const struct search *search = worker->search;
+	const struct code_set *set = &search->set;
+	const struct matrix *matrix = search->candidates->matrix;
+	uint32_t *partitions = worker->partitions;
+	memset(partitions, 0, CODE_CLASSES(set->size) * sizeof(uint32_t));
+
+	uint32_t worst = 0;
+	if (matrix)
+	{
+		const uint8_t *row = &matrix->classes[(size_t)guess_rank * matrix->codes];
+		for (uint32_t i = 0; i < set->length; i++)
+		{
+			uint32_t size = ++partitions[row[search->ranks[i]]];
+			if (size > worst && (worst = size) > bound)
+				return PRUNED;
+		}
+		return worst;
+	}
+
+	uint64_t guess = CANDIDATES_code(search->candidates, guess_rank);
+	for (uint32_t first = 0; first < set->length; first += BLOCK)
+	{
+		// The blocks start at a multiple of 2048 bytes, still aligned for the vector loads
+		uint32_t length = set->length - first < BLOCK ? set->length - first : BLOCK;
+		struct code_set block =
+		{
+			.size = set->size,
+			.length = length,
+			.capacity = length,
+			.codes = &set->codes[first],
+			.counts = {&set->counts[0][first], &set->counts[1][first]},
+		};
+		CODE_score_many(guess, &block, NULL, partitions);
+
+		for (size_t c = 0; c < CODE_CLASSES(set->size); c++)
+		{
+			if (partitions[c] > worst)
+				worst = partitions[c];
+		}
+		if (worst > bound)
+			return PRUNED;
+	}
+	return worst;
+}
+
+/**
+ * Returns true if a is a better guess than b
+*/
+static bool better(const struct best *a, const struct best *b)
+{
+	if (a->worst != b->worst)
+		return a->worst < b->worst;
+	if (a->candidate != b->candidate)
+		return a->candidate;
+	return a->rank < b->rank;
+}
+
+static void evaluate(struct worker *worker, uint32_t rank)
+{
+	struct search *search = worker->search;
+	unsigned int bound = atomic_load_explicit(&search->bound, memory_order_relaxed);
+	struct best guess = {.worst = worst_case(worker, rank, bound), .rank = rank};
+	if (guess.worst == PRUNED)
+	{
+		worker->pruned++;
+		return;
+	}
+
+	worker->searched++;
+	guess.candidate = CANDIDATES_contains(search->candidates, rank);
+	if (better(&guess, &worker->best))
+		worker->best = guess;
+
+	// Equal worst cases are not pruned, the tie break needs them
+	while (guess.worst < bound &&
+		   !atomic_compare_exchange_weak_explicit(&search->bound, &bound, guess.worst,
+												  memory_order_relaxed, memory_order_relaxed))
+		;
+}
+
+static bool expired(struct search *search)
+{
+	if (!search->deadline)
+		return false;
+	if (atomic_load_explicit(&search->expired, memory_order_relaxed))
+		return true;
+	if (DELAY_now() < search->deadline)
+		return false;
+
+	atomic_store_explicit(&search->expired, true, memory_order_relaxed);
+	return true;
+}
+
+static void *worker_loop(void *arg)
+{
+	struct worker *worker = arg;
+	const struct candidates *candidates = worker->search->candidates;
+	uint32_t rank;
+	while ((pop(worker, &rank) || steal(worker, &rank)) && !expired(worker->search))
+	{
+		if (CANDIDATES_canonical(candidates, CANDIDATES_code(candidates, rank)))
+			evaluate(worker, rank);
+		else
+			worker->symmetric++;
+	}
+	return NULL;
+}
+
+/**
+ * Copies the remaining candidates into a code set and a rank array
+*/
+static int compact(struct search *search)
+{
+	const struct candidates *candidates = search->candidates;
+	uint32_t count = CANDIDATES_count(candidates);
+	search->ranks = malloc(count * sizeof(uint32_t));
+	if (!search->ranks)
+	{
+		perror("Unable to allocate memory for the search");
+		return FAILURE;
+	}
+	if (CODE_set_init(&search->set, candidates->space->size, count) != SUCCESS)
+	{
+		free(search->ranks);
+		return FAILURE;
+	}
+
+	uint32_t i = 0;
+	for (uint32_t rank = CANDIDATES_next(candidates, 0); rank != CANDIDATES_END;
+		 rank = CANDIDATES_next(candidates, rank + 1))
+	{
+		search->ranks[i++] = rank;
+		CODE_set_add(&search->set, CANDIDATES_code(candidates, rank));
+	}
+	return SUCCESS;
+}
+
+int MINIMAX_search(const struct candidates *candidates, const struct minimax_config *config,
+				   struct minimax_result *result)
+{
+	memset(result, 0, sizeof(*result));
+	uint32_t count = CANDIDATES_count(candidates);
+	uint32_t codes = candidates->space->length;
+	if (!count)
+		return FAILURE;  // Inconsistent feedback
+
+	result->complete = true;
+	if (count <= 2)
+	{
+		// Either candidate splits the other one off, the first one may win
+		result->rank = CANDIDATES_next(candidates, 0);
+		result->guess = CANDIDATES_code(candidates, result->rank);
+		result->worst = 1;
+		return SUCCESS;
+	}
+
+	uint32_t threads = config->threads;
+	if (!threads)
+	{
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = online > 0 ? online : 1;
+	}
+	if (threads > codes)
+		threads = codes;
+
+	struct search search =
+	{
+		.candidates = candidates,
+		.deadline = config->deadline,
+		.bound = count,
+		.threads = threads,
+	};
+	if (compact(&search) != SUCCESS)
+		return FAILURE;
+	search.workers = aligned_alloc(64, threads * sizeof(struct worker));
+	if (!search.workers)
+	{
+		perror("Unable to allocate memory for the search");
+		CODE_set_free(&search.set);
+		free(search.ranks);
+		return FAILURE;
+	}
+
+	for (uint32_t t = 0; t < threads; t++)
+	{
+		struct worker *worker = &search.workers[t];
+		memset(worker, 0, sizeof(*worker));
+		worker->search = &search;
+		worker->id = t;
+		worker->best.worst = PRUNED;
+		atomic_init(&worker->range, pack_range((uint64_t)codes * t / threads, (uint64_t)codes * (t + 1) / threads));
+	}
+
+	// The calling thread is worker 0, the others start here
+	uint32_t started = 1;
+	for (; started < threads; started++)
+	{
+		if (pthread_create(&search.workers[started].thread, NULL, worker_loop, &search.workers[started]) != 0)
+			break;  // The started workers steal the guesses of the others
+	}
+	worker_loop(&search.workers[0]);
+
+	struct best best = {.worst = PRUNED};
+	for (uint32_t t = 0; t < threads; t++)
+	{
+		if (t && t < started)
+			pthread_join(search.workers[t].thread, NULL);
+		if (better(&search.workers[t].best, &best))
+			best = search.workers[t].best;
+		result->searched += search.workers[t].searched;
+		result->pruned += search.workers[t].pruned;
+		result->symmetric += search.workers[t].symmetric;
+	}
+
+	result->complete = !atomic_load(&search.expired);
+	if (best.worst == PRUNED)
+	{
+		// Nothing searched before the deadline, any candidate is consistent
+		best.rank = search.ranks[0];
+		best.worst = count;
+	}
+	result->rank = best.rank;
+	result->guess = CANDIDATES_code(candidates, best.rank);
+	result->worst = best.worst;
+	result->threads = started;
+
+	free(search.workers);
+	CODE_set_free(&search.set);
+	free(search.ranks);
+	return SUCCESS;
+}
@@ -0,0 +1,53 @@
+#ifndef MINIMAX_H
+#define MINIMAX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../candidates/candidates.h"
+
+/**
+ * Next guess search of Knuth's minimax strategy: the guess (any code of the
+ * space) whose largest feedback partition of the remaining candidates is
+ * the smallest.
+ *
+ * The guesses are split between worker threads in ranges of ranks. A worker
+ * which runs out of guesses steals the second half of the range of another
+ * one, so the threads finish together even though pruned guesses are much
+ * cheaper than the others. Every worker counts the partitions in its own
+ * histogram. A guess is dropped as soon as one of its partitions is larger
+ * than the smallest worst case found by any worker so far. Guesses which
+ * only swap numbers none of the guesses so far had are searched once, so
+ * the first guess of 5 numbers from 1 to 8 is one of 52 instead of 32768.
+ *
+ * The result does not depend on the number of threads or the order the
+ * guesses are searched in: ties are broken in favour of the candidates,
+ * then of the lowest rank. Only a search cut short by its deadline can
+ * return another guess.
+*/
+
+struct minimax_config
+{
+	uint32_t threads;  // 0 - one per online CPU
+	uint64_t deadline;  // DELAY_now time the search stops at, 0 - none
+};
+
+struct minimax_result
+{
+	uint64_t guess;  // Packed, see code.h
+	uint32_t rank;
+	uint32_t worst;  // Size of the largest partition of the guess
+	bool complete;  // false - the deadline expired, best guess of the searched ones
+	uint64_t searched;  // Guesses whose partitions were all counted
+	uint64_t pruned;  // Guesses dropped early
+	uint64_t symmetric;  // Guesses skipped, the same as a searched one with other unused numbers
+	uint32_t threads;
+};
+
+/**
+ * Searches the next guess for the remaining candidates.
+ * Returns 0 on success, -1 on failure (no candidates left, or no memory).
+*/
+int MINIMAX_search(const struct candidates *candidates, const struct minimax_config *config,
+				   struct minimax_result *result);
+
+#endif
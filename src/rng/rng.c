@@ -0,0 +1,108 @@
+#include "rng.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t splitmix64(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+void RNG_seed(struct rng *rng, uint64_t seed)
+{
+	// splitmix64 never gives four zero words, the only state xoshiro cannot leave
+	for (size_t i = 0; i < 4; i++)
+		rng->s[i] = splitmix64(&seed);
+}
+
+uint64_t RNG_entropy(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	uint64_t state = (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+	state ^= (uint64_t)getpid() << 32;
+	state ^= (uintptr_t)&now;  // Differs with address space randomisation
+	return splitmix64(&state);
+}
+
+void RNG_jump(struct rng *rng)
+{
+	static const uint64_t jump[] =
+	{
+		0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull, 0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull,
+	};
+
+	uint64_t s[4] = {0};
+	for (size_t i = 0; i < sizeof(jump) / sizeof(jump[0]); i++)
+	{
+		for (int b = 0; b < 64; b++)
+		{
+			if (jump[i] & (1ull << b))
+			{
+				for (size_t k = 0; k < 4; k++)
+					s[k] ^= rng->s[k];
+			}
+			RNG_next(rng);
+		}
+	}
+	for (size_t k = 0; k < 4; k++)
+		rng->s[k] = s[k];
+}
+
+/**
+ * Lemire's bounded number from 32 random bits x, threshold is
+ * (2^32 - bound) % bound. Rejected numbers are replaced from rng.
+*/
+static inline uint32_t bounded(struct rng *rng, uint32_t x, uint32_t bound, uint32_t threshold)
+{
+	uint64_t m = (uint64_t)x * bound;
+	while ((uint32_t)m < threshold)
+		m = (uint64_t)(uint32_t)(RNG_next(rng) >> 32) * bound;
+	return m >> 32;
+}
+
+uint32_t RNG_bounded(struct rng *rng, uint32_t bound)
+{
+	uint32_t x = RNG_next(rng) >> 32;
+	uint64_t m = (uint64_t)x * bound;
+	if ((uint32_t)m >= bound)
+		return m >> 32;  // Above every possible threshold, no division needed
+
+	return bounded(rng, x, bound, -bound % bound);
+}
+
+void RNG_code(struct rng *rng, int code[], uint8_t size, uint8_t max)
+{
+	for (uint8_t i = 0; i < size; i++)
+		code[i] = RNG_bounded(rng, max) + 1;
+}
+
+void RNG_codes(struct rng *rng, uint64_t codes[], size_t count, uint8_t size, uint8_t max)
+{
+	uint32_t threshold = -(uint32_t)max % max;  // Computed once for the whole batch
+	uint64_t bits = 0;
+	int halves = 0;  // 32-bit halves of bits not used yet
+
+	for (size_t c = 0; c < count; c++)
+	{
+		uint64_t code = 0;
+		for (uint8_t i = 0; i < size; i++)
+		{
+			if (!halves)
+			{
+				bits = RNG_next(rng);
+				halves = 2;
+			}
+			uint32_t x = bits >> 32;
+			bits <<= 32;
+			halves--;
+
+			code |= (uint64_t)(bounded(rng, x, max, threshold) + 1) << (i * 4);
+		}
+		codes[c] = code;
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Pseudo-random numbers, xoshiro256** (Blackman, Vigna).
+ * The state is explicit, every thread (or server, or game) keeps its own
+ * and nothing is shared. The same seed always gives the same numbers.
+ * Bounded numbers are unbiased (Lemire's multiply and reject), codes
+ * are numbers from 1 to the maximum number.
+*/
+
+struct rng
+{
+	uint64_t s[4];
+};
+
+/**
+ * Initialises the state from a 64-bit seed (expanded with splitmix64)
+*/
+void RNG_seed(struct rng *rng, uint64_t seed);
+
+/**
+ * Returns a seed which differs between runs and processes
+*/
+uint64_t RNG_entropy(void);
+
+/**
+ * Moves the state 2^128 numbers forward.
+ * Copies of one state jumped 0, 1, 2 .. times give independent streams,
+ * one per thread.
+*/
+void RNG_jump(struct rng *rng);
+
+static inline uint64_t RNG_rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+/**
+ * Returns the next 64 random bits
+*/
+static inline uint64_t RNG_next(struct rng *rng)
+{
+	uint64_t *s = rng->s;
+	uint64_t result = RNG_rotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = RNG_rotl(s[3], 45);
+
+	return result;
+}
+
+/**
+ * Returns a number from 0 to bound - 1 (bound above 0), every one
+ * equally likely
+*/
+uint32_t RNG_bounded(struct rng *rng, uint32_t bound);
+
+/**
+ * Writes size numbers from 1 to max
+*/
+void RNG_code(struct rng *rng, int code[], uint8_t size, uint8_t max);
+
+/**
+ * Fills codes with count packed codes (see code.h) of size numbers
+ * from 1 to max (at most CODE_NUMBERS_MAX and CODE_COLOURS_MAX)
+*/
+void RNG_codes(struct rng *rng, uint64_t codes[], size_t count, uint8_t size, uint8_t max);
+
+#endif
@@ -0,0 +1,153 @@
+#include "score.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+uint16_t SCORE_calculate(const int secret[], const int guess[], size_t size, uint8_t colours)
+{
+	/*
+	 * counts[c] > 0 - the secret has unmatched c's, counts[c] < 0 - the guess has.
+	 * A number of the guess meeting an unmatched number of the secret
+	 * (or the other way around) is an approximate match.
+	*/
+	int16_t counts[SCORE_COLOURS_MAX + 1];
+	memset(counts, 0, (colours + 1) * sizeof(counts[0]));
+
+	uint8_t exact = 0;
+	uint8_t approx = 0;
+	for (size_t i = 0; i < size; i++)
+	{
+		if (secret[i] == guess[i])
+		{
+			exact++;
+			continue;
+		}
+
+		approx += counts[secret[i]]++ < 0;
+		approx += counts[guess[i]]-- > 0;
+	}
+
+	return SCORE_PACK(exact, approx);
+}
+
+/*
+ * Unrolled kernels. The same counting as SCORE_calculate, but the counts of
+ * the exact matches are changed by 0 instead of skipped, so the body has no
+ * branches, and only the counts of the numbers of the two sequences are
+ * cleared instead of all of them.
+*/
+
+#define SCORE_REPEAT_1(step) step(0)
+#define SCORE_REPEAT_2(step) SCORE_REPEAT_1(step) step(1)
+#define SCORE_REPEAT_3(step) SCORE_REPEAT_2(step) step(2)
+#define SCORE_REPEAT_4(step) SCORE_REPEAT_3(step) step(3)
+#define SCORE_REPEAT_5(step) SCORE_REPEAT_4(step) step(4)
+#define SCORE_REPEAT_6(step) SCORE_REPEAT_5(step) step(5)
+#define SCORE_REPEAT_7(step) SCORE_REPEAT_6(step) step(6)
+#define SCORE_REPEAT_8(step) SCORE_REPEAT_7(step) step(7)
+
+#define SCORE_CLEAR(i) \
+	counts[secret[i]] = 0; \
+	counts[guess[i]] = 0;
+
+#define SCORE_STEP(i) \
+	{ \
+		int same = secret[i] == guess[i]; \
+		int differ = !same; \
+		exact += same; \
+		approx += differ & (counts[secret[i]] < 0); \
+		counts[secret[i]] += differ; \
+		approx += differ & (counts[guess[i]] > 0); \
+		counts[guess[i]] -= differ; \
+	}
+
+#define SCORE_UNROLLED(n) \
+	static uint16_t score_##n(const int secret[], const int guess[], size_t size, uint8_t colours) \
+	{ \
+		(void)size; \
+		(void)colours; \
+		int16_t counts[SCORE_COLOURS_MAX + 1]; \
+		uint8_t exact = 0; \
+		uint8_t approx = 0; \
+		SCORE_REPEAT_##n(SCORE_CLEAR) \
+		SCORE_REPEAT_##n(SCORE_STEP) \
+		return SCORE_PACK(exact, approx); \
+	}
+
+SCORE_UNROLLED(1)
+SCORE_UNROLLED(2)
+SCORE_UNROLLED(3)
+SCORE_UNROLLED(4)
+SCORE_UNROLLED(5)
+SCORE_UNROLLED(6)
+SCORE_UNROLLED(7)
+SCORE_UNROLLED(8)
+
+// Kernel of every length up to SCORE_UNROLLED_MAX
+static const score_kernel unrolled[SCORE_UNROLLED_MAX + 1] =
+{
+	SCORE_calculate,  // Nothing to score
+	score_1,
+	score_2,
+	score_3,
+	score_4,
+	score_5,
+	score_6,
+	score_7,
+	score_8,
+};
+
+score_kernel SCORE_kernel(size_t size)
+{
+	return size <= SCORE_UNROLLED_MAX ? unrolled[size] : SCORE_calculate;
+}
+
+void SCORE_reference(int *exact, int *approx, const int secret[], const int guess[], size_t size)
+{
+	/*
+	 * The algorithm creates a bool array of size N.
+	 * This is done to solve the issue where a loop
+	 * for approximate matches would count the same
+	 * number twice.
+	*/
+	bool *counted = calloc(size, sizeof(bool));  // Create the array, initialised with 0s (false)
+	if (!counted)
+	{
+		perror("Unable to allocate memory for the matches");
+		return;
+	}
+
+	for (size_t i = 0; i < size; i++)
+	{
+		if (guess[i] == secret[i])
+		{
+			(*exact)++;
+			/*
+			 * It may happen that secret[i] was already checked and counted as an approximate match
+			 * Therefore, if the counted flag at position i is true we need to decrement the number
+			 * of approximate matches because this number will be actually an exact match.
+			*/
+			if (counted[i])
+				(*approx)--;
+
+			counted[i] = true;
+		}
+		else
+		{
+			// Check if the number exists somewhere else in the array
+			for (size_t j = 0; j < size; j++)
+			{
+				if (guess[i] == secret[j] && !counted[j])  // If the same and not already counted
+				{
+					counted[j] = true;
+					(*approx)++;
+					break;  // Found a match for guess[i] - exit the loop and get the next guess number
+				}
+			}
+		}
+	}
+
+	free(counted);
+}
@@ -0,0 +1,56 @@
+#ifndef SCORE_H
+#define SCORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Scoring of a guess - the number of exact matches (right number in the
+ * right position) and approximate matches (right number, wrong position).
+ *
+ * Both counts are packed into one value: the exact matches in the high byte
+ * and the approximate matches in the low byte.
+*/
+
+// Longest sequence that can be scored (the counts have to fit in a byte)
+#define SCORE_NUMBERS_MAX 255
+// Largest number (colour) that can be scored
+#define SCORE_COLOURS_MAX 255
+
+// Longest sequence with its own unrolled kernel, see SCORE_kernel
+#define SCORE_UNROLLED_MAX 8
+
+#define SCORE_PACK(exact, approx) ((uint16_t)((exact) << 8 | (approx)))
+#define SCORE_EXACT(score) ((uint8_t)((score) >> 8))
+#define SCORE_APPROX(score) ((uint8_t)((score) & 0xFF))
+
+/**
+ * Returns the packed score of the guess.
+ * Runs in O(size + colours) without any memory allocation.
+ * size - sequence length, at most SCORE_NUMBERS_MAX
+ * colours - the numbers of the secret and guess are from 0 to colours,
+ *           at most SCORE_COLOURS_MAX
+*/
+uint16_t SCORE_calculate(const int secret[], const int guess[], size_t size, uint8_t colours);
+
+/**
+ * Scoring function with the arguments and result of SCORE_calculate
+*/
+typedef uint16_t (*score_kernel)(const int secret[], const int guess[], size_t size, uint8_t colours);
+
+/**
+ * Returns the fastest kernel for sequences of exactly size numbers.
+ * Sizes 1 to SCORE_UNROLLED_MAX have a kernel unrolled for their length
+ * without branches (which also ignores colours), longer ones get
+ * SCORE_calculate. Meant to be called once, when the length is known.
+*/
+score_kernel SCORE_kernel(size_t size);
+
+/**
+ * The original O(size^2) algorithm of the game, kept as the reference
+ * the faster implementations are checked against.
+ * Adds the matches to exact and approx, does nothing if it runs out of memory.
+*/
+void SCORE_reference(int *exact, int *approx, const int secret[], const int guess[], size_t size);
+
+#endif
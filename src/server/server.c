@@ -0,0 +1,645 @@
+#define _GNU_SOURCE  // accept4
+
+#include "server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include "../timer/timer.h"
+#include "../rng/rng.h"
+#include "../arena/arena.h"
+#include "../timeunits.h"
+
+#define SUCCESS 0
+#define FAILURE -1
+
+// Longest request line, GUESS with SERVER_NUMBERS_MAX numbers fits
+#define LINE_LENGTH_MAX 128
+// Replies waiting to be sent to one client
+#define OUT_LENGTH_MAX 256
+// Arena of a session, a game of the longest sequence fits
+#define SESSION_ARENA_SIZE GAME_ARENA_SIZE(SERVER_NUMBERS_MAX)
+// Events handled per epoll_wait
+#define EVENTS_MAX 256
+// Resolution of the session timers
+#define TIMER_TICK_NS MS_TO_NS(100)
+// Clients without a request for this long are disconnected
+#define IDLE_TIMEOUT_S 300
+
+struct session
+{
+	int fd;  // -1 - the session is free
+	bool playing;  // The game has been initialised by NEW
+	bool writing;  // Waiting for EPOLLOUT to send the rest of out
+	struct game game;
+	struct arena arena;  // Memory of the game, reset by every NEW
+	struct timer idle_timer;
+	// Result of the last guess, set by the game output
+	uint8_t exact;
+	uint8_t approx;
+	const char *result;
+	uint16_t in_length;
+	uint16_t out_length;
+	char in[LINE_LENGTH_MAX];
+	char out[OUT_LENGTH_MAX];
+	struct session *next_free;
+};
+
+// All the sessions are allocated at once, unused ones are on the free list
+static struct session *sessions;
+static struct session *free_sessions;
+// Closed during the current iteration, reused from the next one
+static struct session *closed_sessions;
+// Memory of the arenas of all the sessions
+static struct arena session_memory;
+
+static const struct server_config *server;
+static struct timer_wheel wheel;
+static struct rng rng;  // Secrets of all the sessions
+static int epoll_fd = -1;
+static int listen_fd = -1;
+static atomic_int stop_fd = -1;
+
+// epoll data of the descriptors which are not sessions
+static char listen_tag;
+static char stop_tag;
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * SEC_TO_NS(1u) + now.tv_nsec;
+}
+
+static void on_feedback(void *context, uint8_t exact, uint8_t approx)
+{
+	struct session *session = context;
+	session->exact = exact;
+	session->approx = approx;
+	session->result = "CONTINUE";
+}
+
+static void on_success(void *context, uint8_t rounds)
+{
+	(void)rounds;
+	struct session *session = context;
+	session->exact = session->game.settings.numbers;
+	session->approx = 0;
+	session->result = "WIN";
+}
+
+static void on_game_over(void *context, uint8_t rounds)
+{
+	(void)rounds;
+	struct session *session = context;
+	session->result = "OVER";
+}
+
+static const struct game_output output =
+{
+	.feedback = on_feedback,
+	.success = on_success,
+	.game_over = on_game_over,
+};
+
+static void close_session(struct session *session)
+{
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, session->fd, NULL);
+	close(session->fd);
+	session->fd = -1;
+	TIMER_cancel(&wheel, &session->idle_timer);
+	if (session->playing)
+		GAME_free(&session->game);
+	session->playing = false;
+
+	// Events of this iteration may still point to the session
+	session->next_free = closed_sessions;
+	closed_sessions = session;
+}
+
+static void on_idle_timeout(struct timer *timer, uint64_t now)
+{
+	(void)now;
+	close_session(timer->context);
+}
+
+/**
+ * Sends as much of the pending replies as the socket takes.
+ * Returns -1 if the client is gone.
+*/
+static int flush_replies(struct session *session)
+{
+	while (session->out_length)
+	{
+		ssize_t sent = send(session->fd, session->out, session->out_length, MSG_NOSIGNAL);
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				return FAILURE;
+			break;
+		}
+		session->out_length -= sent;
+		memmove(session->out, session->out + sent, session->out_length);
+	}
+
+	// Only wait for EPOLLOUT while there is something to send
+	bool writing = session->out_length != 0;
+	if (writing != session->writing)
+	{
+		struct epoll_event event =
+		{
+			.events = EPOLLIN | (writing ? EPOLLOUT : 0),
+			.data.ptr = session,
+		};
+		epoll_ctl(epoll_fd, EPOLL_CTL_MOD, session->fd, &event);
+		session->writing = writing;
+	}
+
+	return SUCCESS;
+}
+
+/**
+ * Queues a reply line. Returns -1 if the client does not read its replies.
+*/
+static int reply(struct session *session, const char *format, ...)
+{
+	size_t space = sizeof(session->out) - session->out_length;
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(session->out + session->out_length, space, format, args);
+	va_end(args);
+
+	if (length < 0 || (size_t)length >= space)
+		return FAILURE;
+	session->out_length += length;
+
+	return SUCCESS;
+}
+
+/**
+ * Parses a number between min and max.
+ * Returns false if the token is not a number or it is out of range.
+*/
+static bool parse_number(const char *token, long min, long max, long *value)
+{
+	if (!token)
+		return false;
+
+	char *end;
+	errno = 0;
+	*value = strtol(token, &end, 10);
+	return errno == 0 && end != token && *end == '\0' && *value >= min && *value <= max;
+}
+
+/**
+ * Parses the next number of the request, see parse_number
+*/
+static bool next_number(char **save, long min, long max, long *value)
+{
+	return parse_number(strtok_r(NULL, " \t\r", save), min, max, value);
+}
+
+static int new_game(struct session *session, char **save)
+{
+	struct game_settings settings = server->settings;
+	long numbers, max, rounds;
+	char *token = strtok_r(NULL, " \t\r", save);
+	if (token)  // Settings given
+	{
+		if (!parse_number(token, 1, SERVER_NUMBERS_MAX, &numbers) ||
+			!next_number(save, 1, UINT8_MAX, &max) ||
+			!next_number(save, 1, UINT8_MAX, &rounds))
+			return reply(session, "ERROR expected NEW n c r\n");
+		settings.numbers = numbers;
+		settings.max = max;
+		settings.rounds = rounds;
+	}
+
+	if (session->playing)
+		GAME_free(&session->game);
+	ARENA_reset(&session->arena);
+	session->playing = GAME_init(&session->game, &settings, &output, session, &wheel, &session->arena) == SUCCESS;
+	if (!session->playing)
+		return reply(session, "ERROR out of memory\n");
+
+	int secret[SERVER_NUMBERS_MAX];
+	RNG_code(&rng, secret, settings.numbers, settings.max);
+	GAME_start(&session->game, secret);
+
+	return reply(session, "OK %hhu %hhu %hhu\n", settings.numbers, settings.max, settings.rounds);
+}
+
+static int guess(struct session *session, char **save)
+{
+	if (!session->playing)
+		return reply(session, "ERROR no game, send NEW first\n");
+
+	const struct game_settings *settings = &session->game.settings;
+	int guess[SERVER_NUMBERS_MAX];
+	for (uint8_t i = 0; i < settings->numbers; i++)
+	{
+		long number;
+		if (!next_number(save, 1, settings->max, &number))
+			return reply(session, "ERROR expected %hhu numbers from 1 to %hhu\n",
+						 settings->numbers, settings->max);
+		guess[i] = number;
+	}
+	if (strtok_r(NULL, " \t\r", save))
+		return reply(session, "ERROR expected %hhu numbers from 1 to %hhu\n",
+					 settings->numbers, settings->max);
+
+	if (GAME_submit_guess(&session->game, guess) != SUCCESS)
+		return reply(session, "ERROR game over, send NEW\n");
+
+	return reply(session, "%hhu %hhu %s\n", session->exact, session->approx, session->result);
+}
+
+/**
+ * Handles one request line. Returns -1 if the session has to be closed.
+*/
+static int handle_request(struct session *session, char *line)
+{
+	char *save;
+	char *command = strtok_r(line, " \t\r", &save);
+	if (!command)
+		return SUCCESS;  // Empty line
+
+	if (strcmp(command, "GUESS") == 0)
+		return guess(session, &save);
+	if (strcmp(command, "NEW") == 0)
+		return new_game(session, &save);
+	if (strcmp(command, "QUIT") == 0)
+		return FAILURE;
+
+	return reply(session, "ERROR unknown command %.16s\n", command);
+}
+
+/**
+ * Reads the requests of the client and answers the complete lines
+*/
+static int read_requests(struct session *session)
+{
+	ssize_t received = recv(session->fd, session->in + session->in_length,
+							sizeof(session->in) - session->in_length, 0);
+	if (received == 0)
+		return FAILURE;  // Disconnected
+	if (received < 0)
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? SUCCESS : FAILURE;
+	session->in_length += received;
+
+	TIMER_schedule(&wheel, &session->idle_timer, now_ns() + SEC_TO_NS((uint64_t)IDLE_TIMEOUT_S));
+
+	char *line = session->in;
+	char *end;
+	while ((end = memchr(line, '\n', session->in + session->in_length - line)))
+	{
+		*end = '\0';
+		if (handle_request(session, line) != SUCCESS)
+			return FAILURE;
+		line = end + 1;
+	}
+
+	// Keep the incomplete line for the next read
+	session->in_length -= line - session->in;
+	memmove(session->in, line, session->in_length);
+	if (session->in_length == sizeof(session->in))
+		return FAILURE;  // The line does not fit
+
+	return SUCCESS;
+}
+
+static void session_event(struct session *session, uint32_t events)
+{
+	if (session->fd < 0)
+		return;  // Closed earlier in this iteration
+
+	if ((events & EPOLLIN) && read_requests(session) != SUCCESS)
+	{
+		flush_replies(session);  // Best effort, for example the error of a too long line
+		close_session(session);
+		return;
+	}
+	if ((events & (EPOLLERR | EPOLLHUP)) && !(events & EPOLLIN))
+	{
+		close_session(session);
+		return;
+	}
+	if (flush_replies(session) != SUCCESS)
+		close_session(session);
+}
+
+static void accept_clients(void)
+{
+	for (;;)
+	{
+		int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				perror("Unable to accept a client");
+			return;
+		}
+
+		struct session *session = free_sessions;
+		if (!session)
+		{
+			close(fd);  // Full
+			continue;
+		}
+
+		struct epoll_event event =
+		{
+			.events = EPOLLIN,
+			.data.ptr = session,
+		};
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+		{
+			perror("Unable to watch a client");
+			close(fd);
+			continue;
+		}
+
+		free_sessions = session->next_free;
+		session->fd = fd;
+		session->writing = false;
+		session->in_length = 0;
+		session->out_length = 0;
+		TIMER_schedule(&wheel, &session->idle_timer, now_ns() + SEC_TO_NS((uint64_t)IDLE_TIMEOUT_S));
+	}
+}
+
+/**
+ * Parses a TCP port number, returns false if the text is not one
+*/
+static bool parse_port(const char *text, uint16_t *port)
+{
+	char *end;
+	unsigned long number = strtoul(text, &end, 10);
+	if (end == text || *end != '\0' || number == 0 || number > UINT16_MAX)
+		return false;
+
+	*port = number;
+	return true;
+}
+
+int SERVER_parse_address(const char *address, struct server_config *config)
+{
+	const char *colon = strrchr(address, ':');
+	if (parse_port(address, &config->port))
+	{
+		config->path = NULL;
+		config->host = 0;
+		return SUCCESS;
+	}
+	if (!colon || colon == address || !parse_port(colon + 1, &config->port))
+	{
+		config->path = address;  // Not a port number
+		return SUCCESS;
+	}
+
+	char host[256];
+	snprintf(host, sizeof(host), "%.*s", (int)(colon - address), address);
+	struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+	struct addrinfo *result;
+	int error = getaddrinfo(host, NULL, &hints, &result);
+	if (error)
+	{
+		fprintf(stderr, "Error - Unable to resolve %s: %s\n", host, gai_strerror(error));
+		return FAILURE;
+	}
+
+	config->path = NULL;
+	config->host = ntohl(((struct sockaddr_in *)result->ai_addr)->sin_addr.s_addr);
+	freeaddrinfo(result);
+	return SUCCESS;
+}
+
+socklen_t SERVER_socket_address(const struct server_config *config, struct sockaddr_storage *address)
+{
+	memset(address, 0, sizeof(*address));
+	if (config->path)
+	{
+		struct sockaddr_un *unix_address = (struct sockaddr_un *)address;
+		if (strlen(config->path) >= sizeof(unix_address->sun_path))
+		{
+			fprintf(stderr, "Error - Socket path %s is too long\n", config->path);
+			return 0;
+		}
+		unix_address->sun_family = AF_UNIX;
+		strcpy(unix_address->sun_path, config->path);
+		return sizeof(*unix_address);
+	}
+
+	struct sockaddr_in *inet_address = (struct sockaddr_in *)address;
+	inet_address->sin_family = AF_INET;
+	inet_address->sin_port = htons(config->port);
+	inet_address->sin_addr.s_addr = htonl(config->host ? config->host : INADDR_LOOPBACK);
+	return sizeof(*inet_address);
+}
+
+static int open_listener(void)
+{
+	struct sockaddr_storage address;
+	socklen_t length = SERVER_socket_address(server, &address);
+	if (!length)
+		return FAILURE;
+
+	listen_fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0)
+		return FAILURE;
+	if (server->path)
+	{
+		unlink(server->path);  // Left over by a previous run
+	}
+	else
+	{
+		int reuse = 1;
+		setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	}
+	if (bind(listen_fd, (struct sockaddr *)&address, length) != 0)
+		return FAILURE;
+
+	return listen(listen_fd, SOMAXCONN);
+}
+
+static int watch(int fd, void *tag)
+{
+	struct epoll_event event =
+	{
+		.events = EPOLLIN,
+		.data.ptr = tag,
+	};
+	return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+/**
+ * Creates the session arena, the listener and the epoll instance
+*/
+static int start(void)
+{
+	sessions = calloc(server->max_sessions, sizeof(*sessions));
+	if (!sessions)
+	{
+		perror("Unable to allocate memory for the sessions");
+		return FAILURE;
+	}
+	if (ARENA_init(&session_memory, (size_t)server->max_sessions * SESSION_ARENA_SIZE) != SUCCESS)
+		return FAILURE;
+	free_sessions = NULL;
+	closed_sessions = NULL;
+	for (uint32_t i = server->max_sessions; i-- > 0;)
+	{
+		sessions[i].fd = -1;
+		ARENA_init_memory(&sessions[i].arena, ARENA_alloc(&session_memory, SESSION_ARENA_SIZE),
+						  SESSION_ARENA_SIZE);
+		TIMER_init(&sessions[i].idle_timer, on_idle_timeout, &sessions[i]);
+		sessions[i].next_free = free_sessions;
+		free_sessions = &sessions[i];
+	}
+	TIMER_wheel_init(&wheel, TIMER_TICK_NS, now_ns());
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0)
+	{
+		perror("Unable to create the epoll instance");
+		return FAILURE;
+	}
+	int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd < 0 || watch(fd, &stop_tag) != 0)
+	{
+		perror("Unable to create the stop event");
+		return FAILURE;
+	}
+	atomic_store(&stop_fd, fd);
+
+	if (open_listener() != 0 || watch(listen_fd, &listen_tag) != 0)
+	{
+		perror("Unable to open the server socket");
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+static void finish(void)
+{
+	if (sessions)
+	{
+		for (uint32_t i = 0; i < server->max_sessions; i++)
+		{
+			if (sessions[i].fd >= 0)
+				close_session(&sessions[i]);
+		}
+		free(sessions);
+		sessions = NULL;
+	}
+	ARENA_free(&session_memory);
+
+	if (listen_fd >= 0)
+	{
+		close(listen_fd);
+		if (server->path)
+			unlink(server->path);
+		listen_fd = -1;
+	}
+
+	int fd = atomic_exchange(&stop_fd, -1);
+	if (fd >= 0)
+		close(fd);
+	if (epoll_fd >= 0)
+		close(epoll_fd);
+	epoll_fd = -1;
+}
+
+/**
+ * Converts the time until the next timer expires to an epoll_wait timeout
+*/
+static int timeout_ms(uint64_t now)
+{
+	uint64_t expires = TIMER_next_expiry(&wheel);
+	if (expires == TIMER_NONE)
+		return -1;
+	if (expires <= now)
+		return 0;
+
+	uint64_t timeout = (expires - now + MS_TO_NS(1) - 1) / MS_TO_NS(1);  // Round up
+	return timeout > INT32_MAX ? INT32_MAX : (int)timeout;
+}
+
+int SERVER_run(const struct server_config *config)
+{
+	server = config;
+	RNG_seed(&rng, config->seed);
+	if (start() != SUCCESS)
+	{
+		finish();
+		return FAILURE;
+	}
+
+	int status = SUCCESS;
+	bool running = true;
+	while (running)
+	{
+		uint64_t now = now_ns();
+		TIMER_advance(&wheel, now);
+
+		// Sessions closed in the previous iteration can be reused now
+		while (closed_sessions)
+		{
+			struct session *session = closed_sessions;
+			closed_sessions = session->next_free;
+			session->next_free = free_sessions;
+			free_sessions = session;
+		}
+
+		struct epoll_event events[EVENTS_MAX];
+		int count = epoll_wait(epoll_fd, events, EVENTS_MAX, timeout_ms(now));
+		if (count < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("Unable to wait for the clients");
+			status = FAILURE;
+			break;
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			if (events[i].data.ptr == &stop_tag)
+				running = false;
+			else if (events[i].data.ptr == &listen_tag)
+				accept_clients();
+			else
+				session_event(events[i].data.ptr, events[i].events);
+		}
+	}
+
+	finish();
+	return status;
+}
+
+void SERVER_stop(void)
+{
+	int fd = atomic_load(&stop_fd);
+	if (fd >= 0)
+	{
+		uint64_t one = 1;
+		ssize_t written = write(fd, &one, sizeof(one));
+		(void)written;  // Fails only if it has been signalled many times already
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include "../game/game.h"
+
+/**
+ * Mastermind server - runs many independent games in one thread.
+ * Clients connect over a Unix socket or TCP (the loopback interface by default) and
+ * talk a line protocol, one request per line:
+ *
+ *   NEW [n c r]      starts a new game (sequence length, maximum number,
+ *                    rounds - the server settings when omitted)
+ *                    -> OK n c r
+ *   GUESS d1 .. dn   -> <exact> <approx> CONTINUE|WIN|OVER
+ *   QUIT             closes the connection
+ *
+ * Invalid requests are answered with ERROR <reason>. Every connection is
+ * one session with its own secret, settings and round counter.
+*/
+
+// Default port of the TCP socket
+#define SERVER_PORT_DEF 4040
+// Default maximum number of connected clients
+#define SERVER_SESSIONS_DEF 4096
+// Longest sequence a client can ask for
+#define SERVER_NUMBERS_MAX 16
+
+struct server_config
+{
+	const char *path;  // Unix socket path, NULL - TCP
+	uint32_t host;  // IPv4 address of the TCP socket (host byte order), 0 - 127.0.0.1
+	uint16_t port;  // TCP port
+	uint32_t max_sessions;  // Connections above this are refused
+	struct game_settings settings;  // Settings of NEW without parameters
+	uint64_t seed;  // Of the secrets, see rng.h
+};
+
+/**
+ * Sets the socket of the config from an address: a port number or
+ * host:port (TCP, the host an IPv4 address or name), anything else is a
+ * Unix socket path. The config points to the path, it is not copied.
+ * Used by the server and its clients alike.
+ * Returns 0 on success, -1 on failure (the host can not be resolved).
+*/
+int SERVER_parse_address(const char *address, struct server_config *config);
+
+/**
+ * Writes the socket address of the config (see SERVER_parse_address).
+ * Returns its length, 0 if the Unix socket path is too long.
+*/
+socklen_t SERVER_socket_address(const struct server_config *config, struct sockaddr_storage *address);
+
+/**
+ * Runs the server until SERVER_stop() is called.
+ * Returns 0 on success, -1 on failure.
+*/
+int SERVER_run(const struct server_config *config);
+
+/**
+ * Makes SERVER_run return. Safe to call from a signal handler or another thread.
+*/
+void SERVER_stop(void);
+
+#endif
@@ -0,0 +1,208 @@
+#include "simulate.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../timeunits.h"
+#include "../score/score.h"
+#include "../code/code.h"
+#include "../solver/solver.h"
+#include "../rng/rng.h"
+#include "../timer/timer.h"
+#include "../game/game.h"
+#include "../arena/arena.h"
+
+#define SUCCESS 0
+#define FAILURE -1
+
+// Secrets generated at once
+#define SECRET_BATCH 1024
+
+struct worker
+{
+	pthread_t thread;
+	const struct simulate_config *config;
+	const struct code_set *space;
+	uint64_t games;
+	struct rng rng;  // Stream of the thread
+	uint64_t secrets[SECRET_BATCH];
+	uint32_t next_secret;  // SECRET_BATCH - generate the next batch
+	uint16_t score;  // Feedback of the last guess
+	uint8_t solved;  // Round of the correct guess, 0 - not yet
+	bool failed;
+	struct simulate_stats stats;
+} __attribute__((aligned(64)));  // No false sharing of the statistics
+
+static void on_feedback(void *context, uint8_t exact, uint8_t approx)
+{
+	((struct worker *)context)->score = SCORE_PACK(exact, approx);
+}
+
+static void on_success(void *context, uint8_t rounds)
+{
+	((struct worker *)context)->solved = rounds;
+}
+
+static const struct game_output output =
+{
+	.feedback = on_feedback,
+	.success = on_success,
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * SEC_TO_NS(1u) + now.tv_nsec;
+}
+
+/**
+ * Plays one game, returns the number of guesses (0 - not solved)
+*/
+static uint8_t play(struct worker *worker, struct game *game, struct solver *solver)
+{
+	uint8_t numbers = game->settings.numbers;
+	int secret[CODE_NUMBERS_MAX];
+	int guess[CODE_NUMBERS_MAX];
+	if (worker->next_secret == SECRET_BATCH)
+	{
+		RNG_codes(&worker->rng, worker->secrets, SECRET_BATCH, numbers, game->settings.max);
+		worker->next_secret = 0;
+	}
+	CODE_decode(worker->secrets[worker->next_secret++], secret, numbers);
+
+	worker->solved = 0;
+	GAME_start(game, secret);
+	SOLVER_reset(solver);
+
+	while (!GAME_is_over(game))
+	{
+		uint64_t code = SOLVER_guess(solver, &worker->rng);
+		CODE_decode(code, guess, numbers);
+		if (GAME_submit_guess(game, guess) != SUCCESS)
+			break;
+		if (!GAME_is_over(game))
+			SOLVER_feedback(solver, code, worker->score);
+	}
+
+	return worker->solved;
+}
+
+static void *worker_loop(void *arg)
+{
+	struct worker *worker = arg;
+	struct game_settings settings = worker->config->settings;
+	settings.rounds = UINT8_MAX;  // Play until solved, the wins are counted within the configured rounds
+
+	// All the memory of the thread in one block, the games do not allocate any
+	struct arena arena;
+	if (ARENA_init(&arena, GAME_ARENA_SIZE(settings.numbers) + SOLVER_ARENA_SIZE(worker->space->length)) != SUCCESS)
+	{
+		worker->failed = true;
+		return NULL;
+	}
+
+	struct timer_wheel wheel;  // Never advanced, the guesses are submitted whole
+	struct game game;
+	struct solver solver;
+	TIMER_wheel_init(&wheel, MS_TO_NS(10u), 0);
+	if (GAME_init(&game, &settings, &output, worker, &wheel, &arena) != SUCCESS ||
+		SOLVER_init(&solver, worker->space, &arena) != SUCCESS)
+	{
+		ARENA_free(&arena);
+		worker->failed = true;
+		return NULL;
+	}
+
+	struct simulate_stats *stats = &worker->stats;
+	for (uint64_t i = 0; i < worker->games; i++)
+	{
+		uint8_t guesses = play(worker, &game, &solver);
+		stats->games++;
+		stats->guesses += guesses;
+		stats->wins += guesses && guesses <= worker->config->settings.rounds;
+		stats->distribution[guesses < SIMULATE_GUESSES_MAX ? guesses : SIMULATE_GUESSES_MAX]++;
+	}
+
+	GAME_free(&game);
+	ARENA_free(&arena);
+	return NULL;
+}
+
+static void merge(struct simulate_stats *to, const struct simulate_stats *from)
+{
+	to->games += from->games;
+	to->wins += from->wins;
+	to->guesses += from->guesses;
+	for (size_t i = 0; i <= SIMULATE_GUESSES_MAX; i++)
+		to->distribution[i] += from->distribution[i];
+}
+
+int SIMULATE_run(const struct simulate_config *config, struct simulate_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	uint32_t threads = config->threads;
+	if (!threads)
+	{
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = online > 0 ? online : 1;
+	}
+	if (threads > config->games)
+		threads = config->games ? config->games : 1;
+
+	struct code_set space;
+	if (SOLVER_space_init(&space, config->settings.numbers, config->settings.max) != SUCCESS)
+		return FAILURE;
+
+	struct worker *workers = aligned_alloc(64, threads * sizeof(*workers));
+	if (!workers)
+	{
+		perror("Unable to allocate memory for the workers");
+		CODE_set_free(&space);
+		return FAILURE;
+	}
+
+	struct rng rng;
+	RNG_seed(&rng, config->seed);
+
+	uint64_t start = now_ns();
+	uint32_t started = 0;
+	int status = SUCCESS;
+	for (uint32_t t = 0; t < threads; t++)
+	{
+		memset(&workers[t], 0, sizeof(workers[t]));
+		workers[t].config = config;
+		workers[t].space = &space;
+		workers[t].games = config->games / threads + (t < config->games % threads);
+		workers[t].rng = rng;
+		workers[t].next_secret = SECRET_BATCH;
+		RNG_jump(&rng);  // The next thread gets the next stream
+
+		if (pthread_create(&workers[t].thread, NULL, worker_loop, &workers[t]) != 0)
+		{
+			perror("Unable to start a simulation thread");
+			status = FAILURE;
+			break;
+		}
+		started++;
+	}
+
+	for (uint32_t t = 0; t < started; t++)
+	{
+		pthread_join(workers[t].thread, NULL);
+		if (workers[t].failed)
+			status = FAILURE;
+		merge(stats, &workers[t].stats);
+	}
+	stats->elapsed_ns = now_ns() - start;
+	stats->threads = started;
+
+	free(workers);
+	CODE_set_free(&space);
+	return status;
+}
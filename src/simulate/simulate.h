@@ -0,0 +1,43 @@
+#ifndef SIMULATE_H
+#define SIMULATE_H
+
+#include <stdint.h>
+#include "../game/game.h"
+
+/**
+ * Headless simulation.
+ * Plays games on the game engine with the built-in codebreaker (see
+ * solver.h), without any hardware. The games are split between worker
+ * threads, every thread has its own random numbers, game, solver and
+ * statistics, so nothing is shared while the games are played. The
+ * statistics of the threads are merged at the end.
+*/
+
+// Guess counts of the distribution, longer games are counted in the last one
+#define SIMULATE_GUESSES_MAX 32
+
+struct simulate_config
+{
+	uint64_t games;
+	uint32_t threads;  // 0 - one per online CPU
+	uint64_t seed;  // The same seed and threads play the same games
+	struct game_settings settings;  // rounds - the rounds a game is won within
+};
+
+struct simulate_stats
+{
+	uint64_t games;
+	uint64_t wins;  // Solved within settings.rounds guesses
+	uint64_t guesses;  // All the games
+	uint64_t distribution[SIMULATE_GUESSES_MAX + 1];  // Games solved with i guesses
+	uint32_t threads;
+	uint64_t elapsed_ns;  // Wall clock time
+};
+
+/**
+ * Plays the games and merges the statistics of the threads into stats.
+ * Returns 0 on success, -1 on failure.
+*/
+int SIMULATE_run(const struct simulate_config *config, struct simulate_stats *stats);
+
+#endif
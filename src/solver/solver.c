@@ -0,0 +1,71 @@
+#include "solver.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "../code/code.h"
+#include "../rng/rng.h"
+#include "../arena/arena.h"
+
+#define SUCCESS 0
+#define FAILURE -1
+
+int SOLVER_space_init(struct code_set *space, uint8_t numbers, uint8_t colours)
+{
+	uint64_t codes = 1;
+	for (uint8_t i = 0; i < numbers && codes <= SOLVER_CODES_MAX; i++)
+		codes *= colours;
+
+	if (numbers < 1 || numbers > CODE_NUMBERS_MAX || colours < 1 || colours > CODE_COLOURS_MAX ||
+		codes > SOLVER_CODES_MAX)
+	{
+		fprintf(stderr, "Error - The solver takes 1-%d numbers from 1 to at most %d, up to %u codes\n",
+				CODE_NUMBERS_MAX, CODE_COLOURS_MAX, SOLVER_CODES_MAX);
+		return FAILURE;
+	}
+
+	if (CODE_set_init(space, numbers, codes) != SUCCESS)
+		return FAILURE;
+	for (uint32_t rank = 0; rank < codes; rank++)
+		CODE_set_add(space, CODE_unrank(rank, numbers, colours));
+
+	return SUCCESS;
+}
+
+int SOLVER_init(struct solver *solver, const struct code_set *space, struct arena *arena)
+{
+	solver->space = space;
+	solver->remaining = space;
+	solver->scores = ARENA_alloc(arena, space->length * sizeof(uint16_t));
+	if (!solver->scores)
+	{
+		fprintf(stderr, "Error - Not enough arena memory for a solver of %u codes\n", space->length);
+		return FAILURE;
+	}
+
+	return CODE_set_init_arena(&solver->candidates, space->size, space->length, arena);
+}
+
+void SOLVER_reset(struct solver *solver)
+{
+	solver->remaining = solver->space;  // Nothing is copied until the first feedback
+}
+
+uint64_t SOLVER_guess(struct solver *solver, struct rng *rng)
+{
+	const struct code_set *remaining = solver->remaining;
+	if (!remaining->length)
+		return solver->space->codes[0];  // Inconsistent feedback, any code
+
+	return remaining->codes[RNG_bounded(rng, remaining->length)];
+}
+
+void SOLVER_feedback(struct solver *solver, uint64_t guess, uint16_t score)
+{
+	CODE_set_filter(solver->remaining, &solver->candidates, guess, score, solver->scores);
+	solver->remaining = &solver->candidates;
+}
+
+uint32_t SOLVER_candidates(const struct solver *solver)
+{
+	return solver->remaining->length;
+}
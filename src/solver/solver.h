@@ -0,0 +1,66 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stdint.h>
+#include "../code/code.h"
+#include "../rng/rng.h"
+#include "../arena/arena.h"
+
+/**
+ * Codebreaker.
+ * Keeps the codes which are still consistent with the feedback of every
+ * guess so far and plays a random one of them. Codes are packed (see
+ * code.h), numbers from 1 to the maximum number.
+ *
+ * The set of all the codes of a code space is built once (SOLVER_space_init)
+ * and is only read by the solvers, so any number of solvers on any number of
+ * threads can share it.
+*/
+
+// Largest code space of a solver
+#define SOLVER_CODES_MAX (1u << 22)
+// Arena memory of a solver of a code space of the given size, see SOLVER_init
+#define SOLVER_ARENA_SIZE(codes) (CODE_SET_ARENA_SIZE(codes) + ARENA_SIZE((size_t)(codes) * sizeof(uint16_t)))
+
+struct solver
+{
+	const struct code_set *space;  // Every code, shared
+	struct code_set candidates;  // Codes consistent with the feedback so far
+	const struct code_set *remaining;  // space before the first feedback, then candidates
+	uint16_t *scores;  // Scratch space for CODE_set_filter
+};
+
+/**
+ * Builds the set of every code of numbers numbers from 1 to colours.
+ * Returns 0 on success, -1 on failure (too many codes).
+*/
+int SOLVER_space_init(struct code_set *space, uint8_t numbers, uint8_t colours);
+
+/**
+ * Initialises a solver of the code space with its memory
+ * (SOLVER_ARENA_SIZE(space->length)) from the arena.
+ * Returns 0 on success, -1 on failure (the arena is full).
+*/
+int SOLVER_init(struct solver *solver, const struct code_set *space, struct arena *arena);
+
+/**
+ * Forgets the feedback, for a new game
+*/
+void SOLVER_reset(struct solver *solver);
+
+/**
+ * Returns the next guess, picked with the given random numbers
+*/
+uint64_t SOLVER_guess(struct solver *solver, struct rng *rng);
+
+/**
+ * Keeps the candidates which give the packed score (see score.h) for the guess
+*/
+void SOLVER_feedback(struct solver *solver, uint64_t guess, uint16_t score);
+
+/**
+ * Returns the number of codes still consistent with the feedback
+*/
+uint32_t SOLVER_candidates(const struct solver *solver);
+
+#endif
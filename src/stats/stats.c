@@ -0,0 +1,298 @@
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include "../timeunits.h"
+
+#define SUCCESS 0
+#define FAILURE -1
+
+// log2 buckets of a histogram, enough for any uint64_t
+#define BUCKETS 65
+
+static const char *const counter_names[STATS_COUNTERS] =
+{
+	[STATS_GPIO_WRITES] = "gpio_writes",
+	[STATS_GPIO_READS] = "gpio_reads",
+	[STATS_GPIO_EVENTS] = "gpio_events",
+	[STATS_LCD_COMMANDS] = "lcd_commands",
+	[STATS_LCD_DATA] = "lcd_data",
+};
+
+static const char *const histogram_names[STATS_HISTOGRAMS] =
+{
+	[STATS_SLEEP_NS] = "sleep_ns",
+	[STATS_WAIT_EVENT_NS] = "wait_event_ns",
+	[STATS_DEBOUNCE_NS] = "debounce_ns",
+	[STATS_INPUT_NS] = "input_ns",
+	[STATS_INPUT_FEEDBACK_NS] = "input_feedback_ns",
+	[STATS_SCORE_NS] = "score_ns",
+	[STATS_SCORE_MANY_NS] = "score_many_ns",
+};
+
+/**
+ * Sum of the histograms of the threads
+*/
+struct histogram
+{
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	uint64_t buckets[BUCKETS];
+};
+
+/**
+ * Returns the upper bound of the bucket b
+*/
+static uint64_t bucket_limit(int b)
+{
+	return b >= 64 ? UINT64_MAX : (1ull << b) - 1;
+}
+
+/**
+ * Returns the upper bound of the bucket holding the given fraction of the values
+*/
+static uint64_t percentile(const struct histogram *histogram, double fraction)
+{
+	uint64_t rank = histogram->count * fraction;
+	uint64_t seen = 0;
+	for (int b = 0; b < BUCKETS; b++)
+	{
+		seen += histogram->buckets[b];
+		if (seen > rank)
+			return bucket_limit(b) < histogram->max ? bucket_limit(b) : histogram->max;
+	}
+	return histogram->max;
+}
+
+#ifdef MM_STATS
+
+/**
+ * Statistics of one thread. Only the thread writes them, relaxed atomic
+ * loads and stores (plain moves) keep the readers from seeing torn values.
+*/
+struct block
+{
+	_Atomic uint64_t counters[STATS_COUNTERS];
+	struct
+	{
+		_Atomic uint64_t count;
+		_Atomic uint64_t sum;
+		_Atomic uint64_t max;
+		_Atomic uint64_t buckets[BUCKETS];
+	} histograms[STATS_HISTOGRAMS];
+	struct block *next;
+};
+
+static _Thread_local struct block *own_block;
+// Blocks of all the threads, kept after the threads exit
+static struct block *blocks;
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct block *get_block(void)
+{
+	if (own_block)
+		return own_block;
+
+	struct block *block = calloc(1, sizeof(*block));
+	if (!block)
+		return NULL;  // Not counted
+
+	pthread_mutex_lock(&blocks_lock);
+	block->next = blocks;
+	blocks = block;
+	pthread_mutex_unlock(&blocks_lock);
+
+	own_block = block;
+	return block;
+}
+
+static inline void increase(_Atomic uint64_t *value, uint64_t n)
+{
+	atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+void STATS_add(enum stats_counter counter, uint64_t n)
+{
+	struct block *block = get_block();
+	if (block)
+		increase(&block->counters[counter], n);
+}
+
+void STATS_record(enum stats_histogram histogram, uint64_t ns)
+{
+	struct block *block = get_block();
+	if (!block)
+		return;
+
+	int bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+	increase(&block->histograms[histogram].count, 1);
+	increase(&block->histograms[histogram].sum, ns);
+	increase(&block->histograms[histogram].buckets[bucket], 1);
+	if (ns > atomic_load_explicit(&block->histograms[histogram].max, memory_order_relaxed))
+		atomic_store_explicit(&block->histograms[histogram].max, ns, memory_order_relaxed);
+}
+
+uint64_t STATS_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * SEC_TO_NS(1u) + now.tv_nsec;
+}
+
+/**
+ * Sums the blocks of all the threads
+*/
+static void collect(uint64_t counters[STATS_COUNTERS], struct histogram histograms[STATS_HISTOGRAMS])
+{
+	memset(counters, 0, STATS_COUNTERS * sizeof(uint64_t));
+	memset(histograms, 0, STATS_HISTOGRAMS * sizeof(struct histogram));
+
+	pthread_mutex_lock(&blocks_lock);
+	for (struct block *block = blocks; block; block = block->next)
+	{
+		for (int c = 0; c < STATS_COUNTERS; c++)
+			counters[c] += atomic_load_explicit(&block->counters[c], memory_order_relaxed);
+
+		for (int h = 0; h < STATS_HISTOGRAMS; h++)
+		{
+			struct histogram *to = &histograms[h];
+			to->count += atomic_load_explicit(&block->histograms[h].count, memory_order_relaxed);
+			to->sum += atomic_load_explicit(&block->histograms[h].sum, memory_order_relaxed);
+			uint64_t max = atomic_load_explicit(&block->histograms[h].max, memory_order_relaxed);
+			if (max > to->max)
+				to->max = max;
+			for (int b = 0; b < BUCKETS; b++)
+				to->buckets[b] += atomic_load_explicit(&block->histograms[h].buckets[b], memory_order_relaxed);
+		}
+	}
+	pthread_mutex_unlock(&blocks_lock);
+}
+
+#else
+
+static void collect(uint64_t counters[STATS_COUNTERS], struct histogram histograms[STATS_HISTOGRAMS])
+{
+	memset(counters, 0, STATS_COUNTERS * sizeof(uint64_t));
+	memset(histograms, 0, STATS_HISTOGRAMS * sizeof(struct histogram));
+}
+
+#endif
+
+static void dump_text(FILE *file, const uint64_t counters[], const struct histogram histograms[])
+{
+	fprintf(file, "%-18s %14s\n", "counter", "value");
+	for (int c = 0; c < STATS_COUNTERS; c++)
+		fprintf(file, "%-18s %14llu\n", counter_names[c], (unsigned long long)counters[c]);
+
+	fprintf(file, "\n%-18s %10s %14s %12s %12s %12s %12s\n", "histogram", "count", "sum_ms", "mean_ns",
+			"p50_ns<=", "p99_ns<=", "max_ns");
+	for (int h = 0; h < STATS_HISTOGRAMS; h++)
+	{
+		const struct histogram *histogram = &histograms[h];
+		fprintf(file, "%-18s %10llu %14.3f %12.0f %12llu %12llu %12llu\n", histogram_names[h],
+				(unsigned long long)histogram->count, histogram->sum / 1e6,
+				histogram->count ? (double)histogram->sum / histogram->count : 0.0,
+				(unsigned long long)percentile(histogram, 0.5), (unsigned long long)percentile(histogram, 0.99),
+				(unsigned long long)histogram->max);
+	}
+}
+
+static void dump_json(FILE *file, const uint64_t counters[], const struct histogram histograms[])
+{
+	fprintf(file, "{\"counters\": {");
+	for (int c = 0; c < STATS_COUNTERS; c++)
+		fprintf(file, "%s\"%s\": %llu", c ? ", " : "", counter_names[c], (unsigned long long)counters[c]);
+
+	fprintf(file, "}, \"histograms\": {");
+	for (int h = 0; h < STATS_HISTOGRAMS; h++)
+	{
+		const struct histogram *histogram = &histograms[h];
+		fprintf(file, "%s\"%s\": {\"count\": %llu, \"sum\": %llu, \"max\": %llu, \"buckets\": [", h ? ", " : "",
+				histogram_names[h], (unsigned long long)histogram->count, (unsigned long long)histogram->sum,
+				(unsigned long long)histogram->max);
+
+		// [upper bound, count] of the non-empty buckets
+		bool first = true;
+		for (int b = 0; b < BUCKETS; b++)
+		{
+			if (!histogram->buckets[b])
+				continue;
+			fprintf(file, "%s[%llu, %llu]", first ? "" : ", ", (unsigned long long)bucket_limit(b),
+					(unsigned long long)histogram->buckets[b]);
+			first = false;
+		}
+		fprintf(file, "]}");
+	}
+	fprintf(file, "}}\n");
+}
+
+void STATS_dump(FILE *file, enum stats_format format)
+{
+	uint64_t counters[STATS_COUNTERS];
+	struct histogram histograms[STATS_HISTOGRAMS];
+	collect(counters, histograms);
+
+	if (format == STATS_JSON)
+		dump_json(file, counters, histograms);
+	else
+		dump_text(file, counters, histograms);
+	fflush(file);
+}
+
+#ifdef MM_STATS
+
+static enum stats_format dump_format;
+
+static void dump_at_exit(void)
+{
+	STATS_dump(stderr, dump_format);
+}
+
+/**
+ * Dumps the statistics on every SIGUSR1, outside of any signal handler
+*/
+static void *signal_loop(void *arg)
+{
+	sigset_t *set = arg;
+	int signal;
+	while (sigwait(set, &signal) == 0)
+		STATS_dump(stderr, dump_format);
+	return NULL;
+}
+
+int STATS_start(enum stats_format format)
+{
+	static sigset_t set;
+	dump_format = format;
+
+	// Blocked here, so in every thread started from now on
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	pthread_t thread;
+	if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0 || pthread_create(&thread, NULL, signal_loop, &set) != 0)
+	{
+		perror("Unable to start the statistics thread");
+		return FAILURE;
+	}
+	pthread_detach(thread);
+
+	return atexit(dump_at_exit) == 0 ? SUCCESS : FAILURE;
+}
+
+#else
+
+int STATS_start(enum stats_format format)
+{
+	(void)format;
+	fprintf(stderr, "Error - Built without statistics, rebuild with make STATS=1\n");
+	return FAILURE;
+}
+
+#endif
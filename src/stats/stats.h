@@ -0,0 +1,87 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Instrumentation of the hot paths: event counters and latency histograms
+ * with log2 buckets (bucket b counts the values from 2^(b-1) to 2^b - 1).
+ *
+ * Compiled in with -DMM_STATS (make STATS=1). Without it the STATS_COUNT,
+ * STATS_BEGIN, STATS_END and STATS_RECORD macros expand to nothing, their
+ * arguments are not evaluated, and the program is the same as before.
+ *
+ * Every thread updates its own block of counters (no locks, no atomic
+ * read-modify-write), the blocks of all the threads are summed when the
+ * statistics are dumped.
+*/
+
+enum stats_counter
+{
+	STATS_GPIO_WRITES,  // Output register stores
+	STATS_GPIO_READS,  // Input register loads
+	STATS_GPIO_EVENTS,  // Debounced events queued by the sampler
+	STATS_LCD_COMMANDS,  // Instruction bytes sent to the display
+	STATS_LCD_DATA,  // Character bytes sent to the display
+	STATS_COUNTERS,
+};
+
+enum stats_histogram
+{
+	STATS_SLEEP_NS,  // Time blocked in delays and sleeps
+	STATS_WAIT_EVENT_NS,  // Time blocked waiting for an input event
+	STATS_DEBOUNCE_NS,  // First sample of a new level until its event is queued
+	STATS_INPUT_NS,  // Button event until the game handled it
+	STATS_INPUT_FEEDBACK_NS,  // Last button event of a guess until its feedback is shown
+	STATS_SCORE_NS,  // Scoring of a guess by the game
+	STATS_SCORE_MANY_NS,  // CODE_score_many calls
+	STATS_HISTOGRAMS,
+};
+
+enum stats_format
+{
+	STATS_TEXT,
+	STATS_JSON,
+};
+
+#ifdef MM_STATS
+
+#define STATS_COUNT(counter, n) STATS_add((counter), (n))
+// Starts timing, name is a local variable holding the start time
+#define STATS_BEGIN(name) uint64_t name = STATS_now()
+#define STATS_END(histogram, name) STATS_record((histogram), STATS_now() - (name))
+#define STATS_RECORD(histogram, ns) STATS_record((histogram), (ns))
+
+void STATS_add(enum stats_counter counter, uint64_t n);
+void STATS_record(enum stats_histogram histogram, uint64_t ns);
+
+/**
+ * Returns the time (ns) of CLOCK_MONOTONIC
+*/
+uint64_t STATS_now(void);
+
+#else
+
+#define STATS_COUNT(counter, n) ((void)0)
+#define STATS_BEGIN(name) ((void)0)
+#define STATS_END(histogram, name) ((void)0)
+#define STATS_RECORD(histogram, ns) ((void)0)
+
+#endif
+
+/**
+ * Dumps the statistics to stderr in the given format when the program
+ * exits and every time it receives SIGUSR1.
+ * Has to be called before any other thread is started (SIGUSR1 is blocked
+ * in every thread and handled by a thread of its own).
+ * Returns 0 on success, -1 on failure (or when built without MM_STATS).
+*/
+int STATS_start(enum stats_format format);
+
+/**
+ * Writes the sum of the statistics of all the threads
+*/
+void STATS_dump(FILE *file, enum stats_format format);
+
+#endif
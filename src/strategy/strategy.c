@@ -0,0 +1,165 @@
+#include "strategy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "../code/code.h"
+#include "../rng/rng.h"
+#include "../arena/arena.h"
+#include "../candidates/candidates.h"
+#include "../minimax/minimax.h"
+
+#define SUCCESS 0
+#define FAILURE -1
+
+int STRATEGY_init(struct strategy_state *state, const struct candidates *candidates, uint64_t seed,
+				  struct arena *arena)
+{
+	const struct code_set *space = candidates->space;
+	state->candidates = candidates;
+	state->round = 1;
+	RNG_seed(&state->rng, seed);
+	return CODE_set_init_arena(&state->set, space->size, space->length, arena);
+}
+
+/**
+ * Returns the first candidate, or any code after inconsistent feedback
+*/
+static uint64_t first_candidate(const struct candidates *candidates)
+{
+	uint32_t rank = CANDIDATES_next(candidates, 0);
+	return CANDIDATES_code(candidates, rank == CANDIDATES_END ? 0 : rank);
+}
+
+static uint64_t random_guess(struct strategy_state *state)
+{
+	const struct candidates *candidates = state->candidates;
+	uint32_t count = CANDIDATES_count(candidates);
+	if (!count)
+		return first_candidate(candidates);
+
+	return CANDIDATES_code(candidates, CANDIDATES_select(candidates, RNG_bounded(&state->rng, count)));
+}
+
+static uint64_t knuth_guess(struct strategy_state *state)
+{
+	// The players run in parallel, so every search has one thread
+	struct minimax_config config = {.threads = 1};
+	struct minimax_result result;
+	if (MINIMAX_search(state->candidates, &config, &result) != SUCCESS)
+		return first_candidate(state->candidates);
+	return result.guess;
+}
+
+/**
+ * Scores every guess against the candidates and returns the one whose
+ * partitions have the highest value
+*/
+static uint64_t best_guess(struct strategy_state *state, double (*value)(const uint32_t partitions[], size_t classes))
+{
+	const struct candidates *candidates = state->candidates;
+	if (CANDIDATES_count(candidates) <= 2)
+		return first_candidate(candidates);  // Either candidate splits the other one off
+
+	struct code_set *set = &state->set;
+	set->length = 0;
+	for (uint32_t rank = CANDIDATES_next(candidates, 0); rank != CANDIDATES_END;
+		 rank = CANDIDATES_next(candidates, rank + 1))
+		CODE_set_add(set, CANDIDATES_code(candidates, rank));
+
+	size_t classes = CODE_CLASSES(set->size);
+	double best = -INFINITY;
+	bool best_candidate = false;
+	uint32_t best_rank = 0;
+	for (uint32_t rank = 0; rank < candidates->space->length; rank++)
+	{
+		uint64_t guess = CANDIDATES_code(candidates, rank);
+		if (!CANDIDATES_canonical(candidates, guess))
+			continue;
+
+		memset(state->partitions, 0, classes * sizeof(uint32_t));
+		CODE_score_many(guess, set, NULL, state->partitions);
+		double guess_value = value(state->partitions, classes);
+		bool candidate = CANDIDATES_contains(candidates, rank);
+		if (guess_value > best || (guess_value == best && candidate && !best_candidate))
+		{
+			best = guess_value;
+			best_candidate = candidate;
+			best_rank = rank;
+		}
+	}
+	return CANDIDATES_code(candidates, best_rank);
+}
+
+/**
+ * The entropy of the feedback without the constant terms: -sum(n log2 n)
+*/
+static double entropy(const uint32_t partitions[], size_t classes)
+{
+	double sum = 0;
+	for (size_t c = 0; c < classes; c++)
+	{
+		if (partitions[c] > 1)
+			sum += partitions[c] * log2(partitions[c]);
+	}
+	return -sum;
+}
+
+static double parts(const uint32_t partitions[], size_t classes)
+{
+	uint32_t count = 0;
+	for (size_t c = 0; c < classes; c++)
+		count += partitions[c] != 0;
+	return count;
+}
+
+static uint64_t entropy_guess(struct strategy_state *state)
+{
+	return best_guess(state, entropy);
+}
+
+static uint64_t parts_guess(struct strategy_state *state)
+{
+	return best_guess(state, parts);
+}
+
+static uint64_t book_guess(struct strategy_state *state)
+{
+	if (state->round > 1)
+		return knuth_guess(state);
+
+	// Every number twice: 1122 for 4 numbers, 11223 for 5
+	const struct candidates *candidates = state->candidates;
+	uint64_t guess = 0;
+	for (uint8_t i = 0; i < candidates->space->size; i++)
+		guess |= (uint64_t)(i / 2 % candidates->colours + 1) << (i * 4);
+	return guess;
+}
+
+const struct strategy STRATEGY_random = {"random", random_guess};
+const struct strategy STRATEGY_knuth = {"knuth", knuth_guess};
+const struct strategy STRATEGY_entropy = {"entropy", entropy_guess};
+const struct strategy STRATEGY_parts = {"parts", parts_guess};
+const struct strategy STRATEGY_book = {"book", book_guess};
+
+const struct strategy *const STRATEGY_all[] =
+{
+	&STRATEGY_random,
+	&STRATEGY_knuth,
+	&STRATEGY_entropy,
+	&STRATEGY_parts,
+	&STRATEGY_book,
+};
+const size_t STRATEGY_COUNT = sizeof(STRATEGY_all) / sizeof(STRATEGY_all[0]);
+
+const struct strategy *STRATEGY_find(const char *name)
+{
+	for (size_t i = 0; i < STRATEGY_COUNT; i++)
+	{
+		if (strcmp(STRATEGY_all[i]->name, name) == 0)
+			return STRATEGY_all[i];
+	}
+	return NULL;
+}
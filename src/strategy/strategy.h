@@ -0,0 +1,70 @@
+#ifndef STRATEGY_H
+#define STRATEGY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../code/code.h"
+#include "../rng/rng.h"
+#include "../arena/arena.h"
+#include "../candidates/candidates.h"
+
+/**
+ * Codebreaker strategies.
+ * A strategy is a guess function, given the remaining candidates (see
+ * candidates.h) of the game it returns the next guess. The player prunes
+ * the candidates with the feedback itself, so every strategy sees the same
+ * state and any of them can play any game.
+ *
+ * Every player has its own strategy state with scratch memory and random
+ * numbers, players on different threads share nothing but the code space.
+ * Apart from the random numbers the strategies are deterministic: the
+ * searches break ties in favour of the candidates, then of the lowest rank.
+*/
+
+struct strategy_state
+{
+	const struct candidates *candidates;  // Remaining codes of the game
+	uint8_t round;  // Of the next guess, from 1
+	struct rng rng;
+	struct code_set set;  // Scratch space, the candidates compacted
+	uint32_t partitions[CODE_CLASSES(CODE_NUMBERS_MAX)];
+};
+
+struct strategy
+{
+	const char *name;
+	uint64_t (*guess)(struct strategy_state *state);
+};
+
+// Arena memory of a state of a code space of the given size, see STRATEGY_init
+#define STRATEGY_ARENA_SIZE(codes) CODE_SET_ARENA_SIZE(codes)
+
+// Random consistent - a random candidate
+extern const struct strategy STRATEGY_random;
+// Knuth - the smallest largest partition (see minimax.h)
+extern const struct strategy STRATEGY_knuth;
+// Max entropy - the most information on average
+extern const struct strategy STRATEGY_entropy;
+// Most parts - the most feedback classes
+extern const struct strategy STRATEGY_parts;
+// Opening book - a fixed first guess (1122 for 4 numbers), then Knuth
+extern const struct strategy STRATEGY_book;
+
+// Every strategy, in the order above
+extern const struct strategy *const STRATEGY_all[];
+extern const size_t STRATEGY_COUNT;
+
+/**
+ * Initialises the state of a player of the candidates with its memory
+ * (STRATEGY_ARENA_SIZE of the code space) from the arena.
+ * Returns 0 on success, -1 on failure (the arena is full).
+*/
+int STRATEGY_init(struct strategy_state *state, const struct candidates *candidates, uint64_t seed,
+				  struct arena *arena);
+
+/**
+ * Returns the strategy with the given name, NULL if there is none
+*/
+const struct strategy *STRATEGY_find(const char *name);
+
+#endif
@@ -0,0 +1,126 @@
+#include "timer.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+void TIMER_wheel_init(struct timer_wheel *wheel, uint64_t tick_ns, uint64_t now)
+{
+	wheel->tick = tick_ns;
+	wheel->current = now / tick_ns;
+	wheel->pending = 0;
+	for (size_t i = 0; i < TIMER_WHEEL_SLOTS; i++)
+		wheel->slots[i] = NULL;
+}
+
+void TIMER_init(struct timer *timer, void (*callback)(struct timer *timer, uint64_t now), void *context)
+{
+	timer->expires = TIMER_NONE;
+	timer->callback = callback;
+	timer->context = context;
+	timer->next = NULL;
+	timer->link = NULL;
+}
+
+/**
+ * Adds the timer to the front of the slot list
+*/
+static void link_timer(struct timer_wheel *wheel, struct timer *timer)
+{
+	uint64_t tick = timer->expires / wheel->tick;
+	if (tick < wheel->current)
+		tick = wheel->current;  // Already due, fire on the next advance
+
+	struct timer **slot = &wheel->slots[tick % TIMER_WHEEL_SLOTS];
+	timer->next = *slot;
+	if (timer->next)
+		timer->next->link = &timer->next;
+	timer->link = slot;
+	*slot = timer;
+	wheel->pending++;
+}
+
+void TIMER_cancel(struct timer_wheel *wheel, struct timer *timer)
+{
+	if (!timer->link)
+		return;
+
+	*timer->link = timer->next;
+	if (timer->next)
+		timer->next->link = timer->link;
+	timer->next = NULL;
+	timer->link = NULL;
+	wheel->pending--;
+}
+
+void TIMER_schedule(struct timer_wheel *wheel, struct timer *timer, uint64_t expires)
+{
+	TIMER_cancel(wheel, timer);
+	timer->expires = expires;
+	link_timer(wheel, timer);
+}
+
+bool TIMER_pending(const struct timer *timer)
+{
+	return timer->link != NULL;
+}
+
+/**
+ * Fires the expired timers of one slot, the others (later rounds) stay
+*/
+static void process_slot(struct timer_wheel *wheel, size_t slot, uint64_t now)
+{
+	/*
+	 * Move the list to a local head first - the callbacks may schedule timers
+	 * into this slot, or cancel timers which are still on the local list.
+	*/
+	struct timer *expired = wheel->slots[slot];
+	wheel->slots[slot] = NULL;
+	if (expired)
+		expired->link = &expired;
+
+	struct timer *timer;
+	while ((timer = expired))
+	{
+		TIMER_cancel(wheel, timer);
+
+		if (timer->expires <= now)
+			timer->callback(timer, now);
+		else
+			link_timer(wheel, timer);
+	}
+}
+
+void TIMER_advance(struct timer_wheel *wheel, uint64_t now)
+{
+	uint64_t target = now / wheel->tick;
+	uint64_t first = wheel->current;
+
+	// After a full turn every slot has been visited
+	if (target - first >= TIMER_WHEEL_SLOTS)
+		first = target - TIMER_WHEEL_SLOTS + 1;
+
+	for (uint64_t tick = first; tick <= target; tick++)
+	{
+		wheel->current = tick;
+		process_slot(wheel, tick % TIMER_WHEEL_SLOTS, now);
+	}
+}
+
+uint64_t TIMER_next_expiry(const struct timer_wheel *wheel)
+{
+	uint64_t earliest = TIMER_NONE;
+
+	if (!wheel->pending)
+		return earliest;
+
+	for (size_t i = 0; i < TIMER_WHEEL_SLOTS; i++)
+	{
+		for (const struct timer *timer = wheel->slots[i]; timer; timer = timer->next)
+		{
+			if (timer->expires < earliest)
+				earliest = timer->expires;
+		}
+	}
+
+	return earliest;
+}
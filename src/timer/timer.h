@@ -0,0 +1,77 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Hashed timer wheel.
+ * Timers are kept in TIMER_WHEEL_SLOTS lists indexed by their expiry tick,
+ * so scheduling and cancelling are O(1) and advancing the time only looks
+ * at the slots of the ticks that passed.
+ * The wheel is not thread-safe, it belongs to the thread that advances it.
+*/
+
+// Number of slots (power of 2)
+#define TIMER_WHEEL_SLOTS 256
+
+#define TIMER_NONE UINT64_MAX
+
+struct timer
+{
+	uint64_t expires;  // Time (ns) when the callback is called
+	void (*callback)(struct timer *timer, uint64_t now);
+	void *context;  // Free for the owner of the timer
+	// Slot list - managed by the wheel
+	struct timer *next;
+	struct timer **link;  // Pointer pointing to this timer, NULL when not scheduled
+};
+
+struct timer_wheel
+{
+	uint64_t tick;  // Length of one slot (ns)
+	uint64_t current;  // Last processed tick
+	uint32_t pending;  // Number of scheduled timers
+	struct timer *slots[TIMER_WHEEL_SLOTS];
+};
+
+/**
+ * Initialises an empty wheel
+ * tick_ns - resolution of the wheel
+ * now - current time (ns)
+*/
+void TIMER_wheel_init(struct timer_wheel *wheel, uint64_t tick_ns, uint64_t now);
+
+/**
+ * Initialises a timer which calls callback when it expires
+*/
+void TIMER_init(struct timer *timer, void (*callback)(struct timer *timer, uint64_t now), void *context);
+
+/**
+ * Schedules the timer to expire at the given time (ns).
+ * A timer which is already scheduled is moved.
+*/
+void TIMER_schedule(struct timer_wheel *wheel, struct timer *timer, uint64_t expires);
+
+/**
+ * Removes the timer from the wheel, does nothing if it is not scheduled
+*/
+void TIMER_cancel(struct timer_wheel *wheel, struct timer *timer);
+
+/**
+ * Returns true if the timer is scheduled
+*/
+bool TIMER_pending(const struct timer *timer);
+
+/**
+ * Calls the callbacks of all timers which expired by now.
+ * The callbacks may schedule timers (including their own).
+*/
+void TIMER_advance(struct timer_wheel *wheel, uint64_t now);
+
+/**
+ * Returns the expiry time of the earliest timer, TIMER_NONE if there is none
+*/
+uint64_t TIMER_next_expiry(const struct timer_wheel *wheel);
+
+#endif
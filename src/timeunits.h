@@ -20,4 +20,9 @@
 */
 #define US_TO_NS(x) ((x) * 1000)
 
+/**
+ * Converts seconds to miliseconds
+*/
+#define SEC_TO_MS(x) ((x) * 1000)
+
 #endif
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define SUCCESS 0
+#define FAILURE -1
+
+int TRACE_create(struct trace *trace, const char *path, const struct game_settings *settings,
+				 uint64_t seed, const int secret[], uint64_t start)
+{
+	memset(trace, 0, sizeof(*trace));
+	trace->file = fopen(path, "wb");
+	if (!trace->file)
+	{
+		perror("Unable to create the trace file");
+		return FAILURE;
+	}
+
+	trace->header = (struct trace_header)
+	{
+		.magic = TRACE_MAGIC,
+		.version = TRACE_VERSION,
+		.numbers = settings->numbers,
+		.rounds = settings->rounds,
+		.max = settings->max,
+		.seed = seed,
+	};
+	trace->start = start;
+
+	uint8_t numbers[UINT8_MAX];
+	for (uint8_t i = 0; i < settings->numbers; i++)
+	{
+		trace->secret[i] = secret[i];
+		numbers[i] = secret[i];
+	}
+
+	if (fwrite(&trace->header, sizeof(trace->header), 1, trace->file) != 1 ||
+		fwrite(numbers, 1, settings->numbers, trace->file) != settings->numbers)
+	{
+		perror("Unable to write the trace");
+		fclose(trace->file);
+		trace->file = NULL;
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+/**
+ * Writes the time since the last record as LEB128 (7 bits per byte, low bits first)
+*/
+static void write_time(struct trace *trace, uint64_t time)
+{
+	uint64_t delta = time > trace->last ? time - trace->last : 0;
+	trace->last += delta;
+
+	do
+	{
+		uint8_t byte = delta & 0x7F;
+		delta >>= 7;
+		fputc(delta ? byte | 0x80 : byte, trace->file);
+	} while (delta);
+}
+
+int TRACE_record(struct trace *trace, const struct gpio_event *event)
+{
+	uint64_t time = event->timestamp > trace->start ? event->timestamp - trace->start : 0;
+	write_time(trace, time);
+	return fputc(event->pin << 1 | (event->level & 1), trace->file) == EOF ? FAILURE : SUCCESS;
+}
+
+void TRACE_deliver(struct trace *trace, struct game *game, struct timer_wheel *wheel, struct gpio_event *event,
+				   uint64_t *advanced)
+{
+	if (event->timestamp < *advanced)
+		event->timestamp = *advanced;  // After the timers the game has already fired
+	else
+		TIMER_advance(wheel, *advanced = event->timestamp);
+
+	GAME_button(game, event->level, event->timestamp);
+	if (trace)
+		TRACE_record(trace, event);
+}
+
+int TRACE_record_end(struct trace *trace, uint64_t now, const struct trace_result *result)
+{
+	write_time(trace, now > trace->start ? now - trace->start : 0);
+	fputc(TRACE_END, trace->file);
+	fputc(result->round, trace->file);
+	return fputc(result->won, trace->file) == EOF ? FAILURE : SUCCESS;
+}
+
+int TRACE_open(struct trace *trace, const char *path)
+{
+	memset(trace, 0, sizeof(*trace));
+	trace->file = fopen(path, "rb");
+	if (!trace->file)
+	{
+		perror("Unable to open the trace file");
+		return FAILURE;
+	}
+
+	struct trace_header *header = &trace->header;
+	uint8_t numbers[UINT8_MAX];
+	if (fread(header, sizeof(*header), 1, trace->file) != 1 ||
+		memcmp(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || header->version != TRACE_VERSION ||
+		!header->numbers || !header->max || !header->rounds ||
+		fread(numbers, 1, header->numbers, trace->file) != header->numbers)
+	{
+		fprintf(stderr, "Error - %s is not a version %d trace file\n", path, TRACE_VERSION);
+		fclose(trace->file);
+		trace->file = NULL;
+		return FAILURE;
+	}
+
+	for (uint8_t i = 0; i < header->numbers; i++)
+	{
+		trace->secret[i] = numbers[i];
+		if (!numbers[i] || numbers[i] > header->max)
+		{
+			fprintf(stderr, "Error - The secret of %s is out of range\n", path);
+			fclose(trace->file);
+			trace->file = NULL;
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+/**
+ * Reads the time of the next record, returns false at the end of the file
+*/
+static bool read_time(struct trace *trace)
+{
+	uint64_t delta = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		int byte = fgetc(trace->file);
+		if (byte == EOF)
+			return false;
+
+		delta |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			trace->last += delta;
+			return true;
+		}
+	}
+	return false;  // Too long
+}
+
+int TRACE_read(struct trace *trace, struct gpio_event *event, struct trace_result *result)
+{
+	int type;
+	if (!read_time(trace) || (type = fgetc(trace->file)) == EOF)
+		return FAILURE;
+
+	if (type == TRACE_END)
+	{
+		int round = fgetc(trace->file);
+		int won = fgetc(trace->file);
+		if (round == EOF || won == EOF)
+			return FAILURE;
+		result->round = round;
+		result->won = won;
+		return 0;
+	}
+
+	event->timestamp = trace->last;
+	event->pin = type >> 1;
+	event->level = type & 1;
+	return 1;
+}
+
+/**
+ * Fires the timers of the game due up to time, in order
+*/
+static void replay_until(struct game *game, struct timer_wheel *wheel, uint64_t time, void (*wait)(uint64_t time))
+{
+	uint64_t expires;
+	while (!GAME_is_over(game) && (expires = TIMER_next_expiry(wheel)) <= time)
+	{
+		if (wait)
+			wait(expires);
+		TIMER_advance(wheel, expires);
+	}
+
+	if (wait)
+		wait(time);
+	TIMER_advance(wheel, time);
+}
+
+int TRACE_replay(struct trace *trace, struct game *game, struct timer_wheel *wheel, uint8_t pin,
+				 void (*wait)(uint64_t time), uint64_t *events, struct trace_result *recorded)
+{
+	struct gpio_event event;
+	int type;
+	*events = 0;
+	while ((type = TRACE_read(trace, &event, recorded)) > 0)
+	{
+		replay_until(game, wheel, event.timestamp, wait);
+		if (event.pin == pin)
+			GAME_button(game, event.level, event.timestamp);
+		(*events)++;
+	}
+	if (type < 0)
+		return FAILURE;
+
+	replay_until(game, wheel, trace->last, wait);  // Until the recorded end
+	return SUCCESS;
+}
+
+int TRACE_close(struct trace *trace)
+{
+	if (!trace->file)
+		return SUCCESS;
+
+	bool failed = ferror(trace->file);
+	failed = fclose(trace->file) != 0 || failed;
+	trace->file = NULL;
+	if (failed)
+		perror("Unable to write the trace");
+	return failed ? FAILURE : SUCCESS;
+}
@@ -0,0 +1,126 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../gpio/gpio.h"
+#include "../game/game.h"
+#include "../timer/timer.h"
+
+/**
+ * Input traces.
+ * A trace holds everything needed to play a game again exactly: the
+ * settings, the seed and the secret, every debounced input event and the
+ * outcome of the game.
+ *
+ * File layout (native byte order):
+ *   struct trace_header, the secret (one byte per number), then records:
+ *   event - time since the previous record (ns, LEB128), pin << 1 | level
+ *   end   - time since the previous record (ns, LEB128), TRACE_END,
+ *           round, won (1) or lost (0)
+ * The times of the records are relative to the start of the game.
+ *
+ * A replay fires the timers of the game up to the time of every event
+ * before the event, so the trace has to hold the events in the order the
+ * game saw them relative to its timers (see TRACE_deliver).
+*/
+
+#define TRACE_MAGIC "MMTRACE"
+#define TRACE_VERSION 1
+// Record type byte of the end of the game
+#define TRACE_END 0xFF
+
+struct trace_header
+{
+	char magic[8];  // TRACE_MAGIC
+	uint32_t version;  // TRACE_VERSION
+	uint8_t numbers;
+	uint8_t rounds;
+	uint8_t max;
+	uint8_t reserved;  // 0
+	uint64_t seed;
+};
+
+/**
+ * Outcome of a game
+*/
+struct trace_result
+{
+	uint8_t round;  // Round the game ended in
+	bool won;
+};
+
+struct trace
+{
+	FILE *file;
+	struct trace_header header;
+	int secret[UINT8_MAX];
+	uint64_t start;  // Time of the start of the game, recording only
+	uint64_t last;  // Time of the last record, relative to the start
+};
+
+/**
+ * Creates the trace file and writes the header and the secret.
+ * start - time of the start of the game, on the clock of the events
+ * Returns 0 on success, -1 on failure.
+*/
+int TRACE_create(struct trace *trace, const char *path, const struct game_settings *settings,
+				 uint64_t seed, const int secret[], uint64_t start);
+
+/**
+ * Appends the event. Returns 0 on success, -1 on failure.
+*/
+int TRACE_record(struct trace *trace, const struct gpio_event *event);
+
+/**
+ * Gives a debounced event to the game the way a replay will, and appends
+ * it to the trace (NULL - no trace).
+ * advanced - the time the timers of the game were last advanced to, moves
+ *            to the time of the event
+ * The sampler dates an event back to its first sample, up to
+ * GPIO_DEBOUNCE_SAMPLES - 1 periods before it arrives, so the game may
+ * already have fired a timer due after the event. Such an event takes the
+ * time of the last advance. Otherwise the timers due before the event are
+ * fired first. Either way the game and the trace get the same order.
+*/
+void TRACE_deliver(struct trace *trace, struct game *game, struct timer_wheel *wheel, struct gpio_event *event,
+				   uint64_t *advanced);
+
+/**
+ * Appends the outcome of the game at time now. Returns 0 on success, -1 on failure.
+*/
+int TRACE_record_end(struct trace *trace, uint64_t now, const struct trace_result *result);
+
+/**
+ * Opens a trace for reading and reads the header and the secret.
+ * Returns 0 on success, -1 on failure.
+*/
+int TRACE_open(struct trace *trace, const char *path);
+
+/**
+ * Reads the next record. Event timestamps are relative to the start of the game.
+ * Returns 1 for an event, 0 at the end of the game (result is set),
+ * -1 if the trace is damaged or ends without the end record.
+*/
+int TRACE_read(struct trace *trace, struct gpio_event *event, struct trace_result *result);
+
+/**
+ * Plays the remaining events of the pin on the started game, firing the
+ * timers of the wheel due before every event, then the ones due before
+ * the recorded end. The wheel starts at time 0, the start of the game.
+ * wait - called with the time of the trace before the game moves to it
+ *        (to replay at the recorded speed), NULL - as fast as possible
+ * events - receives the number of events played
+ * Returns 0 at the end of the game (recorded is set), -1 if the trace is
+ * damaged or ends without the end record.
+*/
+int TRACE_replay(struct trace *trace, struct game *game, struct timer_wheel *wheel, uint8_t pin,
+				 void (*wait)(uint64_t time), uint64_t *events, struct trace_result *recorded);
+
+/**
+ * Closes the trace file. Returns 0 on success, -1 if writing failed.
+*/
+int TRACE_close(struct trace *trace);
+
+#endif